@@ -0,0 +1,128 @@
+/**
+ * @file animationsystem.hpp
+ * @brief Animation channels evaluated together once per frame and bound to node and light properties.
+ *
+ * Every channel has the same form, offset + rate * t + scale * clamp(sin(frequency * t + phase), low, high),
+ * with t the frame time wrapped to the channel's period. Waves, ramps and keyframe curves are all
+ * cases of it: a keyframe channel gets the offset and rate of its current segment before the pass.
+ * The channel parameters are kept as separate arrays, so Evaluate does four channels per SSE
+ * step with a polynomial sine.
+ *
+ * Bindings write channel values into a SceneGraph or LightBuffer. Nodes that do not need to be
+ * exact every frame, e.g. hidden ones, can be given an interval and are then only written every
+ * few frames, staggered by node.
+ */
+
+#pragma once
+#include <vector>
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+#include "scenegraph.hpp"
+#include "lightbuffer.hpp"
+
+class AnimationSystem {
+public:
+    typedef unsigned ChannelId;
+
+    struct Key {
+        float Time;
+        float Value;
+    };
+
+    struct Stats {
+        unsigned Channels;
+        // Node and light bindings written by the last ApplyNodes and ApplyLights
+        unsigned Applied;
+        unsigned Skipped;
+        double EvaluateTime;
+    };
+
+    AnimationSystem();
+
+    /**
+     * @brief offset + scale * clamp(sin(frequency * t + phase), low, high), frequency in radians per second
+     */
+    ChannelId AddWave(float frequency, float phase, float scale, float offset, float low = -1.0f, float high = 1.0f);
+    /**
+     * @brief rate * t wrapped to [0, wrap), e.g. a spin in degrees per second wrapped to 360
+     */
+    ChannelId AddRamp(float rate, float wrap);
+    /**
+     * @brief Linear interpolation between count keys sorted by time, looping after the last one
+     */
+    ChannelId AddKeyframes(const Key* keys, unsigned count);
+    void Clear();
+
+    /**
+     * @brief position = base + axis * value
+     */
+    void BindNodeOffset(ChannelId channel, SceneGraph::NodeId node, const glm::vec3& base, const glm::vec3& axis);
+    /**
+     * @brief rotation = turn of value degrees around axis, applied after base
+     */
+    void BindNodeSpin(ChannelId channel, SceneGraph::NodeId node, const glm::quat& base, const glm::vec3& axis);
+    void BindLightOffset(ChannelId channel, unsigned light, const glm::vec3& base, const glm::vec3& axis);
+    /**
+     * @brief Every color = base + scale * value, in the order ambient, diffuse, specular
+     */
+    void BindLightColor(ChannelId channel, unsigned light, const glm::vec3 base[3], const glm::vec3 scale[3]);
+    /**
+     * @brief Writes the node's bindings only every frames frames, 1 for every frame
+     */
+    void SetNodeInterval(SceneGraph::NodeId node, unsigned frames);
+
+    /**
+     * @brief Evaluates every channel at time seconds and starts a new frame
+     */
+    void Evaluate(double time);
+    float GetValue(ChannelId channel) const;
+    void ApplyNodes(SceneGraph& graph);
+    void ApplyLights(LightBuffer& lights);
+    Stats GetStats() const;
+
+private:
+    enum ETarget {
+        TARGET_NODE_OFFSET = 0,
+        TARGET_NODE_SPIN,
+        TARGET_LIGHT_OFFSET,
+        TARGET_LIGHT_COLOR,
+    };
+
+    struct Binding {
+        ETarget Target;
+        ChannelId Channel;
+        // Node or light
+        unsigned Object;
+        glm::vec3 Base[3];
+        glm::vec3 Axis[3];
+        glm::quat BaseRotation;
+    };
+
+    // Channel parameters, padded to a multiple of four with channels that stay 0
+    std::vector<float> mOffsets;
+    std::vector<float> mRates;
+    std::vector<float> mScales;
+    std::vector<float> mFrequencies;
+    std::vector<float> mPhases;
+    std::vector<float> mLows;
+    std::vector<float> mHighs;
+    std::vector<float> mTimes;
+    std::vector<float> mValues;
+    // Wrap period of every channel in seconds, 0 for none
+    std::vector<double> mPeriods;
+    // First key and key count, count 0 for channels without keys
+    std::vector<unsigned> mKeyFirst;
+    std::vector<unsigned> mKeyCount;
+    std::vector<Key> mKeys;
+    unsigned mChannelCount;
+
+    std::vector<Binding> mBindings;
+    std::vector<unsigned> mNodeIntervals;
+    unsigned mFrame;
+    unsigned mApplied;
+    unsigned mSkipped;
+    double mEvaluateTime;
+
+    ChannelId addChannel(double period);
+    void bind(ETarget target, ChannelId channel, unsigned object, const glm::vec3* base, const glm::vec3* axis, unsigned vectors, const glm::quat& rotation);
+};
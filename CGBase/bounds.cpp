@@ -0,0 +1,58 @@
+#include "bounds.hpp"
+#include <algorithm>
+
+Bounds
+Bounds::FromVertices(const float* vertices, unsigned vertexCount, unsigned stride) {
+    Bounds Result;
+    Result.Min = Result.Max = Result.Center = glm::vec3(0.0f);
+    Result.Radius = 0.0f;
+    if (!vertexCount) {
+        return Result;
+    }
+
+    Result.Min = Result.Max = glm::vec3(vertices[0], vertices[1], vertices[2]);
+    for (unsigned VertexIdx = 1; VertexIdx < vertexCount; ++VertexIdx) {
+        const float* Position = vertices + VertexIdx * stride;
+        Result.Min = glm::min(Result.Min, glm::vec3(Position[0], Position[1], Position[2]));
+        Result.Max = glm::max(Result.Max, glm::vec3(Position[0], Position[1], Position[2]));
+    }
+
+    // Farthest vertex from the box center, never larger than half the diagonal
+    Result.Center = (Result.Min + Result.Max) * 0.5f;
+    float RadiusSquared = 0.0f;
+    for (unsigned VertexIdx = 0; VertexIdx < vertexCount; ++VertexIdx) {
+        const float* Position = vertices + VertexIdx * stride;
+        glm::vec3 Offset = glm::vec3(Position[0], Position[1], Position[2]) - Result.Center;
+        RadiusSquared = std::max(RadiusSquared, glm::dot(Offset, Offset));
+    }
+    Result.Radius = glm::sqrt(RadiusSquared);
+    return Result;
+}
+
+glm::vec4
+Bounds::WorldSphere(const glm::mat4& model) const {
+    glm::vec3 Center = glm::vec3(model * glm::vec4(this->Center, 1.0f));
+    float Scale = std::max(glm::length(glm::vec3(model[0])), std::max(glm::length(glm::vec3(model[1])), glm::length(glm::vec3(model[2]))));
+    return glm::vec4(Center, Radius * Scale);
+}
+
+void
+Bounds::WorldBox(const glm::mat4& model, glm::vec3& min, glm::vec3& max) const {
+    // Every axis of the matrix stretches the box by its extent along that axis (Arvo)
+    glm::vec3 Center = glm::vec3(model * glm::vec4((Min + Max) * 0.5f, 1.0f));
+    glm::vec3 HalfSize = (Max - Min) * 0.5f;
+    glm::vec3 Extent = glm::abs(glm::vec3(model[0])) * HalfSize.x + glm::abs(glm::vec3(model[1])) * HalfSize.y + glm::abs(glm::vec3(model[2])) * HalfSize.z;
+    min = Center - Extent;
+    max = Center + Extent;
+}
+
+Bounds
+Bounds::Merge(const Bounds& a, const Bounds& b) {
+    Bounds Result;
+    Result.Min = glm::min(a.Min, b.Min);
+    Result.Max = glm::max(a.Max, b.Max);
+    // Sphere around the merged box center that still holds both spheres
+    Result.Center = (Result.Min + Result.Max) * 0.5f;
+    Result.Radius = std::max(glm::length(a.Center - Result.Center) + a.Radius, glm::length(b.Center - Result.Center) + b.Radius);
+    return Result;
+}
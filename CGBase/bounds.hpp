@@ -0,0 +1,31 @@
+/**
+ * @file bounds.hpp
+ * @brief Local-space bounding box and sphere of a piece of geometry, computed once at load
+ *
+ */
+
+#pragma once
+#include <glm/glm.hpp>
+
+struct Bounds {
+    glm::vec3 Min;
+    glm::vec3 Max;
+    // Sphere around the box center, as tight as the vertices allow
+    glm::vec3 Center;
+    float Radius;
+
+    /**
+     * @brief Bounds of vertexCount vertices whose positions are the first 3 of every stride floats
+     */
+    static Bounds FromVertices(const float* vertices, unsigned vertexCount, unsigned stride);
+    /**
+     * @brief Sphere transformed by model, xyz center and w radius. The radius grows with the
+     * largest axis scale, so the sphere stays conservative under non-uniform scale.
+     */
+    glm::vec4 WorldSphere(const glm::mat4& model) const;
+    /**
+     * @brief Axis-aligned box around the box transformed by model
+     */
+    void WorldBox(const glm::mat4& model, glm::vec3& min, glm::vec3& max) const;
+    static Bounds Merge(const Bounds& a, const Bounds& b);
+};
@@ -0,0 +1,399 @@
+#include "bvh.hpp"
+#include <algorithm>
+#include <cfloat>
+
+static const unsigned NO_PARENT = 0xFFFFFFFF;
+
+BVH::BVH() {
+    mNeedsBuild = false;
+    mRebuildRatio = 1.5f;
+    mCostSum = 0.0f;
+    mBuildCost = 0.0f;
+    mRefits = 0;
+    mRebuilds = 0;
+}
+
+BVH::ObjectId
+BVH::Insert(const glm::vec3& min, const glm::vec3& max, unsigned userData) {
+    Object NewObject;
+    NewObject.Min = min;
+    NewObject.Max = max;
+    NewObject.UserData = userData;
+    NewObject.Leaf = NO_PARENT;
+    NewObject.Alive = true;
+    NewObject.Moved = false;
+    mObjects.push_back(NewObject);
+    mNeedsBuild = true;
+    return mObjects.size() - 1;
+}
+
+void
+BVH::Remove(ObjectId object) {
+    mObjects[object].Alive = false;
+    mNeedsBuild = true;
+}
+
+void
+BVH::Move(ObjectId object, const glm::vec3& min, const glm::vec3& max) {
+    Object& Moved = mObjects[object];
+    if (Moved.Min == min && Moved.Max == max) {
+        return;
+    }
+    Moved.Min = min;
+    Moved.Max = max;
+    // A pending build picks up the new box on its own
+    if (!Moved.Moved && !mNeedsBuild && Moved.Alive) {
+        Moved.Moved = true;
+        mMoved.push_back(object);
+    }
+}
+
+void
+BVH::Update() {
+    mRefits = 0;
+    if (mNeedsBuild) {
+        build();
+        return;
+    }
+
+    for (ObjectId Moved : mMoved) {
+        mObjects[Moved].Moved = false;
+        refitLeaf(mObjects[Moved].Leaf);
+    }
+    mMoved.clear();
+    if (mRefits && cost() > mBuildCost * mRebuildRatio) {
+        build();
+    }
+}
+
+void
+BVH::SetRebuildRatio(float ratio) {
+    mRebuildRatio = ratio;
+}
+
+// Depth-first walk shared by the overlap queries, overlaps(min, max) decides for nodes and objects alike
+template<typename Overlaps>
+unsigned
+BVH::query(const Overlaps& overlaps, unsigned* results, unsigned maxResults) const {
+    if (mNodes.empty() || !maxResults) {
+        return 0;
+    }
+
+    // Every level pops one node and pushes at most two, so depth + 1 entries always suffice
+    unsigned Stack[64];
+    unsigned Top = 0;
+    unsigned Found = 0;
+    Stack[Top++] = 0;
+    while (Top) {
+        const Node& Current = mNodes[Stack[--Top]];
+        if (!overlaps(Current.Min, Current.Max)) {
+            continue;
+        }
+        if (!Current.Count) {
+            Stack[Top++] = Current.Left + 1;
+            Stack[Top++] = Current.Left;
+            continue;
+        }
+        for (unsigned OrderIdx = Current.Left; OrderIdx < Current.Left + Current.Count; ++OrderIdx) {
+            const Object& Candidate = mObjects[mOrder[OrderIdx]];
+            if (overlaps(Candidate.Min, Candidate.Max)) {
+                results[Found++] = Candidate.UserData;
+                if (Found == maxResults) {
+                    return Found;
+                }
+            }
+        }
+    }
+    return Found;
+}
+
+unsigned
+BVH::QueryFrustum(const FrustumCuller& frustum, unsigned* results, unsigned maxResults) const {
+    return query([&](const glm::vec3& min, const glm::vec3& max) {
+        return frustum.IsBoxVisible(min, max);
+    }, results, maxResults);
+}
+
+unsigned
+BVH::QuerySphere(const glm::vec3& center, float radius, unsigned* results, unsigned maxResults) const {
+    float RadiusSquared = radius * radius;
+    return query([&](const glm::vec3& min, const glm::vec3& max) {
+        glm::vec3 Offset = center - glm::clamp(center, min, max);
+        return glm::dot(Offset, Offset) <= RadiusSquared;
+    }, results, maxResults);
+}
+
+unsigned
+BVH::QueryRay(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, unsigned* results, unsigned maxResults) const {
+    glm::vec3 InverseDirection = 1.0f / direction;
+    return query([&](const glm::vec3& min, const glm::vec3& max) {
+        float Entry;
+        return rayBox(origin, InverseDirection, min, max, maxDistance, Entry);
+    }, results, maxResults);
+}
+
+bool
+BVH::RayCast(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, unsigned& userData, float& distance) const {
+    float Entry;
+    glm::vec3 InverseDirection = 1.0f / direction;
+    if (mNodes.empty() || !rayBox(origin, InverseDirection, mNodes[0].Min, mNodes[0].Max, maxDistance, Entry)) {
+        return false;
+    }
+
+    // Nearer child is visited first, so subtrees behind the best hit so far are skipped
+    struct Visit {
+        unsigned Node;
+        float Entry;
+    };
+    Visit Stack[64];
+    unsigned Top = 0;
+    float Best = maxDistance;
+    bool Hit = false;
+    Stack[Top++] = { 0, Entry };
+    while (Top) {
+        Visit Current = Stack[--Top];
+        if (Current.Entry > Best) {
+            continue;
+        }
+        const Node& CurrNode = mNodes[Current.Node];
+        if (CurrNode.Count) {
+            for (unsigned OrderIdx = CurrNode.Left; OrderIdx < CurrNode.Left + CurrNode.Count; ++OrderIdx) {
+                const Object& Candidate = mObjects[mOrder[OrderIdx]];
+                if (rayBox(origin, InverseDirection, Candidate.Min, Candidate.Max, Best, Entry)) {
+                    Best = Entry;
+                    userData = Candidate.UserData;
+                    Hit = true;
+                }
+            }
+            continue;
+        }
+
+        float LeftEntry;
+        float RightEntry;
+        bool LeftHit = rayBox(origin, InverseDirection, mNodes[CurrNode.Left].Min, mNodes[CurrNode.Left].Max, Best, LeftEntry);
+        bool RightHit = rayBox(origin, InverseDirection, mNodes[CurrNode.Left + 1].Min, mNodes[CurrNode.Left + 1].Max, Best, RightEntry);
+        if (LeftHit && RightHit && LeftEntry < RightEntry) {
+            Stack[Top++] = { CurrNode.Left + 1, RightEntry };
+            Stack[Top++] = { CurrNode.Left, LeftEntry };
+        }
+        else if (LeftHit && RightHit) {
+            Stack[Top++] = { CurrNode.Left, LeftEntry };
+            Stack[Top++] = { CurrNode.Left + 1, RightEntry };
+        }
+        else if (LeftHit || RightHit) {
+            Stack[Top++] = LeftHit ? Visit{ CurrNode.Left, LeftEntry } : Visit{ CurrNode.Left + 1, RightEntry };
+        }
+    }
+    distance = Best;
+    return Hit;
+}
+
+BVH::Stats
+BVH::GetStats() const {
+    Stats Result;
+    Result.Objects = mOrder.size();
+    Result.Nodes = mNodes.size();
+    Result.Refits = mRefits;
+    Result.Rebuilds = mRebuilds;
+    Result.Cost = cost();
+    Result.BuildCost = mBuildCost;
+    return Result;
+}
+
+void
+BVH::build() {
+    mOrder.clear();
+    mNodes.clear();
+    mCentroids.resize(mObjects.size());
+    for (unsigned ObjectIdx = 0; ObjectIdx < mObjects.size(); ++ObjectIdx) {
+        Object& Current = mObjects[ObjectIdx];
+        Current.Moved = false;
+        Current.Leaf = NO_PARENT;
+        if (Current.Alive) {
+            mOrder.push_back(ObjectIdx);
+            mCentroids[ObjectIdx] = (Current.Min + Current.Max) * 0.5f;
+        }
+    }
+    mMoved.clear();
+    mNeedsBuild = false;
+    mRebuilds++;
+
+    mCostSum = 0.0f;
+    if (!mOrder.empty()) {
+        mNodes.reserve(2 * mOrder.size());
+        Node Root = Node();
+        Root.Parent = NO_PARENT;
+        mNodes.push_back(Root);
+        buildNode(0, 0, mOrder.size(), 0);
+        for (const Node& Current : mNodes) {
+            mCostSum += nodeCost(Current);
+        }
+    }
+    mBuildCost = cost();
+}
+
+void
+BVH::buildNode(unsigned node, unsigned first, unsigned count, unsigned depth) {
+    glm::vec3 Min(FLT_MAX);
+    glm::vec3 Max(-FLT_MAX);
+    glm::vec3 CentroidMin(FLT_MAX);
+    glm::vec3 CentroidMax(-FLT_MAX);
+    for (unsigned OrderIdx = first; OrderIdx < first + count; ++OrderIdx) {
+        const Object& Current = mObjects[mOrder[OrderIdx]];
+        Min = glm::min(Min, Current.Min);
+        Max = glm::max(Max, Current.Max);
+        CentroidMin = glm::min(CentroidMin, mCentroids[mOrder[OrderIdx]]);
+        CentroidMax = glm::max(CentroidMax, mCentroids[mOrder[OrderIdx]]);
+    }
+    mNodes[node].Min = Min;
+    mNodes[node].Max = Max;
+
+    // Best binned split over all three axes, cost of a side is its area times its object count
+    unsigned BestAxis = 0;
+    unsigned BestBin = 0;
+    float BestCost = FLT_MAX;
+    for (unsigned Axis = 0; Axis < 3 && count > MAX_LEAF_OBJECTS && depth < MAX_DEPTH; ++Axis) {
+        float Extent = CentroidMax[Axis] - CentroidMin[Axis];
+        if (Extent <= 0.0f) {
+            continue;
+        }
+
+        unsigned BinCounts[SAH_BINS] = { 0 };
+        glm::vec3 BinMin[SAH_BINS];
+        glm::vec3 BinMax[SAH_BINS];
+        for (unsigned BinIdx = 0; BinIdx < SAH_BINS; ++BinIdx) {
+            BinMin[BinIdx] = glm::vec3(FLT_MAX);
+            BinMax[BinIdx] = glm::vec3(-FLT_MAX);
+        }
+        float Scale = SAH_BINS / Extent;
+        for (unsigned OrderIdx = first; OrderIdx < first + count; ++OrderIdx) {
+            const Object& Current = mObjects[mOrder[OrderIdx]];
+            unsigned BinIdx = std::min(SAH_BINS - 1, (unsigned)((mCentroids[mOrder[OrderIdx]][Axis] - CentroidMin[Axis]) * Scale));
+            BinCounts[BinIdx]++;
+            BinMin[BinIdx] = glm::min(BinMin[BinIdx], Current.Min);
+            BinMax[BinIdx] = glm::max(BinMax[BinIdx], Current.Max);
+        }
+
+        // Sweep from the right once to get the right side of every split, then from the left
+        float RightCost[SAH_BINS];
+        glm::vec3 SideMin(FLT_MAX);
+        glm::vec3 SideMax(-FLT_MAX);
+        unsigned SideCount = 0;
+        for (unsigned BinIdx = SAH_BINS - 1; BinIdx > 0; --BinIdx) {
+            SideMin = glm::min(SideMin, BinMin[BinIdx]);
+            SideMax = glm::max(SideMax, BinMax[BinIdx]);
+            SideCount += BinCounts[BinIdx];
+            RightCost[BinIdx] = SideCount ? area(SideMin, SideMax) * SideCount : 0.0f;
+        }
+        SideMin = glm::vec3(FLT_MAX);
+        SideMax = glm::vec3(-FLT_MAX);
+        SideCount = 0;
+        for (unsigned BinIdx = 0; BinIdx + 1 < SAH_BINS; ++BinIdx) {
+            SideMin = glm::min(SideMin, BinMin[BinIdx]);
+            SideMax = glm::max(SideMax, BinMax[BinIdx]);
+            SideCount += BinCounts[BinIdx];
+            if (!SideCount || SideCount == count) {
+                continue;
+            }
+            float SplitCost = area(SideMin, SideMax) * SideCount + RightCost[BinIdx + 1];
+            if (SplitCost < BestCost) {
+                BestCost = SplitCost;
+                BestAxis = Axis;
+                BestBin = BinIdx;
+            }
+        }
+    }
+
+    // Splitting has to beat testing every object of the node, traversal costs one box test
+    float LeafCost = area(Min, Max) * count;
+    if (count <= MAX_LEAF_OBJECTS || depth >= MAX_DEPTH || (BestCost != FLT_MAX && area(Min, Max) + BestCost >= LeafCost && count <= 4 * MAX_LEAF_OBJECTS)) {
+        mNodes[node].Left = first;
+        mNodes[node].Count = count;
+        for (unsigned OrderIdx = first; OrderIdx < first + count; ++OrderIdx) {
+            mObjects[mOrder[OrderIdx]].Leaf = node;
+        }
+        return;
+    }
+
+    // All centroids in one spot, any halving is as good as another
+    unsigned LeftCount = count / 2;
+    if (BestCost != FLT_MAX) {
+        float Scale = SAH_BINS / (CentroidMax[BestAxis] - CentroidMin[BestAxis]);
+        float AxisMin = CentroidMin[BestAxis];
+        unsigned* Middle = std::partition(&mOrder[first], &mOrder[first] + count, [&](unsigned object) {
+            return std::min(SAH_BINS - 1, (unsigned)((mCentroids[object][BestAxis] - AxisMin) * Scale)) <= BestBin;
+        });
+        LeftCount = Middle - &mOrder[first];
+    }
+
+    unsigned Left = mNodes.size();
+    Node Child = Node();
+    Child.Parent = node;
+    mNodes.push_back(Child);
+    mNodes.push_back(Child);
+    mNodes[node].Left = Left;
+    mNodes[node].Count = 0;
+    buildNode(Left, first, LeftCount, depth + 1);
+    buildNode(Left + 1, first + LeftCount, count - LeftCount, depth + 1);
+}
+
+void
+BVH::refitLeaf(unsigned node) {
+    glm::vec3 Min(FLT_MAX);
+    glm::vec3 Max(-FLT_MAX);
+    const Node& Leaf = mNodes[node];
+    for (unsigned OrderIdx = Leaf.Left; OrderIdx < Leaf.Left + Leaf.Count; ++OrderIdx) {
+        Min = glm::min(Min, mObjects[mOrder[OrderIdx]].Min);
+        Max = glm::max(Max, mObjects[mOrder[OrderIdx]].Max);
+    }
+
+    // Up to the root or to the first box that did not change
+    while (node != NO_PARENT) {
+        Node& Current = mNodes[node];
+        if (Current.Count == 0) {
+            Min = glm::min(mNodes[Current.Left].Min, mNodes[Current.Left + 1].Min);
+            Max = glm::max(mNodes[Current.Left].Max, mNodes[Current.Left + 1].Max);
+        }
+        if (Current.Min == Min && Current.Max == Max) {
+            return;
+        }
+        mCostSum -= nodeCost(Current);
+        Current.Min = Min;
+        Current.Max = Max;
+        mCostSum += nodeCost(Current);
+        mRefits++;
+        node = Current.Parent;
+    }
+}
+
+float
+BVH::cost() const {
+    if (mNodes.empty()) {
+        return 0.0f;
+    }
+    float RootArea = area(mNodes[0].Min, mNodes[0].Max);
+    return RootArea > 0.0f ? mCostSum / RootArea : 0.0f;
+}
+
+float
+BVH::nodeCost(const Node& node) const {
+    return node.Count ? area(node.Min, node.Max) * node.Count : area(node.Min, node.Max);
+}
+
+float
+BVH::area(const glm::vec3& min, const glm::vec3& max) {
+    glm::vec3 Size = max - min;
+    return 2.0f * (Size.x * Size.y + Size.y * Size.z + Size.z * Size.x);
+}
+
+bool
+BVH::rayBox(const glm::vec3& origin, const glm::vec3& inverseDirection, const glm::vec3& min, const glm::vec3& max, float maxDistance, float& entry) {
+    glm::vec3 Near = (min - origin) * inverseDirection;
+    glm::vec3 Far = (max - origin) * inverseDirection;
+    glm::vec3 Enter = glm::min(Near, Far);
+    glm::vec3 Exit = glm::max(Near, Far);
+    float EnterDistance = std::max(std::max(Enter.x, Enter.y), std::max(Enter.z, 0.0f));
+    float ExitDistance = std::min(std::min(Exit.x, Exit.y), std::min(Exit.z, maxDistance));
+    entry = EnterDistance;
+    return EnterDistance <= ExitDistance;
+}
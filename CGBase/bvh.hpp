@@ -0,0 +1,112 @@
+/**
+ * @file bvh.hpp
+ * @brief Bounding volume hierarchy over axis-aligned object boxes, built top-down with a binned
+ * surface area heuristic (SAH). Moving an object only refits the boxes on the path from its
+ * leaf to the root. The SAH cost of the tree is kept up to date during refits, and once it has
+ * degraded past a set ratio of its cost right after the last build the tree is rebuilt.
+ *
+ * Queries write object user data into a caller buffer and walk the tree with a fixed stack,
+ * they never allocate.
+ */
+
+#pragma once
+#include <vector>
+#include <glm/glm.hpp>
+#include "frustumculler.hpp"
+
+class BVH {
+public:
+    typedef unsigned ObjectId;
+    static const ObjectId INVALID_OBJECT = 0xFFFFFFFF;
+
+    struct Stats {
+        unsigned Objects;
+        unsigned Nodes;
+        // Nodes whose box was recomputed by the last Update
+        unsigned Refits;
+        unsigned Rebuilds;
+        // SAH cost now and right after the last build
+        float Cost;
+        float BuildCost;
+    };
+
+    BVH();
+
+    /**
+     * @brief Adds an object, userData is what queries report for it. Takes effect on the next Update.
+     */
+    ObjectId Insert(const glm::vec3& min, const glm::vec3& max, unsigned userData);
+    void Remove(ObjectId object);
+    /**
+     * @brief Sets the object's new box, a box equal to the old one costs nothing
+     */
+    void Move(ObjectId object, const glm::vec3& min, const glm::vec3& max);
+    /**
+     * @brief Rebuilds after inserts and removes, refits after moves. A refit that pushes the cost
+     * past the rebuild ratio times the build cost triggers a rebuild as well.
+     */
+    void Update();
+    void SetRebuildRatio(float ratio);
+
+    unsigned QueryFrustum(const FrustumCuller& frustum, unsigned* results, unsigned maxResults) const;
+    unsigned QuerySphere(const glm::vec3& center, float radius, unsigned* results, unsigned maxResults) const;
+    /**
+     * @brief Every object whose box the ray enters within maxDistance, direction need not be normalized
+     */
+    unsigned QueryRay(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, unsigned* results, unsigned maxResults) const;
+    /**
+     * @brief Object whose box the ray enters first, false if it hits none within maxDistance
+     */
+    bool RayCast(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, unsigned& userData, float& distance) const;
+    Stats GetStats() const;
+
+private:
+    static const unsigned MAX_LEAF_OBJECTS = 4;
+    // Bounds the query stacks, subtrees this deep become leaves whatever their size
+    static const unsigned MAX_DEPTH = 48;
+    static const unsigned SAH_BINS = 12;
+
+    struct Object {
+        glm::vec3 Min;
+        glm::vec3 Max;
+        unsigned UserData;
+        unsigned Leaf;
+        bool Alive;
+        bool Moved;
+    };
+
+    // Inner nodes have Count 0 and their children at Left and Left + 1,
+    // leaves own mOrder[Left, Left + Count)
+    struct Node {
+        glm::vec3 Min;
+        glm::vec3 Max;
+        unsigned Parent;
+        unsigned Left;
+        unsigned Count;
+    };
+
+    std::vector<Object> mObjects;
+    std::vector<Node> mNodes;
+    // Object ids grouped by leaf
+    std::vector<unsigned> mOrder;
+    std::vector<ObjectId> mMoved;
+    // Build scratch, kept to avoid reallocating on every rebuild
+    std::vector<glm::vec3> mCentroids;
+    bool mNeedsBuild;
+    float mRebuildRatio;
+    // Unnormalized SAH cost, divided by the root's area when reported
+    float mCostSum;
+    float mBuildCost;
+    unsigned mRefits;
+    unsigned mRebuilds;
+
+    template<typename Overlaps>
+    unsigned query(const Overlaps& overlaps, unsigned* results, unsigned maxResults) const;
+    void build();
+    void buildNode(unsigned node, unsigned first, unsigned count, unsigned depth);
+    void refitLeaf(unsigned node);
+    float cost() const;
+    float nodeCost(const Node& node) const;
+    static float area(const glm::vec3& min, const glm::vec3& max);
+    static bool rayBox(const glm::vec3& origin, const glm::vec3& inverseDirection, const glm::vec3& min, const glm::vec3& max, float maxDistance, float& entry);
+};
@@ -25,12 +25,12 @@ Camera::SetYaw(float horizontalAngle) {
 }
 
 void
-Camera::Grow() {
-    mPlayerHeight += 0.05;
+Camera::Grow(float amount) {
+    mPlayerHeight += amount;
 }
 void
-Camera::Shrink() {
-    mPlayerHeight -= 0.05;
+Camera::Shrink(float amount) {
+    mPlayerHeight -= amount;
 }
 
 void
@@ -60,6 +60,11 @@ Camera::GetPosition() {
     return mPosition;
 }
 
+void
+Camera::SetPosition(const glm::vec3& position) {
+    mPosition = position;
+}
+
 glm::vec3
 Camera::GetTarget() {
     return mPosition + mFront;
@@ -20,13 +20,14 @@ public:
     void Move(float dx, float dy, float dt);
     void Rotate(float dx, float dy, float dt);
     glm::vec3 GetPosition();
+    void SetPosition(const glm::vec3& position);
     glm::vec3 GetTarget();
     glm::vec3 GetUp();
     void SetYaw(float horizontalAngle);
     void SetPitch(float verticalAngle);
     void updateVectors();
-    void Grow();
-    void Shrink();
+    void Grow(float amount);
+    void Shrink(float amount);
 
 private:
     glm::vec3 mWorldUp;
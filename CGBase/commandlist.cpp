@@ -0,0 +1,268 @@
+#include "commandlist.hpp"
+#include <cstring>
+
+CommandList::CommandList() {
+    mInputs = 0;
+    mRecorded = false;
+    mRecording = false;
+    mStats = Stats();
+}
+
+uint64_t
+CommandList::HashInputs(const void* data, unsigned size, uint64_t seed) {
+    const unsigned char* Bytes = (const unsigned char*)data;
+    uint64_t Hash = seed;
+    for (unsigned ByteIdx = 0; ByteIdx < size; ++ByteIdx) {
+        Hash ^= Bytes[ByteIdx];
+        Hash *= 1099511628211ULL;
+    }
+    return Hash;
+}
+
+bool
+CommandList::IsValid(uint64_t inputs) const {
+    if (!mRecorded || mInputs != inputs) {
+        return false;
+    }
+    for (unsigned ProgramIdx = 0; ProgramIdx < mPrograms.size(); ++ProgramIdx) {
+        if (mPrograms[ProgramIdx].Program->GetId() != mPrograms[ProgramIdx].Id) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void
+CommandList::Invalidate() {
+    mRecorded = false;
+}
+
+void
+CommandList::BeginRecording(uint64_t inputs) {
+    mWords.clear();
+    mPrograms.clear();
+    mInputs = inputs;
+    mRecorded = false;
+    mRecording = true;
+    mStats.Commands = 0;
+    mStats.Draws = 0;
+
+    // Nothing is assumed about the state replay starts from, no name or enum matches these, so
+    // the first bind and cull face of every kind are always written
+    mProgram = ~0u;
+    mModelLocation = -1;
+    mColorLocation = -1;
+    mTextures[0] = mTextures[1] = ~0u;
+    mVAO = ~0u;
+    mCullFace = 0;
+    mDepthFunc = 0;
+    mDepthWrite = true;
+    mColorSet = false;
+}
+
+void
+CommandList::UseProgram(const Shader& program) {
+    if (program.GetId() == mProgram) {
+        return;
+    }
+    mProgram = program.GetId();
+    mModelLocation = program.GetUniformLocation("uModel");
+    mColorLocation = program.GetUniformLocation("uCol");
+    mColorSet = false;
+
+    bool Known = false;
+    for (unsigned ProgramIdx = 0; ProgramIdx < mPrograms.size(); ++ProgramIdx) {
+        Known = Known || mPrograms[ProgramIdx].Program == &program;
+    }
+    if (!Known) {
+        ProgramRef Ref = { &program, mProgram };
+        mPrograms.push_back(Ref);
+    }
+
+    push(CMD_USE_PROGRAM);
+    mWords.push_back(mProgram);
+}
+
+void
+CommandList::BindTexture(unsigned unit, unsigned texture) {
+    if (unit < 2) {
+        if (mTextures[unit] == texture) {
+            return;
+        }
+        mTextures[unit] = texture;
+    }
+    push(CMD_BIND_TEXTURE);
+    mWords.push_back(unit);
+    mWords.push_back(texture);
+}
+
+void
+CommandList::BindVertexArray(unsigned vao) {
+    if (vao == mVAO) {
+        return;
+    }
+    mVAO = vao;
+    push(CMD_BIND_VAO);
+    mWords.push_back(vao);
+}
+
+void
+CommandList::SetCullFace(GLenum face) {
+    if (face == mCullFace) {
+        return;
+    }
+    mCullFace = face;
+    push(CMD_CULL_FACE);
+    mWords.push_back(face);
+}
+
+void
+CommandList::SetDepthState(GLenum func, bool write) {
+    if (func == mDepthFunc && write == mDepthWrite) {
+        return;
+    }
+    mDepthFunc = func;
+    mDepthWrite = write;
+    push(CMD_DEPTH_STATE);
+    mWords.push_back(func);
+    mWords.push_back(write);
+}
+
+void
+CommandList::SetModel(const glm::mat4& model) {
+    if (mModelLocation < 0) {
+        return;
+    }
+    push(CMD_MODEL);
+    mWords.push_back(mModelLocation);
+    pushFloats(&model[0][0], 16);
+}
+
+void
+CommandList::SetColor(const glm::vec3& color) {
+    if (mColorLocation < 0 || (mColorSet && color == mColor)) {
+        return;
+    }
+    mColor = color;
+    mColorSet = true;
+    push(CMD_COLOR);
+    mWords.push_back(mColorLocation);
+    pushFloats(&color[0], 3);
+}
+
+void
+CommandList::DrawElements(unsigned count, unsigned firstIndex, int baseVertex, unsigned instances) {
+    push(instances > 1 ? CMD_DRAW_ELEMENTS_INSTANCED : CMD_DRAW_ELEMENTS);
+    mWords.push_back(count);
+    mWords.push_back(firstIndex);
+    mWords.push_back((uint32_t)baseVertex);
+    if (instances > 1) {
+        mWords.push_back(instances);
+    }
+    mStats.Draws++;
+}
+
+void
+CommandList::DrawArrays(unsigned first, unsigned count, unsigned instances) {
+    push(instances > 1 ? CMD_DRAW_ARRAYS_INSTANCED : CMD_DRAW_ARRAYS);
+    mWords.push_back(first);
+    mWords.push_back(count);
+    if (instances > 1) {
+        mWords.push_back(instances);
+    }
+    mStats.Draws++;
+}
+
+void
+CommandList::EndRecording() {
+    // Replay leaves back face culling on like the render queue does
+    SetCullFace(GL_BACK);
+    std::vector<uint32_t>(mWords).swap(mWords);
+    mStats.Bytes = mWords.size() * sizeof(uint32_t);
+    mStats.Recordings++;
+    mRecording = false;
+    mRecorded = true;
+}
+
+void
+CommandList::Replay() const {
+    if (!mRecorded) {
+        return;
+    }
+
+    const uint32_t* Word = mWords.data();
+    const uint32_t* End = Word + mWords.size();
+    while (Word < End) {
+        switch (*Word++) {
+        case CMD_USE_PROGRAM:
+            GLState::UseProgram(Word[0]);
+            Word += 1;
+            break;
+        case CMD_BIND_TEXTURE:
+            GLState::BindTexture(Word[0], Word[1]);
+            Word += 2;
+            break;
+        case CMD_BIND_VAO:
+            GLState::BindVertexArray(Word[0]);
+            Word += 1;
+            break;
+        case CMD_CULL_FACE:
+            GLState::SetCullFace(Word[0]);
+            Word += 1;
+            break;
+        case CMD_DEPTH_STATE:
+            GLState::SetDepthFunc(Word[0]);
+            GLState::SetDepthMask(Word[1] != 0);
+            Word += 2;
+            break;
+        case CMD_MODEL:
+            glUniformMatrix4fv(Word[0], 1, GL_FALSE, (const float*)(Word + 1));
+            Word += 17;
+            break;
+        case CMD_COLOR:
+            glUniform3fv(Word[0], 1, (const float*)(Word + 1));
+            Word += 4;
+            break;
+        case CMD_DRAW_ELEMENTS:
+            glDrawElementsBaseVertex(GL_TRIANGLES, Word[0], GL_UNSIGNED_INT, (void*)(Word[1] * sizeof(unsigned)), (GLint)Word[2]);
+            Word += 3;
+            break;
+        case CMD_DRAW_ELEMENTS_INSTANCED:
+            glDrawElementsInstancedBaseVertex(GL_TRIANGLES, Word[0], GL_UNSIGNED_INT, (void*)(Word[1] * sizeof(unsigned)), Word[3], (GLint)Word[2]);
+            Word += 4;
+            break;
+        case CMD_DRAW_ARRAYS:
+            glDrawArrays(GL_TRIANGLES, Word[0], Word[1]);
+            Word += 2;
+            break;
+        case CMD_DRAW_ARRAYS_INSTANCED:
+            glDrawArraysInstanced(GL_TRIANGLES, Word[0], Word[1], Word[2]);
+            Word += 3;
+            break;
+        default:
+            std::cerr << "[Err] Corrupt command list" << std::endl;
+            return;
+        }
+    }
+}
+
+CommandList::Stats
+CommandList::GetStats() const {
+    return mStats;
+}
+
+void
+CommandList::push(ECommand command) {
+    if (!mRecording) {
+        std::cerr << "[Err] Command recorded outside of BeginRecording/EndRecording" << std::endl;
+    }
+    mWords.push_back(command);
+    mStats.Commands++;
+}
+
+void
+CommandList::pushFloats(const float* values, unsigned count) {
+    unsigned First = mWords.size();
+    mWords.resize(First + count);
+    memcpy(&mWords[First], values, count * sizeof(float));
+}
@@ -0,0 +1,106 @@
+/**
+ * @file commandlist.hpp
+ * @brief Recorded sequence of draws that is replayed as is. Recording resolves programs and
+ * uniform locations and drops redundant state changes, the result is a flat word stream that
+ * replay walks without sorting, lookups or allocation.
+ *
+ * A list stays valid until the inputs it was recorded with change or one of its programs is
+ * relinked by a hot reload. It does not notice changes to anything else it references.
+ */
+
+#pragma once
+#include <vector>
+#include <cstdint>
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+#include "shader.hpp"
+#include "glstate.hpp"
+
+class CommandList {
+public:
+    struct Stats {
+        unsigned Commands;
+        unsigned Draws;
+        unsigned Bytes;
+        // Times the list was recorded since it was created
+        unsigned Recordings;
+    };
+
+    CommandList();
+
+    /**
+     * @brief FNV-1a over raw bytes, for building the inputs key of a recording
+     */
+    static uint64_t HashInputs(const void* data, unsigned size, uint64_t seed = 14695981039346656037ULL);
+
+    /**
+     * @brief True if the list was recorded with the same inputs key and none of its programs changed since
+     */
+    bool IsValid(uint64_t inputs) const;
+    void Invalidate();
+
+    /**
+     * @brief Drops the previous recording. Every call up to EndRecording appends to the list.
+     */
+    void BeginRecording(uint64_t inputs);
+    void UseProgram(const Shader& program);
+    void BindTexture(unsigned unit, unsigned texture);
+    void BindVertexArray(unsigned vao);
+    void SetCullFace(GLenum face);
+    void SetDepthState(GLenum func, bool write);
+    // Sets uModel and uCol of the current program
+    void SetModel(const glm::mat4& model);
+    void SetColor(const glm::vec3& color);
+    void DrawElements(unsigned count, unsigned firstIndex, int baseVertex, unsigned instances);
+    void DrawArrays(unsigned first, unsigned count, unsigned instances);
+    void EndRecording();
+
+    /**
+     * @brief Issues the recorded commands. Per-frame uniforms of the programs have to be set beforehand.
+     */
+    void Replay() const;
+    Stats GetStats() const;
+
+private:
+    enum ECommand {
+        CMD_USE_PROGRAM = 0,
+        CMD_BIND_TEXTURE,
+        CMD_BIND_VAO,
+        CMD_CULL_FACE,
+        CMD_DEPTH_STATE,
+        CMD_MODEL,
+        CMD_COLOR,
+        CMD_DRAW_ELEMENTS,
+        CMD_DRAW_ELEMENTS_INSTANCED,
+        CMD_DRAW_ARRAYS,
+        CMD_DRAW_ARRAYS_INSTANCED,
+    };
+
+    // Program a recording depends on, with the GL id it had at the time
+    struct ProgramRef {
+        const Shader* Program;
+        unsigned Id;
+    };
+
+    std::vector<uint32_t> mWords;
+    std::vector<ProgramRef> mPrograms;
+    uint64_t mInputs;
+    bool mRecorded;
+    bool mRecording;
+    Stats mStats;
+
+    // Recording state, so repeated values are not written again
+    unsigned mProgram;
+    GLint mModelLocation;
+    GLint mColorLocation;
+    unsigned mTextures[2];
+    unsigned mVAO;
+    GLenum mCullFace;
+    GLenum mDepthFunc;
+    bool mDepthWrite;
+    glm::vec3 mColor;
+    bool mColorSet;
+
+    void push(ECommand command);
+    void pushFloats(const float* values, unsigned count);
+};
@@ -0,0 +1,67 @@
+#include "fixedtimestep.hpp"
+#include <cmath>
+
+FixedTimestep::FixedTimestep(double step, unsigned maxSteps) {
+    mStep = step;
+    mMaxSteps = maxSteps;
+    mStarted = false;
+    mLastTime = 0.0;
+    mAccumulator = 0.0;
+    mFrameSteps = 0;
+    mTotalSteps = 0;
+    mDroppedTime = 0.0;
+}
+
+unsigned
+FixedTimestep::Advance(double realTime) {
+    mFrameSteps = 0;
+    if (!mStarted) {
+        mStarted = true;
+        mLastTime = realTime;
+        return 0;
+    }
+
+    mAccumulator += realTime - mLastTime;
+    mLastTime = realTime;
+    while (mAccumulator >= mStep && mFrameSteps < mMaxSteps) {
+        mAccumulator -= mStep;
+        mFrameSteps++;
+    }
+    if (mAccumulator >= mStep) {
+        // Keeps the fraction of a step, so alpha stays continuous across the drop
+        double Dropped = std::floor(mAccumulator / mStep) * mStep;
+        mDroppedTime += Dropped;
+        mAccumulator -= Dropped;
+    }
+    mTotalSteps += mFrameSteps;
+    return mFrameSteps;
+}
+
+double
+FixedTimestep::GetStep() const {
+    return mStep;
+}
+
+float
+FixedTimestep::GetAlpha() const {
+    return (float)(mAccumulator / mStep);
+}
+
+double
+FixedTimestep::GetTime() const {
+    return mTotalSteps * mStep;
+}
+
+double
+FixedTimestep::GetRenderTime() const {
+    return GetTime() - mStep + mAccumulator;
+}
+
+FixedTimestep::Stats
+FixedTimestep::GetStats() const {
+    Stats Result;
+    Result.FrameSteps = mFrameSteps;
+    Result.TotalSteps = mTotalSteps;
+    Result.DroppedTime = mDroppedTime;
+    return Result;
+}
@@ -0,0 +1,59 @@
+/**
+ * @file fixedtimestep.hpp
+ * @brief Turns real frame times into a whole number of fixed simulation steps.
+ *
+ * Every frame Advance adds the real time that passed and says how many steps of GetStep seconds
+ * the simulation owes. What is left over is less than one step, GetAlpha gives it as a fraction
+ * of a step: rendering blends the state before the last step into the state after it by alpha, so
+ * it shows the simulation GetAlpha steps behind the latest state, whatever the frame rate.
+ *
+ * Frames slower than maxSteps steps only run maxSteps, the rest of the time is dropped and the
+ * simulation slows down instead of falling further behind every frame.
+ */
+
+#pragma once
+
+class FixedTimestep {
+public:
+    struct Stats {
+        // Steps run by the last Advance and since the start
+        unsigned FrameSteps;
+        unsigned long long TotalSteps;
+        // Real time thrown away because frames were too long, in seconds
+        double DroppedTime;
+    };
+
+    FixedTimestep(double step, unsigned maxSteps);
+
+    /**
+     * @brief Adds the time since the previous call, realTime being any clock in seconds. The first
+     * call only starts the clock.
+     *
+     * @returns Number of steps to run this frame
+     */
+    unsigned Advance(double realTime);
+    double GetStep() const;
+    /**
+     * @brief Blend factor from the previous to the current state, 0 to 1
+     */
+    float GetAlpha() const;
+    /**
+     * @brief Simulation time of the latest state, whole steps since the start
+     */
+    double GetTime() const;
+    /**
+     * @brief Simulation time of what is rendered, GetTime one step back plus alpha of it
+     */
+    double GetRenderTime() const;
+    Stats GetStats() const;
+
+private:
+    double mStep;
+    unsigned mMaxSteps;
+    bool mStarted;
+    double mLastTime;
+    double mAccumulator;
+    unsigned mFrameSteps;
+    unsigned long long mTotalSteps;
+    double mDroppedTime;
+};
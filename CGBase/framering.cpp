@@ -0,0 +1,145 @@
+#include "framering.hpp"
+#include <iostream>
+
+// 1 ms per wait, the loop keeps going until the fence is signaled
+static const GLuint64 FENCE_WAIT_NS = 1000000;
+
+FrameRing::FrameRing(unsigned regionSize) {
+    mRegionSize = regionSize;
+    mRegion = FRAME_COUNT - 1;
+    mOffset = 0;
+    mFlushed = 0;
+    mMapped = 0;
+    mCurrent.Stalls = mCurrent.BytesUsed = 0;
+    mLastFrame = mCurrent;
+    mOverflowReported = false;
+    for (unsigned Region = 0; Region < FRAME_COUNT; ++Region) {
+        mFences[Region] = 0;
+    }
+
+    GLint Alignment = 256;
+    glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &Alignment);
+    mUniformAlignment = Alignment;
+
+    mPersistent = GLEW_VERSION_4_4 || GLEW_ARB_buffer_storage;
+    glGenBuffers(1, &mBuffer);
+    GLState::BindBuffer(GL_ARRAY_BUFFER, mBuffer);
+    if (mPersistent) {
+        const GLbitfield Flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        glBufferStorage(GL_ARRAY_BUFFER, FRAME_COUNT * mRegionSize, 0, Flags);
+        mMapped = (unsigned char*)glMapBufferRange(GL_ARRAY_BUFFER, 0, FRAME_COUNT * mRegionSize, Flags);
+        if (!mMapped) {
+            std::cerr << "[Err] Failed to map frame ring, falling back to glBufferSubData" << std::endl;
+            GLState::DeleteBuffer(mBuffer);
+            glGenBuffers(1, &mBuffer);
+            GLState::BindBuffer(GL_ARRAY_BUFFER, mBuffer);
+            mPersistent = false;
+        }
+    }
+    if (!mPersistent) {
+        glBufferData(GL_ARRAY_BUFFER, FRAME_COUNT * mRegionSize, 0, GL_DYNAMIC_DRAW);
+        mStaging.resize(mRegionSize);
+    }
+}
+
+FrameRing::~FrameRing() {
+    for (unsigned Region = 0; Region < FRAME_COUNT; ++Region) {
+        if (mFences[Region]) {
+            glDeleteSync(mFences[Region]);
+        }
+    }
+    if (mPersistent) {
+        GLState::BindBuffer(GL_ARRAY_BUFFER, mBuffer);
+        glUnmapBuffer(GL_ARRAY_BUFFER);
+    }
+    GLState::DeleteBuffer(mBuffer);
+}
+
+void
+FrameRing::BeginFrame() {
+    mLastFrame = mCurrent;
+    mCurrent.Stalls = mCurrent.BytesUsed = 0;
+    mRegion = (mRegion + 1) % FRAME_COUNT;
+    mOffset = 0;
+    mFlushed = 0;
+
+    GLsync& Fence = mFences[mRegion];
+    if (!Fence) {
+        return;
+    }
+
+    GLenum Status = glClientWaitSync(Fence, 0, 0);
+    if (Status == GL_TIMEOUT_EXPIRED) {
+        mCurrent.Stalls++;
+        do {
+            Status = glClientWaitSync(Fence, GL_SYNC_FLUSH_COMMANDS_BIT, FENCE_WAIT_NS);
+        } while (Status == GL_TIMEOUT_EXPIRED);
+    }
+    if (Status == GL_WAIT_FAILED) {
+        std::cerr << "[Err] Waiting on frame ring fence failed" << std::endl;
+    }
+    glDeleteSync(Fence);
+    Fence = 0;
+}
+
+FrameRing::Allocation
+FrameRing::Allocate(unsigned size, unsigned alignment) {
+    Allocation Result = { 0, 0, 0 };
+    unsigned Start = (mOffset + alignment - 1) / alignment * alignment;
+    if (Start + size > mRegionSize) {
+        if (!mOverflowReported) {
+            std::cerr << "[Err] Frame ring region of " << mRegionSize << " bytes is full" << std::endl;
+            mOverflowReported = true;
+        }
+        return Result;
+    }
+
+    mOffset = Start + size;
+    mCurrent.BytesUsed = mOffset;
+    Result.Offset = mRegion * mRegionSize + Start;
+    Result.Size = size;
+    Result.Data = mPersistent ? (void*)(mMapped + Result.Offset) : (void*)(mStaging.data() + Start);
+    return Result;
+}
+
+void
+FrameRing::Flush() {
+    if (mPersistent || mFlushed == mOffset) {
+        return;
+    }
+
+    GLState::BindBuffer(GL_ARRAY_BUFFER, mBuffer);
+    glBufferSubData(GL_ARRAY_BUFFER, mRegion * mRegionSize + mFlushed, mOffset - mFlushed, mStaging.data() + mFlushed);
+    mFlushed = mOffset;
+}
+
+void
+FrameRing::EndFrame() {
+    Flush();
+    mFences[mRegion] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
+
+void
+FrameRing::BindRange(GLenum target, unsigned index, const Allocation& allocation) const {
+    GLState::BindBufferRange(target, index, mBuffer, allocation.Offset, allocation.Size);
+}
+
+unsigned
+FrameRing::GetId() const {
+    return mBuffer;
+}
+
+bool
+FrameRing::IsPersistent() const {
+    return mPersistent;
+}
+
+unsigned
+FrameRing::GetUniformAlignment() const {
+    return mUniformAlignment;
+}
+
+FrameRing::FrameStats
+FrameRing::GetFrameStats() const {
+    return mLastFrame;
+}
@@ -0,0 +1,73 @@
+/**
+ * @file framering.hpp
+ * @brief Per-frame bump allocator over one GPU buffer split into FRAME_COUNT regions.
+ * The CPU fills one region while the GPU may still read the previous ones, a fence per
+ * region keeps it from overwriting data that is still in flight.
+ *
+ * With GL 4.4 or ARB_buffer_storage the buffer is persistently mapped and written in place.
+ * Otherwise allocations are staged in memory and sent with glBufferSubData on Flush.
+ */
+
+#pragma once
+#include <vector>
+#include <GL/glew.h>
+#include "glstate.hpp"
+
+class FrameRing {
+public:
+    static const unsigned FRAME_COUNT = 3;
+
+    struct Allocation {
+        // Write pointer, valid until the next Flush. 0 if the region is full.
+        void* Data;
+        // Offset from the start of the buffer, for binding the range
+        unsigned Offset;
+        unsigned Size;
+    };
+
+    struct FrameStats {
+        // Frames that had to wait for the GPU before their region could be reused
+        unsigned Stalls;
+        unsigned BytesUsed;
+    };
+
+    FrameRing(unsigned regionSize);
+    ~FrameRing();
+
+    /**
+     * @brief Moves to the next region, waiting on its fence if the GPU is not done with it yet
+     */
+    void BeginFrame();
+    Allocation Allocate(unsigned size, unsigned alignment);
+    /**
+     * @brief Makes everything allocated so far visible to the GPU. Call before issuing
+     * draws that read it. Does nothing for the persistently mapped buffer.
+     */
+    void Flush();
+    /**
+     * @brief Flushes and fences the current region
+     */
+    void EndFrame();
+
+    void BindRange(GLenum target, unsigned index, const Allocation& allocation) const;
+    unsigned GetId() const;
+    bool IsPersistent() const;
+    // GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, the alignment to use for BindRange on uniform buffers
+    unsigned GetUniformAlignment() const;
+    FrameStats GetFrameStats() const;
+
+private:
+    unsigned mBuffer;
+    unsigned mRegionSize;
+    unsigned mRegion;
+    unsigned mOffset;
+    unsigned mFlushed;
+    bool mPersistent;
+    unsigned char* mMapped;
+    std::vector<unsigned char> mStaging;
+    GLsync mFences[FRAME_COUNT];
+    unsigned mUniformAlignment;
+    FrameStats mCurrent;
+    FrameStats mLastFrame;
+    bool mOverflowReported;
+};
@@ -0,0 +1,82 @@
+#include "frustumculler.hpp"
+#include <emmintrin.h>
+
+FrustumCuller::FrustumCuller() {
+    // Until a transform is set every sphere passes
+    for (unsigned PlaneIdx = 0; PlaneIdx < 6; ++PlaneIdx) {
+        mPlanes[PlaneIdx] = glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+    }
+}
+
+void
+FrustumCuller::SetViewProjection(const glm::mat4& viewProjection) {
+    // Rows of the matrix, clip space is -w <= x, y, z <= w
+    glm::vec4 Rows[4];
+    for (unsigned RowIdx = 0; RowIdx < 4; ++RowIdx) {
+        Rows[RowIdx] = glm::vec4(viewProjection[0][RowIdx], viewProjection[1][RowIdx], viewProjection[2][RowIdx], viewProjection[3][RowIdx]);
+    }
+    mPlanes[0] = Rows[3] + Rows[0];
+    mPlanes[1] = Rows[3] - Rows[0];
+    mPlanes[2] = Rows[3] + Rows[1];
+    mPlanes[3] = Rows[3] - Rows[1];
+    mPlanes[4] = Rows[3] + Rows[2];
+    mPlanes[5] = Rows[3] - Rows[2];
+    for (unsigned PlaneIdx = 0; PlaneIdx < 6; ++PlaneIdx) {
+        float Length = glm::length(glm::vec3(mPlanes[PlaneIdx]));
+        if (Length > 0.0f) {
+            mPlanes[PlaneIdx] /= Length;
+        }
+    }
+}
+
+unsigned
+FrustumCuller::Cull(const float* blocks, unsigned count, unsigned char* visible) const {
+    __m128 PlaneA[6];
+    __m128 PlaneB[6];
+    __m128 PlaneC[6];
+    __m128 PlaneD[6];
+    for (unsigned PlaneIdx = 0; PlaneIdx < 6; ++PlaneIdx) {
+        PlaneA[PlaneIdx] = _mm_set1_ps(mPlanes[PlaneIdx].x);
+        PlaneB[PlaneIdx] = _mm_set1_ps(mPlanes[PlaneIdx].y);
+        PlaneC[PlaneIdx] = _mm_set1_ps(mPlanes[PlaneIdx].z);
+        PlaneD[PlaneIdx] = _mm_set1_ps(mPlanes[PlaneIdx].w);
+    }
+
+    unsigned Visible = 0;
+    for (unsigned First = 0; First < count; First += 4) {
+        const float* Block = blocks + First / 4 * BLOCK_FLOATS;
+        __m128 X = _mm_loadu_ps(Block);
+        __m128 Y = _mm_loadu_ps(Block + 4);
+        __m128 Z = _mm_loadu_ps(Block + 8);
+        __m128 NegRadius = _mm_sub_ps(_mm_setzero_ps(), _mm_loadu_ps(Block + 12));
+
+        // A sphere is out as soon as its center is more than its radius behind any plane
+        __m128 Inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+        for (unsigned PlaneIdx = 0; PlaneIdx < 6; ++PlaneIdx) {
+            __m128 Distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(PlaneA[PlaneIdx], X), _mm_mul_ps(PlaneB[PlaneIdx], Y)),
+                _mm_add_ps(_mm_mul_ps(PlaneC[PlaneIdx], Z), PlaneD[PlaneIdx]));
+            Inside = _mm_and_ps(Inside, _mm_cmpge_ps(Distance, NegRadius));
+        }
+
+        int Mask = _mm_movemask_ps(Inside);
+        unsigned Lanes = count - First < 4 ? count - First : 4;
+        for (unsigned Lane = 0; Lane < Lanes; ++Lane) {
+            visible[First + Lane] = (Mask >> Lane) & 1;
+            Visible += visible[First + Lane];
+        }
+    }
+    return Visible;
+}
+
+bool
+FrustumCuller::IsBoxVisible(const glm::vec3& min, const glm::vec3& max) const {
+    // The box corner farthest along each plane's normal decides
+    for (unsigned PlaneIdx = 0; PlaneIdx < 6; ++PlaneIdx) {
+        const glm::vec4& Plane = mPlanes[PlaneIdx];
+        glm::vec3 Corner(Plane.x >= 0.0f ? max.x : min.x, Plane.y >= 0.0f ? max.y : min.y, Plane.z >= 0.0f ? max.z : min.z);
+        if (glm::dot(glm::vec3(Plane), Corner) + Plane.w < 0.0f) {
+            return false;
+        }
+    }
+    return true;
+}
@@ -0,0 +1,38 @@
+/**
+ * @file frustumculler.hpp
+ * @brief Bounding spheres against the six planes of a view frustum, four spheres per SSE test.
+ * Spheres are passed in blocks of four as x0..x3, y0..y3, z0..z3, r0..r3 so every plane test
+ * is a handful of multiply-adds on whole registers.
+ *
+ */
+
+#pragma once
+#include <glm/glm.hpp>
+
+class FrustumCuller {
+public:
+    // Floats per block of four spheres
+    static const unsigned BLOCK_FLOATS = 16;
+
+    FrustumCuller();
+
+    /**
+     * @brief Extracts the planes from the full transform to clip space (viewport * projection * view)
+     */
+    void SetViewProjection(const glm::mat4& viewProjection);
+    /**
+     * @brief Tests count spheres stored in ceil(count / 4) blocks. visible[i] becomes 1 for spheres
+     * inside or touching the frustum and 0 for the rest.
+     *
+     * @returns Number of visible spheres
+     */
+    unsigned Cull(const float* blocks, unsigned count, unsigned char* visible) const;
+    /**
+     * @brief Conservative box test, a box touching the frustum's corner region may pass
+     */
+    bool IsBoxVisible(const glm::vec3& min, const glm::vec3& max) const;
+
+private:
+    // a, b, c, d of every plane with a unit normal pointing into the frustum
+    glm::vec4 mPlanes[6];
+};
@@ -0,0 +1,238 @@
+#include "geometryarena.hpp"
+#include <algorithm>
+
+static const unsigned INITIAL_VERTICES = 1 << 16;
+static const unsigned INITIAL_INDICES = 1 << 18;
+
+bool GeometryArena::sInitialized = false;
+GeometryArena::Format GeometryArena::sFormats[FORMAT_COUNT];
+unsigned GeometryArena::sEBO = 0;
+GeometryArena::FreeList GeometryArena::sIndices;
+unsigned GeometryArena::sGrowths = 0;
+
+GeometryArena::Range
+GeometryArena::Allocate(EVertexFormat format, const float* vertices, unsigned vertexCount, const unsigned* indices, unsigned indexCount) {
+    if (!sInitialized) {
+        initialize();
+    }
+
+    Format& Target = sFormats[format];
+    Range Result = { format, 0, vertexCount, 0, indexCount };
+
+    Result.BaseVertex = Target.Vertices.Allocate(vertexCount);
+    while (Result.BaseVertex == FreeList::INVALID) {
+        unsigned OldCapacity = Target.Vertices.GetCapacity();
+        unsigned NewCapacity = std::max(2 * OldCapacity, OldCapacity + vertexCount);
+        Target.VBO = growBuffer(Target.VBO, OldCapacity * Target.Stride, NewCapacity * Target.Stride);
+        Target.Vertices.Grow(NewCapacity);
+        setupVertexArray(format);
+        Result.BaseVertex = Target.Vertices.Allocate(vertexCount);
+    }
+
+    if (indexCount) {
+        Result.FirstIndex = sIndices.Allocate(indexCount);
+        while (Result.FirstIndex == FreeList::INVALID) {
+            unsigned OldCapacity = sIndices.GetCapacity();
+            unsigned NewCapacity = std::max(2 * OldCapacity, OldCapacity + indexCount);
+            sEBO = growBuffer(sEBO, OldCapacity * sizeof(unsigned), NewCapacity * sizeof(unsigned));
+            sIndices.Grow(NewCapacity);
+            for (unsigned FormatIdx = 0; FormatIdx < FORMAT_COUNT; ++FormatIdx) {
+                setupVertexArray((EVertexFormat)FormatIdx);
+            }
+            Result.FirstIndex = sIndices.Allocate(indexCount);
+        }
+    }
+
+    // Uploads go through the copy target so the bound VAO's element buffer is left alone
+    GLState::BindBuffer(GL_ARRAY_BUFFER, Target.VBO);
+    glBufferSubData(GL_ARRAY_BUFFER, Result.BaseVertex * Target.Stride, vertexCount * Target.Stride, vertices);
+    if (indexCount) {
+        glBindBuffer(GL_COPY_WRITE_BUFFER, sEBO);
+        glBufferSubData(GL_COPY_WRITE_BUFFER, Result.FirstIndex * sizeof(unsigned), indexCount * sizeof(unsigned), indices);
+    }
+    return Result;
+}
+
+void
+GeometryArena::Free(const Range& range) {
+    if (!sInitialized) {
+        return;
+    }
+    sFormats[range.Format].Vertices.Free(range.BaseVertex, range.VertexCount);
+    if (range.IndexCount) {
+        sIndices.Free(range.FirstIndex, range.IndexCount);
+    }
+}
+
+unsigned
+GeometryArena::GetVAO(EVertexFormat format) {
+    if (!sInitialized) {
+        initialize();
+    }
+    return sFormats[format].VAO;
+}
+
+GeometryArena::Stats
+GeometryArena::GetStats() {
+    Stats Result = Stats();
+    Result.IndexCapacity = sIndices.GetCapacity();
+    Result.IndicesUsed = sIndices.GetUsed();
+    Result.FreeBlocks = sIndices.GetBlockCount();
+    Result.Growths = sGrowths;
+    for (unsigned FormatIdx = 0; FormatIdx < FORMAT_COUNT; ++FormatIdx) {
+        const Format& CurrFormat = sFormats[FormatIdx];
+        Result.VertexCapacity += CurrFormat.Vertices.GetCapacity();
+        Result.VerticesUsed += CurrFormat.Vertices.GetUsed();
+        Result.FreeBlocks += CurrFormat.Vertices.GetBlockCount();
+    }
+    return Result;
+}
+
+void
+GeometryArena::Shutdown() {
+    if (!sInitialized) {
+        return;
+    }
+    for (unsigned FormatIdx = 0; FormatIdx < FORMAT_COUNT; ++FormatIdx) {
+        GLState::DeleteVertexArray(sFormats[FormatIdx].VAO);
+        GLState::DeleteBuffer(sFormats[FormatIdx].VBO);
+    }
+    GLState::DeleteBuffer(sEBO);
+    sInitialized = false;
+}
+
+void
+GeometryArena::initialize() {
+    sFormats[FORMAT_POS_NORMAL_UV].Stride = 8 * sizeof(float);
+
+    glGenBuffers(1, &sEBO);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, sEBO);
+    glBufferData(GL_COPY_WRITE_BUFFER, INITIAL_INDICES * sizeof(unsigned), 0, GL_STATIC_DRAW);
+    sIndices.Reset(INITIAL_INDICES);
+
+    for (unsigned FormatIdx = 0; FormatIdx < FORMAT_COUNT; ++FormatIdx) {
+        Format& CurrFormat = sFormats[FormatIdx];
+        glGenVertexArrays(1, &CurrFormat.VAO);
+        glGenBuffers(1, &CurrFormat.VBO);
+        GLState::BindBuffer(GL_ARRAY_BUFFER, CurrFormat.VBO);
+        glBufferData(GL_ARRAY_BUFFER, INITIAL_VERTICES * CurrFormat.Stride, 0, GL_STATIC_DRAW);
+        CurrFormat.Vertices.Reset(INITIAL_VERTICES);
+        setupVertexArray((EVertexFormat)FormatIdx);
+    }
+    sInitialized = true;
+}
+
+void
+GeometryArena::setupVertexArray(EVertexFormat format) {
+    const Format& Target = sFormats[format];
+    GLState::BindVertexArray(Target.VAO);
+    GLState::BindBuffer(GL_ARRAY_BUFFER, Target.VBO);
+    switch (format) {
+    case FORMAT_POS_NORMAL_UV:
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, Target.Stride, (void*)0);
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, Target.Stride, (void*)(3 * sizeof(float)));
+        glEnableVertexAttribArray(1);
+        glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, Target.Stride, (void*)(6 * sizeof(float)));
+        glEnableVertexAttribArray(2);
+        break;
+    default:
+        break;
+    }
+    GLState::BindBuffer(GL_ELEMENT_ARRAY_BUFFER, sEBO);
+}
+
+unsigned
+GeometryArena::growBuffer(unsigned buffer, unsigned oldSize, unsigned newSize) {
+    unsigned NewBuffer;
+    glGenBuffers(1, &NewBuffer);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, NewBuffer);
+    glBufferData(GL_COPY_WRITE_BUFFER, newSize, 0, GL_STATIC_DRAW);
+    glBindBuffer(GL_COPY_READ_BUFFER, buffer);
+    glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, oldSize);
+    GLState::DeleteBuffer(buffer);
+    sGrowths++;
+    return NewBuffer;
+}
+
+void
+GeometryArena::FreeList::Reset(unsigned capacity) {
+    mBlocks.clear();
+    Block Whole = { 0, capacity };
+    mBlocks.push_back(Whole);
+    mCapacity = capacity;
+    mUsed = 0;
+}
+
+unsigned
+GeometryArena::FreeList::Allocate(unsigned count) {
+    for (unsigned BlockIdx = 0; BlockIdx < mBlocks.size(); ++BlockIdx) {
+        Block& CurrBlock = mBlocks[BlockIdx];
+        if (CurrBlock.Count < count) {
+            continue;
+        }
+
+        unsigned Offset = CurrBlock.Offset;
+        CurrBlock.Offset += count;
+        CurrBlock.Count -= count;
+        if (!CurrBlock.Count) {
+            mBlocks.erase(mBlocks.begin() + BlockIdx);
+        }
+        mUsed += count;
+        return Offset;
+    }
+    return INVALID;
+}
+
+void
+GeometryArena::FreeList::Free(unsigned offset, unsigned count) {
+    if (!count) {
+        return;
+    }
+
+    unsigned Insert = 0;
+    while (Insert < mBlocks.size() && mBlocks[Insert].Offset < offset) {
+        Insert++;
+    }
+    Block Freed = { offset, count };
+    mBlocks.insert(mBlocks.begin() + Insert, Freed);
+    mUsed -= count;
+
+    // Merge with the following block, then with the preceding one
+    if (Insert + 1 < mBlocks.size() && mBlocks[Insert].Offset + mBlocks[Insert].Count == mBlocks[Insert + 1].Offset) {
+        mBlocks[Insert].Count += mBlocks[Insert + 1].Count;
+        mBlocks.erase(mBlocks.begin() + Insert + 1);
+    }
+    if (Insert > 0 && mBlocks[Insert - 1].Offset + mBlocks[Insert - 1].Count == mBlocks[Insert].Offset) {
+        mBlocks[Insert - 1].Count += mBlocks[Insert].Count;
+        mBlocks.erase(mBlocks.begin() + Insert);
+    }
+}
+
+void
+GeometryArena::FreeList::Grow(unsigned capacity) {
+    unsigned Added = capacity - mCapacity;
+    if (!mBlocks.empty() && mBlocks.back().Offset + mBlocks.back().Count == mCapacity) {
+        mBlocks.back().Count += Added;
+    }
+    else {
+        Block Tail = { mCapacity, Added };
+        mBlocks.push_back(Tail);
+    }
+    mCapacity = capacity;
+}
+
+unsigned
+GeometryArena::FreeList::GetCapacity() const {
+    return mCapacity;
+}
+
+unsigned
+GeometryArena::FreeList::GetUsed() const {
+    return mUsed;
+}
+
+unsigned
+GeometryArena::FreeList::GetBlockCount() const {
+    return mBlocks.size();
+}
@@ -0,0 +1,97 @@
+/**
+ * @file geometryarena.hpp
+ * @brief Shared geometry storage. Every vertex format has one big vertex buffer and one VAO,
+ * all formats share one index buffer. Meshes get sub-ranges of them and draw with base-vertex
+ * calls, so switching meshes does not switch VAOs.
+ *
+ * Freed ranges go back to per-buffer free lists that merge neighbouring blocks, so unloading
+ * and reloading models reuses space instead of growing the buffers forever.
+ */
+
+#pragma once
+#include <vector>
+#include <GL/glew.h>
+#include "glstate.hpp"
+
+class GeometryArena {
+public:
+    enum EVertexFormat {
+        // 3 position, 3 normal, 2 UV floats, the layout of Renderable, Mesh and StaticBatcher
+        FORMAT_POS_NORMAL_UV = 0,
+        FORMAT_COUNT,
+    };
+
+    struct Range {
+        EVertexFormat Format;
+        unsigned BaseVertex;
+        unsigned VertexCount;
+        unsigned FirstIndex;
+        unsigned IndexCount;
+    };
+
+    struct Stats {
+        unsigned VertexCapacity;
+        unsigned VerticesUsed;
+        unsigned IndexCapacity;
+        unsigned IndicesUsed;
+        // Free blocks in the vertex and index lists, a measure of fragmentation
+        unsigned FreeBlocks;
+        // Times a vertex or index buffer was reallocated and copied since startup
+        unsigned Growths;
+    };
+
+    /**
+     * @brief Copies the geometry into the arena, growing its buffers if needed.
+     * Indices stay relative to the range, draws add BaseVertex.
+     */
+    static Range Allocate(EVertexFormat format, const float* vertices, unsigned vertexCount, const unsigned* indices, unsigned indexCount);
+    static void Free(const Range& range);
+    static unsigned GetVAO(EVertexFormat format);
+    static Stats GetStats();
+    /**
+     * @brief Deletes the buffers and VAOs. Call while the context is still current.
+     */
+    static void Shutdown();
+
+private:
+    // First-fit free list of [Offset, Offset + Count) blocks, sorted by offset
+    class FreeList {
+    public:
+        static const unsigned INVALID = 0xFFFFFFFF;
+
+        void Reset(unsigned capacity);
+        unsigned Allocate(unsigned count);
+        void Free(unsigned offset, unsigned count);
+        void Grow(unsigned capacity);
+        unsigned GetCapacity() const;
+        unsigned GetUsed() const;
+        unsigned GetBlockCount() const;
+
+    private:
+        struct Block {
+            unsigned Offset;
+            unsigned Count;
+        };
+
+        std::vector<Block> mBlocks;
+        unsigned mCapacity;
+        unsigned mUsed;
+    };
+
+    struct Format {
+        unsigned VAO;
+        unsigned VBO;
+        unsigned Stride;
+        FreeList Vertices;
+    };
+
+    static bool sInitialized;
+    static Format sFormats[FORMAT_COUNT];
+    static unsigned sEBO;
+    static FreeList sIndices;
+    static unsigned sGrowths;
+
+    static void initialize();
+    static void setupVertexArray(EVertexFormat format);
+    static unsigned growBuffer(unsigned buffer, unsigned oldSize, unsigned newSize);
+};
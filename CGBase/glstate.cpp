@@ -0,0 +1,251 @@
+#include "glstate.hpp"
+
+// Cached value that matches no real GL object or enum, forces the next call through
+static const unsigned UNKNOWN = 0xFFFFFFFF;
+
+unsigned GLState::sProgram = UNKNOWN;
+unsigned GLState::sVertexArray = UNKNOWN;
+unsigned GLState::sBuffers[BUFFER_TARGET_COUNT] = { UNKNOWN, UNKNOWN, UNKNOWN, UNKNOWN, UNKNOWN };
+unsigned GLState::sActiveTexture = UNKNOWN;
+// GL starts out with texture 0 on every unit
+unsigned GLState::sTextures[MAX_TEXTURE_UNITS];
+int GLState::sCapabilities[CAPABILITY_COUNT] = { -1, -1 };
+GLenum GLState::sCullFace = UNKNOWN;
+GLenum GLState::sDepthFunc = UNKNOWN;
+int GLState::sDepthMask = -1;
+int GLState::sColorMask = -1;
+GLState::FrameStats GLState::sCurrent = { 0, 0 };
+GLState::FrameStats GLState::sLastFrame = { 0, 0 };
+
+void
+GLState::UseProgram(unsigned program) {
+    if (changed(sProgram, program)) {
+        glUseProgram(program);
+    }
+}
+
+unsigned
+GLState::GetProgram() {
+    if (sProgram == UNKNOWN) {
+        GLint Program = 0;
+        glGetIntegerv(GL_CURRENT_PROGRAM, &Program);
+        sProgram = Program;
+    }
+    return sProgram;
+}
+
+void
+GLState::BindVertexArray(unsigned vao) {
+    if (changed(sVertexArray, vao)) {
+        glBindVertexArray(vao);
+        sBuffers[ELEMENT_ARRAY_BUFFER] = UNKNOWN;
+    }
+}
+
+void
+GLState::BindBuffer(GLenum target, unsigned buffer) {
+    int Target = bufferTargetIndex(target);
+    if (Target < 0) {
+        sCurrent.Issued++;
+        glBindBuffer(target, buffer);
+        return;
+    }
+    if (changed(sBuffers[Target], buffer)) {
+        glBindBuffer(target, buffer);
+    }
+}
+
+void
+GLState::BindBufferBase(GLenum target, unsigned index, unsigned buffer) {
+    // Indexed binds also replace the generic binding of the target
+    sCurrent.Issued++;
+    glBindBufferBase(target, index, buffer);
+    int Target = bufferTargetIndex(target);
+    if (Target >= 0) {
+        sBuffers[Target] = buffer;
+    }
+}
+
+void
+GLState::BindBufferRange(GLenum target, unsigned index, unsigned buffer, GLintptr offset, GLsizeiptr size) {
+    sCurrent.Issued++;
+    glBindBufferRange(target, index, buffer, offset, size);
+    int Target = bufferTargetIndex(target);
+    if (Target >= 0) {
+        sBuffers[Target] = buffer;
+    }
+}
+
+void
+GLState::BindTexture(unsigned unit, unsigned texture, GLenum target) {
+    if (unit >= MAX_TEXTURE_UNITS) {
+        sCurrent.Issued += 2;
+        glActiveTexture(GL_TEXTURE0 + unit);
+        glBindTexture(target, texture);
+        sActiveTexture = unit;
+        return;
+    }
+    if (!changed(sTextures[unit], texture)) {
+        return;
+    }
+    if (changed(sActiveTexture, unit)) {
+        glActiveTexture(GL_TEXTURE0 + unit);
+    }
+    glBindTexture(target, texture);
+}
+
+void
+GLState::SetEnabled(GLenum capability, bool enabled) {
+    int Capability = capabilityIndex(capability);
+    if (Capability >= 0 && sCapabilities[Capability] == (int)enabled) {
+        sCurrent.Elided++;
+        return;
+    }
+
+    sCurrent.Issued++;
+    if (Capability >= 0) {
+        sCapabilities[Capability] = enabled;
+    }
+    if (enabled) {
+        glEnable(capability);
+    }
+    else {
+        glDisable(capability);
+    }
+}
+
+void
+GLState::SetCullFace(GLenum face) {
+    if (changed(sCullFace, face)) {
+        glCullFace(face);
+    }
+}
+
+void
+GLState::SetDepthFunc(GLenum func) {
+    if (changed(sDepthFunc, func)) {
+        glDepthFunc(func);
+    }
+}
+
+void
+GLState::SetDepthMask(bool enabled) {
+    if (sDepthMask == (int)enabled) {
+        sCurrent.Elided++;
+        return;
+    }
+    sCurrent.Issued++;
+    sDepthMask = enabled;
+    glDepthMask(enabled ? GL_TRUE : GL_FALSE);
+}
+
+void
+GLState::SetColorMask(bool enabled) {
+    if (sColorMask == (int)enabled) {
+        sCurrent.Elided++;
+        return;
+    }
+    sCurrent.Issued++;
+    sColorMask = enabled;
+    GLboolean Mask = enabled ? GL_TRUE : GL_FALSE;
+    glColorMask(Mask, Mask, Mask, Mask);
+}
+
+void
+GLState::DeleteProgram(unsigned program) {
+    // A deleted program stays in use until another one is bound, so the cache stays valid
+    glDeleteProgram(program);
+}
+
+void
+GLState::DeleteVertexArray(unsigned vao) {
+    glDeleteVertexArrays(1, &vao);
+    if (sVertexArray == vao) {
+        sVertexArray = 0;
+        sBuffers[ELEMENT_ARRAY_BUFFER] = UNKNOWN;
+    }
+}
+
+void
+GLState::DeleteBuffer(unsigned buffer) {
+    glDeleteBuffers(1, &buffer);
+    for (unsigned Target = 0; Target < BUFFER_TARGET_COUNT; ++Target) {
+        if (sBuffers[Target] == buffer) {
+            sBuffers[Target] = 0;
+        }
+    }
+}
+
+void
+GLState::DeleteTexture(unsigned texture) {
+    glDeleteTextures(1, &texture);
+    for (unsigned Unit = 0; Unit < MAX_TEXTURE_UNITS; ++Unit) {
+        if (sTextures[Unit] == texture) {
+            sTextures[Unit] = 0;
+        }
+    }
+}
+
+void
+GLState::Invalidate() {
+    sProgram = UNKNOWN;
+    sVertexArray = UNKNOWN;
+    for (unsigned Target = 0; Target < BUFFER_TARGET_COUNT; ++Target) {
+        sBuffers[Target] = UNKNOWN;
+    }
+    sActiveTexture = UNKNOWN;
+    for (unsigned Unit = 0; Unit < MAX_TEXTURE_UNITS; ++Unit) {
+        sTextures[Unit] = UNKNOWN;
+    }
+    for (unsigned Capability = 0; Capability < CAPABILITY_COUNT; ++Capability) {
+        sCapabilities[Capability] = -1;
+    }
+    sCullFace = UNKNOWN;
+    sDepthFunc = UNKNOWN;
+    sDepthMask = -1;
+    sColorMask = -1;
+}
+
+void
+GLState::ResetFrameCounters() {
+    sLastFrame = sCurrent;
+    sCurrent.Issued = 0;
+    sCurrent.Elided = 0;
+}
+
+GLState::FrameStats
+GLState::GetFrameStats() {
+    return sLastFrame;
+}
+
+int
+GLState::bufferTargetIndex(GLenum target) {
+    switch (target) {
+    case GL_ARRAY_BUFFER: return ARRAY_BUFFER;
+    case GL_ELEMENT_ARRAY_BUFFER: return ELEMENT_ARRAY_BUFFER;
+    case GL_UNIFORM_BUFFER: return UNIFORM_BUFFER;
+    case GL_TEXTURE_BUFFER: return TEXTURE_BUFFER;
+    case GL_DRAW_INDIRECT_BUFFER: return DRAW_INDIRECT_BUFFER;
+    default: return -1;
+    }
+}
+
+int
+GLState::capabilityIndex(GLenum capability) {
+    switch (capability) {
+    case GL_DEPTH_TEST: return DEPTH_TEST;
+    case GL_CULL_FACE: return CULL_FACE;
+    default: return -1;
+    }
+}
+
+bool
+GLState::changed(unsigned& cached, unsigned value) {
+    if (cached == value) {
+        sCurrent.Elided++;
+        return false;
+    }
+    sCurrent.Issued++;
+    cached = value;
+    return true;
+}
@@ -0,0 +1,92 @@
+/**
+ * @file glstate.hpp
+ * @brief Shadow copy of the GL binding and pipeline state. Calls that would not change
+ * anything are dropped, and both issued and dropped calls are counted per frame.
+ *
+ * Every bind of a cached object has to go through here, a direct gl* call leaves the
+ * cache stale. Call Invalidate after code that touches GL state behind its back.
+ */
+
+#pragma once
+#include <GL/glew.h>
+
+class GLState {
+public:
+    static const unsigned MAX_TEXTURE_UNITS = 16;
+
+    struct FrameStats {
+        unsigned Issued;
+        unsigned Elided;
+    };
+
+    static void UseProgram(unsigned program);
+    static unsigned GetProgram();
+    static void BindVertexArray(unsigned vao);
+    /**
+     * @brief Binds a buffer to one of the tracked targets. GL_ELEMENT_ARRAY_BUFFER is part of
+     * the bound VAO, so it is only cached until the next VAO change.
+     */
+    static void BindBuffer(GLenum target, unsigned buffer);
+    static void BindBufferBase(GLenum target, unsigned index, unsigned buffer);
+    static void BindBufferRange(GLenum target, unsigned index, unsigned buffer, GLintptr offset, GLsizeiptr size);
+    /**
+     * @brief Binds a texture to a unit. The cache is per unit, not per target, so a unit
+     * should stick to one target.
+     */
+    static void BindTexture(unsigned unit, unsigned texture, GLenum target = GL_TEXTURE_2D);
+    static void SetEnabled(GLenum capability, bool enabled);
+    static void SetCullFace(GLenum face);
+    static void SetDepthFunc(GLenum func);
+    static void SetDepthMask(bool enabled);
+    // All four channels at once
+    static void SetColorMask(bool enabled);
+
+    static void DeleteProgram(unsigned program);
+    static void DeleteVertexArray(unsigned vao);
+    static void DeleteBuffer(unsigned buffer);
+    static void DeleteTexture(unsigned texture);
+
+    /**
+     * @brief Forgets all cached state, the next call of every kind is issued
+     */
+    static void Invalidate();
+
+    /**
+     * @brief Ends the current frame's counting, the finished frame is kept for GetFrameStats
+     */
+    static void ResetFrameCounters();
+    static FrameStats GetFrameStats();
+
+private:
+    enum EBufferTarget {
+        ARRAY_BUFFER = 0,
+        ELEMENT_ARRAY_BUFFER,
+        UNIFORM_BUFFER,
+        TEXTURE_BUFFER,
+        DRAW_INDIRECT_BUFFER,
+        BUFFER_TARGET_COUNT,
+    };
+
+    enum ECapability {
+        DEPTH_TEST = 0,
+        CULL_FACE,
+        CAPABILITY_COUNT,
+    };
+
+    static unsigned sProgram;
+    static unsigned sVertexArray;
+    static unsigned sBuffers[BUFFER_TARGET_COUNT];
+    static unsigned sActiveTexture;
+    static unsigned sTextures[MAX_TEXTURE_UNITS];
+    static int sCapabilities[CAPABILITY_COUNT];
+    static GLenum sCullFace;
+    static GLenum sDepthFunc;
+    static int sDepthMask;
+    static int sColorMask;
+    static FrameStats sCurrent;
+    static FrameStats sLastFrame;
+
+    static int bufferTargetIndex(GLenum target);
+    static int capabilityIndex(GLenum capability);
+    static bool changed(unsigned& cached, unsigned value);
+};
@@ -0,0 +1,38 @@
+#include "gputimer.hpp"
+
+GpuTimer::GpuTimer() {
+    glGenQueries(LATENCY, mQueries);
+    for (unsigned QueryIdx = 0; QueryIdx < LATENCY; ++QueryIdx) {
+        mPending[QueryIdx] = false;
+    }
+    mCurrent = 0;
+    mMilliseconds = 0.0;
+}
+
+GpuTimer::~GpuTimer() {
+    glDeleteQueries(LATENCY, mQueries);
+}
+
+void
+GpuTimer::Begin() {
+    // The query is about to be reused, collect what it measured LATENCY frames ago
+    if (mPending[mCurrent]) {
+        GLuint64 Nanoseconds = 0;
+        glGetQueryObjectui64v(mQueries[mCurrent], GL_QUERY_RESULT, &Nanoseconds);
+        mMilliseconds = Nanoseconds / 1e6;
+        mPending[mCurrent] = false;
+    }
+    glBeginQuery(GL_TIME_ELAPSED, mQueries[mCurrent]);
+}
+
+void
+GpuTimer::End() {
+    glEndQuery(GL_TIME_ELAPSED);
+    mPending[mCurrent] = true;
+    mCurrent = (mCurrent + 1) % LATENCY;
+}
+
+double
+GpuTimer::GetMilliseconds() const {
+    return mMilliseconds;
+}
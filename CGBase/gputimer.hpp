@@ -0,0 +1,29 @@
+/**
+ * @file gputimer.hpp
+ * @brief GPU time of a span of commands, measured with GL_TIME_ELAPSED queries. Results are
+ * read LATENCY frames later, by then the GPU is done with them and reading does not stall.
+ *
+ * Time elapsed queries cannot nest, only one timer may be running at a time.
+ */
+
+#pragma once
+#include <GL/glew.h>
+
+class GpuTimer {
+public:
+    static const unsigned LATENCY = 3;
+
+    GpuTimer();
+    ~GpuTimer();
+
+    void Begin();
+    void End();
+    // Most recent finished measurement, 0 until the first one comes back
+    double GetMilliseconds() const;
+
+private:
+    unsigned mQueries[LATENCY];
+    bool mPending[LATENCY];
+    unsigned mCurrent;
+    double mMilliseconds;
+};
@@ -0,0 +1,27 @@
+#include "instancebuffer.hpp"
+
+InstanceBuffer::InstanceBuffer() {
+    glGenBuffers(1, &mVBO);
+    mCount = 0;
+}
+
+InstanceBuffer::~InstanceBuffer() {
+    GLState::DeleteBuffer(mVBO);
+}
+
+void
+InstanceBuffer::Upload(const std::vector<InstanceData>& instances) {
+    mCount = instances.size();
+    GLState::BindBuffer(GL_ARRAY_BUFFER, mVBO);
+    glBufferData(GL_ARRAY_BUFFER, mCount * sizeof(InstanceData), instances.data(), GL_STREAM_DRAW);
+}
+
+unsigned
+InstanceBuffer::GetId() const {
+    return mVBO;
+}
+
+unsigned
+InstanceBuffer::GetCount() const {
+    return mCount;
+}
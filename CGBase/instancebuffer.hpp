@@ -0,0 +1,34 @@
+/**
+ * @file instancebuffer.hpp
+ * @brief Per-instance vertex stream for instanced draws, see Renderable::RenderInstanced
+ *
+ */
+
+#pragma once
+#include <vector>
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+#include "glstate.hpp"
+
+// Layout of one instance, read by shaders/phong_instanced.vert
+struct InstanceData {
+    glm::mat4 Model;
+    glm::vec4 Color;
+};
+
+class InstanceBuffer {
+public:
+    InstanceBuffer();
+    ~InstanceBuffer();
+    /**
+     * @brief Replaces the buffer contents with a single write. The previous storage is
+     * orphaned, so draws still reading last frame's instances do not stall the upload.
+     */
+    void Upload(const std::vector<InstanceData>& instances);
+    unsigned GetId() const;
+    unsigned GetCount() const;
+
+private:
+    unsigned mVBO;
+    unsigned mCount;
+};
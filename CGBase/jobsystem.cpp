@@ -0,0 +1,102 @@
+#include "jobsystem.hpp"
+#include <algorithm>
+
+JobSystem::JobSystem(unsigned workerCount) {
+    if (!workerCount) {
+        unsigned HardwareThreads = std::thread::hardware_concurrency();
+        workerCount = HardwareThreads > 1 ? HardwareThreads - 1 : 1;
+    }
+
+    mJob = 0;
+    mJobCount = 0;
+    mActiveWorkers = 0;
+    mGeneration = 0;
+    mNextJob = 0;
+    mFinishedJobs = 0;
+    mBusyWorkers = 0;
+    mShutdown = false;
+    for (unsigned WorkerIdx = 0; WorkerIdx < workerCount; ++WorkerIdx) {
+        mWorkers.push_back(std::thread(&JobSystem::workerLoop, this, WorkerIdx));
+    }
+}
+
+JobSystem::~JobSystem() {
+    {
+        std::lock_guard<std::mutex> Lock(mMutex);
+        mShutdown = true;
+    }
+    mWake.notify_all();
+    for (unsigned WorkerIdx = 0; WorkerIdx < mWorkers.size(); ++WorkerIdx) {
+        mWorkers[WorkerIdx].join();
+    }
+}
+
+void
+JobSystem::Run(const std::function<void(unsigned)>& job, unsigned jobCount, unsigned maxThreads) {
+    if (!jobCount) {
+        return;
+    }
+
+    unsigned Threads = maxThreads ? std::min<unsigned>(maxThreads, GetThreadCount()) : GetThreadCount();
+    {
+        std::lock_guard<std::mutex> Lock(mMutex);
+        mJob = &job;
+        mJobCount = jobCount;
+        mActiveWorkers = Threads - 1;
+        mNextJob = 0;
+        mFinishedJobs = 0;
+        mGeneration++;
+    }
+    if (mActiveWorkers) {
+        mWake.notify_all();
+    }
+
+    runJobs();
+
+    // The batch lives on the caller's stack, so workers must be out of it before returning
+    std::unique_lock<std::mutex> Lock(mMutex);
+    mDone.wait(Lock, [this]() { return mFinishedJobs == mJobCount && mBusyWorkers == 0; });
+    mJob = 0;
+}
+
+unsigned
+JobSystem::GetThreadCount() const {
+    return mWorkers.size() + 1;
+}
+
+void
+JobSystem::workerLoop(unsigned workerIndex) {
+    unsigned SeenGeneration = 0;
+    while (true) {
+        {
+            std::unique_lock<std::mutex> Lock(mMutex);
+            mWake.wait(Lock, [&]() { return mShutdown || (mGeneration != SeenGeneration && workerIndex < mActiveWorkers); });
+            if (mShutdown) {
+                return;
+            }
+            SeenGeneration = mGeneration;
+            // Woke up after the caller already finished the batch
+            if (mFinishedJobs == mJobCount) {
+                continue;
+            }
+            mBusyWorkers++;
+        }
+
+        runJobs();
+
+        {
+            std::lock_guard<std::mutex> Lock(mMutex);
+            mBusyWorkers--;
+        }
+        mDone.notify_all();
+    }
+}
+
+void
+JobSystem::runJobs() {
+    unsigned JobIdx;
+    while ((JobIdx = mNextJob.fetch_add(1)) < mJobCount) {
+        (*mJob)(JobIdx);
+        mFinishedJobs.fetch_add(1);
+    }
+}
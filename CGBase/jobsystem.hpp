@@ -0,0 +1,53 @@
+/**
+ * @file jobsystem.hpp
+ * @brief Fixed pool of worker threads that runs a batch of indexed jobs. The calling thread
+ * works on the batch too and Run returns once every job has finished, so a frame can fan
+ * out CPU work and join before touching GL again.
+ *
+ * Jobs must not make GL calls, the context is current only on the main thread.
+ */
+
+#pragma once
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+
+class JobSystem {
+public:
+    /**
+     * @param workerCount Threads besides the caller, 0 uses one less than the hardware threads
+     */
+    JobSystem(unsigned workerCount = 0);
+    ~JobSystem();
+
+    /**
+     * @brief Calls job(0) ... job(jobCount - 1) in parallel and waits for all of them.
+     * Jobs are picked up in index order, but may finish in any order.
+     *
+     * @param maxThreads Limits the threads taking part, caller included. 0 uses all of them.
+     */
+    void Run(const std::function<void(unsigned)>& job, unsigned jobCount, unsigned maxThreads = 0);
+    // Workers plus the calling thread
+    unsigned GetThreadCount() const;
+
+private:
+    std::vector<std::thread> mWorkers;
+    std::mutex mMutex;
+    std::condition_variable mWake;
+    std::condition_variable mDone;
+    // Current batch, published under mMutex by bumping mGeneration
+    const std::function<void(unsigned)>* mJob;
+    unsigned mJobCount;
+    unsigned mActiveWorkers;
+    unsigned mGeneration;
+    std::atomic<unsigned> mNextJob;
+    std::atomic<unsigned> mFinishedJobs;
+    unsigned mBusyWorkers;
+    bool mShutdown;
+
+    void workerLoop(unsigned workerIndex);
+    void runJobs();
+};
@@ -0,0 +1,127 @@
+#include "lightbuffer.hpp"
+#include <cstddef>
+#include <iostream>
+#include <cstring>
+
+const char* LightBuffer::BLOCK_NAME = "Lights";
+
+// Cone values that keep the spot factor at 1 for lights that are not spotlights
+static const glm::vec4 NoCone = glm::vec4(-2.0f, 1.0f, 0.0f, 0.0f);
+
+LightBuffer::LightBuffer() {
+    mBlock = Block();
+    mBlock.Count = 0;
+    mDirty = true;
+
+    glGenBuffers(1, &mUBO);
+    GLState::BindBuffer(GL_UNIFORM_BUFFER, mUBO);
+    glBufferData(GL_UNIFORM_BUFFER, sizeof(Block), NULL, GL_DYNAMIC_DRAW);
+    GLState::BindBufferBase(GL_UNIFORM_BUFFER, BINDING_POINT, mUBO);
+}
+
+LightBuffer::~LightBuffer() {
+    GLState::DeleteBuffer(mUBO);
+}
+
+unsigned
+LightBuffer::AddDirectional(const glm::vec3& direction) {
+    return addLight(glm::vec4(0.0f), -direction, glm::vec4(1.0f, 0.0f, 0.0f, 1.0f), NoCone);
+}
+
+unsigned
+LightBuffer::AddPoint(const glm::vec3& position, float kc, float kl, float kq, float range) {
+    glm::vec4 Cone = NoCone;
+    Cone.z = 1.0f;
+    return addLight(glm::vec4(position, 1.0f), glm::vec3(0.0f), glm::vec4(kc, kl, kq, 1.0f / range), Cone);
+}
+
+unsigned
+LightBuffer::AddSpot(const glm::vec3& position, const glm::vec3& direction, float kc, float kl, float kq, float innerCutOff, float outerCutOff) {
+    glm::vec4 Cone(outerCutOff, 1.0f / (innerCutOff - outerCutOff), 0.0f, 0.0f);
+    return addLight(glm::vec4(position, 1.0f), -direction, glm::vec4(kc, kl, kq, 1.0f), Cone);
+}
+
+void
+LightBuffer::SetColor(unsigned light, const glm::vec3& ka, const glm::vec3& kd, const glm::vec3& ks) {
+    Light& L = mBlock.Lights[light];
+    L.Ka = glm::vec4(ka, 0.0f);
+    L.Kd = glm::vec4(kd, 0.0f);
+    L.Ks = glm::vec4(ks, 0.0f);
+    mDirty = true;
+}
+
+void
+LightBuffer::SetPosition(unsigned light, const glm::vec3& position) {
+    Light& L = mBlock.Lights[light];
+    L.Position = glm::vec4(position, L.Position.w);
+    mDirty = true;
+}
+
+void
+LightBuffer::SetDirection(unsigned light, const glm::vec3& direction) {
+    mBlock.Lights[light].Direction = glm::vec4(glm::normalize(-direction), 0.0f);
+    mDirty = true;
+}
+
+unsigned
+LightBuffer::GetCount() const {
+    return mBlock.Count;
+}
+
+glm::vec3
+LightBuffer::GetPosition(unsigned light) const {
+    return glm::vec3(mBlock.Lights[light].Position);
+}
+
+float
+LightBuffer::GetRange(unsigned light) const {
+    const Light& L = mBlock.Lights[light];
+    return L.Position.w != 0.0f && L.Attenuation.w > 0.0f ? 1.0f / L.Attenuation.w : 0.0f;
+}
+
+void
+LightBuffer::Upload() {
+    if (!mDirty) {
+        return;
+    }
+
+    // Only the header and the lights in use are sent
+    const unsigned Size = sizeof(Light) * mBlock.Count + offsetof(Block, Lights);
+    GLState::BindBuffer(GL_UNIFORM_BUFFER, mUBO);
+    glBufferSubData(GL_UNIFORM_BUFFER, 0, Size, &mBlock);
+    mDirty = false;
+}
+
+void
+LightBuffer::Upload(FrameRing& ring) {
+    // The bound range has to cover the whole block as declared, only the part in use is written
+    FrameRing::Allocation Range = ring.Allocate(sizeof(Block), ring.GetUniformAlignment());
+    if (!Range.Data) {
+        GLState::BindBufferBase(GL_UNIFORM_BUFFER, BINDING_POINT, mUBO);
+        mDirty = true;
+        Upload();
+        return;
+    }
+
+    memcpy(Range.Data, &mBlock, sizeof(Light) * mBlock.Count + offsetof(Block, Lights));
+    ring.BindRange(GL_UNIFORM_BUFFER, BINDING_POINT, Range);
+    // Draws outside the queue (e.g. a replayed static pass) read the lights before the queue flushes the ring
+    ring.Flush();
+}
+
+unsigned
+LightBuffer::addLight(const glm::vec4& position, const glm::vec3& direction, const glm::vec4& attenuation, const glm::vec4& cone) {
+    if (mBlock.Count >= (int)MAX_LIGHTS) {
+        std::cerr << "[Err] Light limit of " << MAX_LIGHTS << " reached" << std::endl;
+        return INVALID_LIGHT;
+    }
+
+    Light& L = mBlock.Lights[mBlock.Count];
+    L.Position = position;
+    L.Direction = glm::vec4(direction == glm::vec3(0.0f) ? direction : glm::normalize(direction), 0.0f);
+    L.Ka = L.Kd = L.Ks = glm::vec4(0.0f);
+    L.Attenuation = attenuation;
+    L.Cone = cone;
+    mDirty = true;
+    return mBlock.Count++;
+}
@@ -0,0 +1,74 @@
+/**
+ * @file lightbuffer.hpp
+ * @brief Scene lights packed into a std140 uniform block shared by all lit shaders
+ *
+ */
+
+#pragma once
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+#include "glstate.hpp"
+#include "framering.hpp"
+
+class LightBuffer {
+public:
+    // Must match MAX_LIGHTS in shaders/phong.frag
+    static const unsigned MAX_LIGHTS = 32;
+    static const unsigned BINDING_POINT = 0;
+    static const char* BLOCK_NAME;
+    // Returned by the Add functions once MAX_LIGHTS lights are in use
+    static const unsigned INVALID_LIGHT = 0xFFFFFFFF;
+
+    LightBuffer();
+    ~LightBuffer();
+
+    unsigned AddDirectional(const glm::vec3& direction);
+    /**
+     * @brief Point light with the scene's cubic falloff: distance is scaled by 1 / range
+     * and cubed before it enters the Kc + Kl * d + Kq * d^2 attenuation.
+     */
+    unsigned AddPoint(const glm::vec3& position, float kc, float kl, float kq, float range);
+    unsigned AddSpot(const glm::vec3& position, const glm::vec3& direction, float kc, float kl, float kq, float innerCutOff, float outerCutOff);
+
+    void SetColor(unsigned light, const glm::vec3& ka, const glm::vec3& kd, const glm::vec3& ks);
+    void SetPosition(unsigned light, const glm::vec3& position);
+    void SetDirection(unsigned light, const glm::vec3& direction);
+    unsigned GetCount() const;
+    glm::vec3 GetPosition(unsigned light) const;
+    // Distance the falloff is scaled by, 0 for directional lights
+    float GetRange(unsigned light) const;
+
+    /**
+     * @brief Uploads the lights to the uniform buffer if anything changed since the last upload
+     */
+    void Upload();
+    /**
+     * @brief Writes the lights into this frame's region of ring and binds that range instead
+     * of the buffer's own storage. Falls back to Upload if the region is full.
+     */
+    void Upload(FrameRing& ring);
+
+private:
+    // std140 layout, every member is a full vec4
+    struct Light {
+        glm::vec4 Position;    // xyz position, w = 0 for directional, 1 for positional
+        glm::vec4 Direction;   // xyz normalized direction towards the light
+        glm::vec4 Ka;
+        glm::vec4 Kd;
+        glm::vec4 Ks;
+        glm::vec4 Attenuation; // Kc, Kl, Kq, 1 / range
+        glm::vec4 Cone;        // cos(outer), 1 / (cos(inner) - cos(outer)), cubic falloff, unused
+    };
+
+    struct Block {
+        int Count;
+        int Padding[3];
+        Light Lights[MAX_LIGHTS];
+    };
+
+    unsigned mUBO;
+    bool mDirty;
+    Block mBlock;
+
+    unsigned addLight(const glm::vec4& position, const glm::vec3& direction, const glm::vec4& attenuation, const glm::vec4& cone);
+};
@@ -8,6 +8,7 @@
 #include <GLFW/glfw3.h>
 #include <chrono>
 #include <thread>
+#include <functional>
 
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
@@ -20,6 +21,25 @@
 #include "pyramidbuffer.hpp"
 #include "camera.hpp"
 #include "texture.hpp"
+#include "lightbuffer.hpp"
+#include "shaderwatcher.hpp"
+#include "renderqueue.hpp"
+#include "staticbatcher.hpp"
+#include "geometryarena.hpp"
+#include "commandlist.hpp"
+#include "jobsystem.hpp"
+#include "gputimer.hpp"
+#include "scenegraph.hpp"
+#include "transformstore.hpp"
+#include "scenefile.hpp"
+#include "sceneinstance.hpp"
+#include "frustumculler.hpp"
+#include "bvh.hpp"
+#include "occlusionculler.hpp"
+#include "stressscene.hpp"
+#include "animationsystem.hpp"
+#include "fixedtimestep.hpp"
+#include "prefabset.hpp"
 #include "stb_image.h"
 
 
@@ -28,6 +48,15 @@ const int WindowHeight = 1080;
 const std::string WindowTitle = "Chadd scene";
 const float TargetFPS = 144.0f;
 const float TargetFrameTime = 1.0f / TargetFPS;
+// Simulation runs at a fixed rate whatever the frame rate, speeds are per second of simulation
+const double SimulationStep = 1.0 / 120.0;
+const unsigned MaxSimulationSteps = 8;
+const float RugSpeed = 7.2f;
+const float SceneSpinSpeed = 24.0f;
+const float GrowSpeed = 7.2f;
+// G plants a forest of ForestSide x ForestSide trees around the scene, leaving the middle clear
+const unsigned ForestSide = 100;
+const float ForestSpacing = 3.0f;
 
 struct Input {
     bool MoveLeft;
@@ -42,12 +71,31 @@ struct Input {
     bool MoveRug;
     bool Grow;
     bool Shrink;
+    bool ShowStats;
+    bool RecordStatic;
+    bool RunJobBenchmark;
+    bool DepthPrepass;
+    bool RunTransformBenchmark;
+    bool Pick;
+    bool OcclusionCulling;
+    bool NextStressCount;
+    bool NextStressLayout;
+    bool NextAnimatedFraction;
+    bool ToggleForest;
 };
 
 struct EngineState {
     Input* mInput;
     Camera* mCamera;
-    float mDT;
+};
+
+// Everything the fixed steps move, rendering blends the previous and current one
+struct SimulationState {
+    glm::vec3 CameraPosition;
+    float RugXPosition;
+    float RugZPosition;
+    // Degrees the scene has spun around its root
+    float SceneAngle;
 };
 
 const std::vector<int> MinFilterValues = {
@@ -76,6 +124,17 @@ KeyCallback(GLFWwindow* window, int key, int scancode, int action, int mode) {
         switch (key) {
             case GLFW_KEY_R: UserInput->MoveRug = !UserInput->MoveRug; break;
             case GLFW_KEY_C: UserInput->ShouldRotate = !UserInput->ShouldRotate; break;
+            case GLFW_KEY_P: UserInput->ShowStats = !UserInput->ShowStats; break;
+            case GLFW_KEY_L: UserInput->RecordStatic = !UserInput->RecordStatic; break;
+            case GLFW_KEY_B: UserInput->RunJobBenchmark = true; break;
+            case GLFW_KEY_Z: UserInput->DepthPrepass = !UserInput->DepthPrepass; break;
+            case GLFW_KEY_T: UserInput->RunTransformBenchmark = true; break;
+            case GLFW_KEY_F: UserInput->Pick = true; break;
+            case GLFW_KEY_O: UserInput->OcclusionCulling = !UserInput->OcclusionCulling; break;
+            case GLFW_KEY_N: UserInput->NextStressCount = true; break;
+            case GLFW_KEY_M: UserInput->NextStressLayout = true; break;
+            case GLFW_KEY_K: UserInput->NextAnimatedFraction = true; break;
+            case GLFW_KEY_G: UserInput->ToggleForest = true; break;
             case GLFW_KEY_ESCAPE: glfwSetWindowShouldClose(window, GLFW_TRUE); break;
         }
     }
@@ -104,12 +163,6 @@ static void
 HandleInput(EngineState* state, GLFWwindow* Window) {
     Input* UserInput = state->mInput;
     Camera* FPSCamera = state->mCamera;
-        if (UserInput->LookLeft) FPSCamera->Move(-1.0f, 0.0f, state->mDT);
-        if (UserInput->LookRight) FPSCamera->Move(1.0f, 0.0f, state->mDT);
-        if (UserInput->LookUp) FPSCamera->Move(0.0f, -1.0f, state->mDT);
-        if (UserInput->LookDown) FPSCamera->Move(0.0f, 1.0f, state->mDT);
-        if (UserInput->Grow) FPSCamera->Grow();
-        if (UserInput->Shrink) FPSCamera->Shrink();
     float speed = 3.0f;
     float mouseSpeed = 0.015f;
     double  xpos, ypos;
@@ -124,12 +177,193 @@ HandleInput(EngineState* state, GLFWwindow* Window) {
     FPSCamera->updateVectors();
 }
 
+// One fixed step of everything held keys move. Mouse look stays in HandleInput, it is read once per frame
+static void
+StepSimulation(const Input& userInput, Camera& camera, SimulationState& state, float step) {
+    camera.SetPosition(state.CameraPosition);
+    if (userInput.LookLeft) camera.Move(-1.0f, 0.0f, step);
+    if (userInput.LookRight) camera.Move(1.0f, 0.0f, step);
+    if (userInput.LookUp) camera.Move(0.0f, -1.0f, step);
+    if (userInput.LookDown) camera.Move(0.0f, 1.0f, step);
+    if (userInput.Grow) camera.Grow(GrowSpeed * step);
+    if (userInput.Shrink) camera.Shrink(GrowSpeed * step);
+    // The height only reaches the position through updateVectors
+    camera.updateVectors();
+    state.CameraPosition = camera.GetPosition();
+
+    if (userInput.MoveDown) state.RugZPosition -= RugSpeed * step;
+    if (userInput.MoveUp) state.RugZPosition += RugSpeed * step;
+    if (userInput.MoveRight) state.RugXPosition += RugSpeed * step;
+    if (userInput.MoveLeft) state.RugXPosition -= RugSpeed * step;
+    // Spins on whether it is shown or not, wrapped to one turn so the angle keeps its precision
+    state.SceneAngle = std::fmod(state.SceneAngle + SceneSpinSpeed * step, 360.0f);
+}
+
+
+static void
+PrintFrameStats(const RenderQueue& queue, const FrameRing& ring, const RenderQueue& staticQueue, const CommandList& staticPass, bool replayed, double staticPassTime) {
+    GLState::FrameStats GLCalls = GLState::GetFrameStats();
+    FrameRing::FrameStats RingStats = ring.GetFrameStats();
+    std::cout << "Draw packets: " << queue.GetPacketCount() << ", GL draw calls: " << queue.GetDrawCallCount() << std::endl;
+    std::cout << "Frustum culling: " << queue.GetCulledCount() << " culled, " << queue.GetPacketCount() << " submitted" << std::endl;
+    std::cout << "GL state calls: " << GLCalls.Issued << " issued, " << GLCalls.Elided << " elided" << std::endl;
+    std::cout << "Frame ring: " << RingStats.BytesUsed << " bytes, " << RingStats.Stalls << " stalls"
+        << (ring.IsPersistent() ? "" : " (glBufferSubData)") << std::endl;
+    GeometryArena::Stats Arena = GeometryArena::GetStats();
+    CommandList::Stats ListStats = staticPass.GetStats();
+    unsigned StaticDraws = staticQueue.GetPacketCount();
+    std::cout << "Static pass: " << StaticDraws << " draws " << (replayed ? "replayed" : "submitted") << " in "
+        << staticPassTime * 1e6 << " us (" << (StaticDraws ? staticPassTime * 1e6 / StaticDraws : 0.0) << " us/draw), "
+        << ListStats.Commands << " commands in " << ListStats.Bytes << " bytes, recorded " << ListStats.Recordings << " times" << std::endl;
+    std::cout << "Geometry arena: " << Arena.VerticesUsed << "/" << Arena.VertexCapacity << " vertices, "
+        << Arena.IndicesUsed << "/" << Arena.IndexCapacity << " indices, " << Arena.FreeBlocks << " free blocks, "
+        << Arena.Growths << " buffer growths" << std::endl;
+}
+
+static void
+PrintBvhStats(const BVH& bvh, const LightBuffer& lights, const unsigned* pointLights, unsigned pointLightCount, unsigned visible) {
+    BVH::Stats Tree = bvh.GetStats();
+    std::cout << "BVH: " << visible << "/" << Tree.Objects << " objects visible, " << Tree.Nodes << " nodes, " << Tree.Refits << " refits, "
+        << Tree.Rebuilds << " rebuilds, SAH cost " << Tree.Cost << " (" << Tree.BuildCost << " after build)" << std::endl;
+    // Objects each point light reaches, what a per-object light list would be built from
+    unsigned Reached[256];
+    std::cout << "Point light reach:";
+    for (unsigned LightIdx = 0; LightIdx < pointLightCount; ++LightIdx) {
+        std::cout << " " << bvh.QuerySphere(lights.GetPosition(pointLights[LightIdx]), lights.GetRange(pointLights[LightIdx]), Reached, 256);
+    }
+    std::cout << " objects" << std::endl;
+}
+
+static void
+PrintStressStats(const StressScene& stress, const RenderQueue& queue, double frameTime, double submitTime, double mergeTime, double executeTime, float gpuTime) {
+    StressScene::Stats Field = stress.GetStats();
+    std::cout << "Stress field: " << Field.Objects << " objects (" << Field.Animated << " animated), " << Field.Visible << " visible, "
+        << queue.GetPacketCount() << " draw packets, " << queue.GetDrawCallCount() << " GL draw calls" << std::endl;
+    std::cout << "  CPU frame " << frameTime * 1e3 << " ms: animate " << Field.AnimateTime * 1e3 << ", cull " << Field.CullTime * 1e3
+        << ", submit jobs " << submitTime * 1e3 << ", merge " << mergeTime * 1e3 << ", execute " << executeTime * 1e3
+        << " ms; GPU main pass " << gpuTime << " ms" << std::endl;
+}
 
 static void
 ScrollCallback(GLFWwindow* window, double xoffset, double yoffset) {
     mScalingFactor += yoffset*0.1;
 }
 
+static void
+PrintPassTimes(const GpuTimer& prepassTimer, const GpuTimer& mainPassTimer, bool prepass) {
+    if (prepass) {
+        std::cout << "GPU: depth pre-pass " << prepassTimer.GetMilliseconds() << " ms, main pass " << mainPassTimer.GetMilliseconds()
+            << " ms, total " << prepassTimer.GetMilliseconds() + mainPassTimer.GetMilliseconds() << " ms" << std::endl;
+        return;
+    }
+    std::cout << "GPU: main pass " << mainPassTimer.GetMilliseconds() << " ms (depth pre-pass off)" << std::endl;
+}
+
+// World matrices per second of TransformStore against chained glm calls, on trees of 1k, 100k and 1M nodes
+static void
+RunTransformBenchmark() {
+    const unsigned NodeCounts[] = { 1000, 100000, 1000000 };
+    const unsigned Branching = 8;
+    const unsigned Repeats = 5;
+    for (unsigned NodeCount : NodeCounts) {
+        TransformStore Store;
+        Store.Reserve(NodeCount);
+        std::vector<unsigned> Parents(NodeCount);
+        std::vector<glm::vec3> Positions(NodeCount);
+        std::vector<glm::quat> Rotations(NodeCount);
+        std::vector<glm::vec3> Scales(NodeCount);
+        for (unsigned NodeIdx = 0; NodeIdx < NodeCount; ++NodeIdx) {
+            // Every node has Branching children, node 0 is the only root
+            Parents[NodeIdx] = NodeIdx ? (NodeIdx - 1) / Branching : TransformStore::INVALID_HANDLE;
+            Positions[NodeIdx] = glm::vec3(NodeIdx % 7 * 0.1f, NodeIdx % 5 * 0.1f, NodeIdx % 3 * 0.1f);
+            Rotations[NodeIdx] = glm::angleAxis(glm::radians((float)(NodeIdx % 360)), glm::vec3(0.0, 1.0, 0.0));
+            Scales[NodeIdx] = glm::vec3(1.0f + NodeIdx % 4 * 0.01f);
+            Store.Add(Parents[NodeIdx], Positions[NodeIdx], Rotations[NodeIdx], Scales[NodeIdx]);
+        }
+
+        double StoreTime = 1e9;
+        for (unsigned RepeatIdx = 0; RepeatIdx < Repeats; ++RepeatIdx) {
+            std::chrono::high_resolution_clock::time_point Start = std::chrono::high_resolution_clock::now();
+            Store.Update();
+            std::chrono::duration<double> Time = std::chrono::high_resolution_clock::now() - Start;
+            StoreTime = std::min(StoreTime, Time.count());
+        }
+
+        std::vector<glm::mat4> World(NodeCount);
+        double ChainedTime = 1e9;
+        for (unsigned RepeatIdx = 0; RepeatIdx < Repeats; ++RepeatIdx) {
+            std::chrono::high_resolution_clock::time_point Start = std::chrono::high_resolution_clock::now();
+            for (unsigned NodeIdx = 0; NodeIdx < NodeCount; ++NodeIdx) {
+                glm::mat4 Local = glm::translate(glm::mat4(1.0f), Positions[NodeIdx]) * glm::mat4_cast(Rotations[NodeIdx]);
+                Local = glm::scale(Local, Scales[NodeIdx]);
+                World[NodeIdx] = NodeIdx ? World[Parents[NodeIdx]] * Local : Local;
+            }
+            std::chrono::duration<double> Time = std::chrono::high_resolution_clock::now() - Start;
+            ChainedTime = std::min(ChainedTime, Time.count());
+        }
+
+        std::cout << "Transforms, " << NodeCount << " nodes in " << Store.GetLevelCount() << " levels: "
+            << NodeCount / StoreTime / 1e6 << " M matrices/s SoA SSE, " << NodeCount / ChainedTime / 1e6 << " M matrices/s chained glm" << std::endl;
+    }
+}
+
+// Builds a scaled-up field of stars and bees on 1, 2, 4, ... threads and prints how packet generation scales
+static void
+RunJobBenchmark(JobSystem& jobs, RenderQueue& queue, const Model& star, const Model& bee, Shader& shader) {
+    const unsigned JobCount = 256;
+    const unsigned ObjectsPerJob = 256;
+    const unsigned Repeats = 5;
+    std::vector<RenderQueue::DrawList> Lists(JobCount);
+    std::function<void(unsigned)> Generate = [&](unsigned jobIdx) {
+        RenderQueue::DrawList& List = Lists[jobIdx];
+        List.Clear();
+        for (unsigned ObjectIdx = 0; ObjectIdx < ObjectsPerJob; ++ObjectIdx) {
+            float Phase = (float)(jobIdx * ObjectsPerJob + ObjectIdx);
+            glm::mat4 m(1.0f);
+            m = glm::rotate(m, glm::radians(Phase * 0.1f), glm::vec3(0.0, 1.0, 0.0));
+            m = glm::translate(m, glm::vec3(2.0f + jobIdx * 0.05f, 1.0f + sin(Phase / 4) / 10, 0.0f));
+            m = glm::rotate(m, glm::radians(Phase * 5), glm::vec3(0.0, 1.0, 0.0));
+            m = glm::scale(m, glm::vec3(0.012));
+            (ObjectIdx % 2 ? star : bee).Submit(List, shader, m, glm::vec3(0.7, 0.7, 0.2));
+        }
+    };
+
+    // Warm-up, so the lists have their storage before anything is timed
+    jobs.Run(Generate, JobCount);
+    unsigned Draws = 0;
+    for (unsigned JobIdx = 0; JobIdx < JobCount; ++JobIdx) {
+        Draws += Lists[JobIdx].GetCount();
+    }
+    std::cout << "Job benchmark: " << JobCount * ObjectsPerJob << " objects, " << Draws << " draw packets, "
+        << jobs.GetThreadCount() << " threads available" << std::endl;
+
+    double SingleThreadTime = 0.0;
+    for (unsigned Threads = 1; ; Threads = std::min(2 * Threads, jobs.GetThreadCount())) {
+        double BestTime = 1e9;
+        for (unsigned RepeatIdx = 0; RepeatIdx < Repeats; ++RepeatIdx) {
+            std::chrono::high_resolution_clock::time_point Start = std::chrono::high_resolution_clock::now();
+            jobs.Run(Generate, JobCount, Threads);
+            std::chrono::duration<double> Time = std::chrono::high_resolution_clock::now() - Start;
+            BestTime = std::min(BestTime, Time.count());
+        }
+        SingleThreadTime = Threads == 1 ? BestTime : SingleThreadTime;
+        std::cout << "  " << Threads << " threads: " << BestTime * 1e3 << " ms, speedup " << SingleThreadTime / BestTime << "x" << std::endl;
+        if (Threads == jobs.GetThreadCount()) {
+            break;
+        }
+    }
+
+    // The merge runs on the render thread whatever the thread count, it bounds the speedup
+    std::chrono::high_resolution_clock::time_point MergeStart = std::chrono::high_resolution_clock::now();
+    queue.Begin(glm::vec3(0.0f), 20.0f);
+    for (unsigned JobIdx = 0; JobIdx < JobCount; ++JobIdx) {
+        queue.Submit(Lists[JobIdx]);
+    }
+    std::chrono::duration<double> MergeTime = std::chrono::high_resolution_clock::now() - MergeStart;
+    std::cout << "  merge into the queue: " << MergeTime.count() * 1e3 << " ms" << std::endl;
+    queue.Begin(glm::vec3(0.0f), 20.0f);
+}
+
 int main() {
     GLFWwindow* Window = 0;
     if (!glfwInit()) {
@@ -158,161 +392,199 @@ int main() {
         return -1;
     }
 
+    Shader::EnableParallelCompile();
+    Shader::EnableSpirv();
+
     glfwSetFramebufferSizeCallback(Window, FramebufferSizeCallback);
     glfwSetKeyCallback(Window, KeyCallback);
     glfwSetScrollCallback(Window, ScrollCallback);
 
-    Shader LightShader("shaders/basic.vert", "shaders/basic.frag");
-    Shader BasicShader("shaders/phong.vert", "shaders/phong.frag");
-    glUseProgram(BasicShader.GetId());
-    BasicShader.SetUniform3f("uDirLight.Direction", glm::vec3(1.0f, -1.0f, 1.0f));
-
-    BasicShader.SetUniform3f("uDirLight.Ka", glm::vec3(0.1275f, 0.1275f, 0.1275f));
-    BasicShader.SetUniform3f("uDirLight.Kd", glm::vec3(0.4284f, 0.4284f, 0.4284f));
-    BasicShader.SetUniform3f("uDirLight.Ks", glm::vec3(0.271906f, 0.271906f, 0.271906f));
-
-    //BasicShader.SetUniform3f("uDirLight.Ka", glm::vec3(0.0f, 0.0f, 0.0f));
-    //BasicShader.SetUniform3f("uDirLight.Kd", glm::vec3(0.0f, 0.0f, 0.0f));
-    //BasicShader.SetUniform3f("uDirLight.Ks", glm::vec3(0.0f, 0.0f, 0.0f));
-
-
-    BasicShader.SetUniform1f("uPointLight1.Kc", 1.0f);
-    BasicShader.SetUniform1f("uPointLight1.Kl", 0.7);
-    BasicShader.SetUniform1f("uPointLight1.Kq", 1.8);
-
-    BasicShader.SetUniform1f("uPointLight2.Kc", 1.0f);
-    BasicShader.SetUniform1f("uPointLight2.Kl", 0.7);
-    BasicShader.SetUniform1f("uPointLight2.Kq", 1.8);
-
-    BasicShader.SetUniform1f("uPointLight3.Kc", 1.0f);
-    BasicShader.SetUniform1f("uPointLight3.Kl", 0.7);
-    BasicShader.SetUniform1f("uPointLight3.Kq", 1.8);
-
-    BasicShader.SetUniform1f("uPointLight4.Kc", 1.0f);
-    BasicShader.SetUniform1f("uPointLight4.Kl", 0.7);
-    BasicShader.SetUniform1f("uPointLight4.Kq", 1.8);
-
-    BasicShader.SetUniform3f("uSpotlight.Ka", glm::vec3(0.7f, 0.1f, 0.1f));
-    BasicShader.SetUniform3f("uSpotlight.Kd", glm::vec3(0.7f, 0.1f, 0.1f));
-    BasicShader.SetUniform3f("uSpotlight.Ks", glm::vec3(0.7f, 0.1f, 0.1f));
-
-    //BasicShader.SetUniform3f("uSpotlight.Ka", glm::vec3(0.0f, 0.0f, 0.0f));
-    //BasicShader.SetUniform3f("uSpotlight.Kd", glm::vec3(0.0f, 0.0f, 0.0f));
-    //BasicShader.SetUniform3f("uSpotlight.Ks", glm::vec3(0.0f, 0.0f, 0.0f));
-
-    BasicShader.SetUniform1f("uSpotlight.Kc", 1.0f);
-    BasicShader.SetUniform1f("uSpotlight.Kl", 0.092f);
-    BasicShader.SetUniform1f("uSpotlight.Kq", 0.032f);
-
-    BasicShader.SetUniform1f("uSpotlight.InnerCutOff", glm::cos(glm::radians(13.5f)));
-    BasicShader.SetUniform1f("uSpotlight.OuterCutOff", glm::cos(glm::radians(17.5f)));
-
-    BasicShader.SetUniform1i("uMaterial.Kd", 0);
-    BasicShader.SetUniform1i("uMaterial.Ks", 1);
-    BasicShader.SetUniform1f("uMaterial.Shininess", 128.0f);
-    glUseProgram(0);
-
-    Model Star("res/star/star.obj");
-    if (!Star.Load()) {
-        std::cerr << "Failed to load model" << std::endl;
-        glfwTerminate();
-        return -1;
+    ShaderBatch Programs;
+    Shader LightShader("shaders/basic.vert", "shaders/basic.frag", Programs);
+    Shader BasicShader("shaders/phong.vert", "shaders/phong.frag", Programs);
+    Shader RugShader("shaders/rug.vert", "shaders/phong.frag", Programs);
+    Shader MultiDrawShader("shaders/phong_multidraw.vert", "shaders/phong.frag", Programs);
+    Shader DepthShader("shaders/depth.vert", "shaders/depth.frag", Programs);
+    Shader DepthMultiDrawShader("shaders/depth_multidraw.vert", "shaders/depth.frag", Programs);
+    Shader InstancedShader("shaders/phong_instanced.vert", "shaders/phong.frag", Programs);
+    if (!Programs.Build()) {
+        std::cerr << "Failed to build shaders" << std::endl;
     }
+    ShaderWatcher Watcher("shaders");
+    Watcher.Watch(&LightShader);
+    Watcher.Watch(&BasicShader);
+    Watcher.Watch(&RugShader);
+    Watcher.Watch(&MultiDrawShader);
+    Watcher.Watch(&DepthShader);
+    Watcher.Watch(&DepthMultiDrawShader);
+    Watcher.Watch(&InstancedShader);
+
+    LightBuffer Lights;
+    Shader* LitShaders[] = { &BasicShader, &RugShader, &MultiDrawShader, &InstancedShader };
+    for (Shader* LitShader : LitShaders) {
+        GLState::UseProgram(LitShader->GetId());
+        LitShader->SetUniformBlockBinding(LightBuffer::BLOCK_NAME, LightBuffer::BINDING_POINT);
+        LitShader->SetUniform1i("uMaterial.Kd", 0);
+        LitShader->SetUniform1i("uMaterial.Ks", 1);
+        LitShader->SetUniform1f("uMaterial.Shininess", 128.0f);
+    }
+    GLState::UseProgram(MultiDrawShader.GetId());
+    MultiDrawShader.SetUniform1i("uDrawData", RenderQueue::DRAW_DATA_UNIT);
+    GLState::UseProgram(DepthMultiDrawShader.GetId());
+    DepthMultiDrawShader.SetUniform1i("uDrawData", RenderQueue::DRAW_DATA_UNIT);
+    GLState::UseProgram(0);
 
-    Model Bee("res/bee/bee.obj");
-    if (!Bee.Load()) {
-        std::cerr << "Failed to load model" << std::endl;
+    CubeBuffer cubeBuffer;
+    Renderable cube(cubeBuffer.GetVertices(), cubeBuffer.GetVertexCount(), cubeBuffer.GetIndices(), cubeBuffer.GetIndicesCount());
+    PyramidBuffer pyramidBuffer;
+    Renderable pyramid(pyramidBuffer.GetVertices(), pyramidBuffer.GetVertexCount(), pyramidBuffer.GetIndices(), pyramidBuffer.GetIndicesCount());
+    // The rug is a grid of cubes animated entirely in shaders/rug.vert
+    const int RugColumns = 26;
+    const int RugRows = 51;
+    const float RugCellSize = 0.02f;
+    const double RugWavePeriod = 4 * 3.14159265358979;
+
+    // The scene comes from res/scene.txt, its static nodes (ground and pyramids) are baked into one batch per material
+    StaticBatcher::Geometry CubeGeometry = { cubeBuffer.GetVertices(), cubeBuffer.GetVertexCount(), cubeBuffer.GetIndices(), cubeBuffer.GetIndicesCount() };
+    StaticBatcher::Geometry PyramidGeometry = { pyramidBuffer.GetVertices(), pyramidBuffer.GetVertexCount(), pyramidBuffer.GetIndices(), pyramidBuffer.GetIndicesCount() };
+    // Everything that turns with the scene hangs off SceneRoot, so the spin is one root update
+    SceneGraph Scene;
+    SceneGraph::NodeId SceneRoot = Scene.CreateNode(SceneGraph::INVALID_NODE);
+    StaticBatcher StaticScene;
+    SceneFile SceneDescription;
+    SceneInstance SceneObjects;
+    SceneObjects.SetShader("phong", &BasicShader);
+    SceneObjects.SetShader("basic", &LightShader);
+    SceneObjects.SetPrimitive("cube", &cube, CubeGeometry);
+    SceneObjects.SetPrimitive("pyramid", &pyramid, PyramidGeometry);
+    // The baked scenery (ground and pyramids) and the trees double as the occluders
+    OcclusionCuller Occlusion;
+    SceneObjects.SetOcclusionCuller(&Occlusion);
+    // Spins and bobs of the scene file's animators, the light flicker and the rug's wave are channels of one system
+    AnimationSystem Animation;
+    SceneObjects.SetAnimation(&Animation);
+    // Trees are prefab instances, all of them drawn with one instanced draw per part
+    PrefabSet Prefabs;
+    SceneObjects.SetPrefabs(&Prefabs);
+    std::chrono::high_resolution_clock::time_point SceneLoadStart = std::chrono::high_resolution_clock::now();
+    if (!SceneDescription.Load("res/scene.txt")) {
+        std::cerr << "Failed to load scene" << std::endl;
         glfwTerminate();
         return -1;
     }
-
-    Model Goku("res/goku/Goku.obj");
-    if (!Goku.Load()) {
-        std::cerr << "Failed to load model" << std::endl;
+    std::chrono::duration<double> SceneLoadTime = std::chrono::high_resolution_clock::now() - SceneLoadStart;
+    std::cout << "Scene description: " << SceneDescription.GetCount(SceneFile::SECTION_NODES) << " nodes, "
+        << SceneDescription.GetCount(SceneFile::SECTION_DRAWS) << " draws " << (SceneDescription.IsMapped() ? "mapped" : "parsed")
+        << " in " << SceneLoadTime.count() * 1e3 << " ms" << std::endl;
+    if (!SceneObjects.Create(SceneDescription, Scene, SceneRoot, StaticScene, Lights)) {
+        std::cerr << "Failed to create scene" << std::endl;
         glfwTerminate();
         return -1;
     }
-
-    Model Dragon("res/dragon/dragon.obj");
-    if (!Dragon.Load()) {
-        std::cerr << "Failed to load model" << std::endl;
+    StaticScene.Build();
+    std::cout << "Static scenery baked into " << StaticScene.GetBatchCount() << " batches" << std::endl;
+    PrefabSet::PrefabId TreePrefab = Prefabs.FindPrefab("tree");
+    unsigned SceneTrees = TreePrefab == PrefabSet::INVALID_PREFAB ? 0 : Prefabs.GetInstanceCount(TreePrefab);
+    unsigned WhiteTexture = SceneObjects.FindTexture("white");
+    unsigned ClothTexture = SceneObjects.FindTexture("cloth");
+    unsigned PointLights[4];
+    for (unsigned i = 0; i < 4; i++)
+    {
+        PointLights[i] = SceneObjects.FindLight("point" + std::to_string(i));
+    }
+    unsigned Spotlight = SceneObjects.FindLight("spot");
+    // The lights are animated from here, the scene has to provide every one of them
+    if (PointLights[0] == SceneFile::NONE || PointLights[1] == SceneFile::NONE || PointLights[2] == SceneFile::NONE
+        || PointLights[3] == SceneFile::NONE || Spotlight == SceneFile::NONE) {
+        std::cerr << "Scene is missing one of the lights point0 to point3 or spot" << std::endl;
         glfwTerminate();
         return -1;
     }
-
-
-    unsigned BrickTexture = Texture::LoadImageToTexture("textures/brick.png");
-    glBindTexture(GL_TEXTURE_2D, BrickTexture);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    glBindTexture(GL_TEXTURE_2D, 0);
-
-    unsigned BrickSmallTexture = Texture::LoadImageToTexture("textures/brickSmall.png");
-    glBindTexture(GL_TEXTURE_2D, BrickSmallTexture);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    glBindTexture(GL_TEXTURE_2D, 0);
-
-    unsigned ClothTexture = Texture::LoadImageToTexture("textures/cloth.jpg");
-    glBindTexture(GL_TEXTURE_2D, ClothTexture);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    glBindTexture(GL_TEXTURE_2D, 0);
-
-    unsigned SandTexture = Texture::LoadImageToTexture("textures/sand.jpg");
-    glBindTexture(GL_TEXTURE_2D, SandTexture);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    glBindTexture(GL_TEXTURE_2D, 0);
-
-    unsigned MoonTexture = Texture::LoadImageToTexture("textures/moon.jpg");
-    glBindTexture(GL_TEXTURE_2D, MoonTexture);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    glBindTexture(GL_TEXTURE_2D, 0);
-
-
-    unsigned TreeTexture = Texture::LoadImageToTexture("textures/tree.jpg");
-    glBindTexture(GL_TEXTURE_2D, TreeTexture);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    glBindTexture(GL_TEXTURE_2D, 0);
-
-
-    unsigned LeafTexture = Texture::LoadImageToTexture("textures/leaf.jpg");
-    glBindTexture(GL_TEXTURE_2D, LeafTexture);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    glBindTexture(GL_TEXTURE_2D, 0);
-
-    unsigned WhiteTexture = Texture::LoadImageToTexture("textures/white.png");
-    unsigned BlackDotsTexture = Texture::LoadImageToTexture("textures/blackWithDots.jpg");
-    unsigned BlackTexture = Texture::LoadImageToTexture("textures/black.jpg");
-
-    CubeBuffer cubeBuffer;
-    Renderable cube(cubeBuffer.GetVertices(), cubeBuffer.GetVertexCount(), cubeBuffer.GetIndices(), cubeBuffer.GetIndicesCount());
-    PyramidBuffer pyramidBuffer;
-    Renderable pyramid(pyramidBuffer.GetVertices(), pyramidBuffer.GetVertexCount(), pyramidBuffer.GetIndices(), pyramidBuffer.GetIndicesCount());
-
-    glm::mat4 m(1.0f);
+    // Point lights flicker out of phase and bob together, the flicker only ever adds red
+    const float PointLightPhases[4] = { 0, 60, 120, 180 };
+    const glm::vec3 PointLightBases[4] = { glm::vec3(1.34, 1.25, -1.34), glm::vec3(-1.34, 1.25, -1.34), glm::vec3(1.4, 1.05, 1.4), glm::vec3(-1.4, 1.05, 1.4) };
+    const glm::vec3 PointLightColors[3] = { glm::vec3(0.1f, 0.01f, 0.01f), glm::vec3(0.0f, 0.1f, 0.1f), glm::vec3(0.0f, 0.1f, 0.1f) };
+    const glm::vec3 PointLightFlicker[3] = { glm::vec3(0.1f, 0.0f, 0.0f), glm::vec3(0.4f, 0.0f, 0.0f), glm::vec3(1.0f, 0.0f, 0.0f) };
+    AnimationSystem::ChannelId PointLightBob = Animation.AddWave(3.75f, 0.0f, 0.1f, 0.0f);
+    for (unsigned i = 0; i < 4; i++)
+    {
+        AnimationSystem::ChannelId Flicker = Animation.AddWave(3.75f, PointLightPhases[i] / 4, -1.0f, 1.0f, 0.0f, 1.0f);
+        Animation.BindLightColor(Flicker, PointLights[i], PointLightColors, PointLightFlicker);
+        Animation.BindLightOffset(PointLightBob, PointLights[i], PointLightBases[i], glm::vec3(0.0f, 1.0f, 0.0f));
+    }
+    // The rug bobs as a whole, the spotlight follows the wave of its middle cell, the same terms as shaders/rug.vert
+    AnimationSystem::ChannelId RugBob = Animation.AddWave(1.5f, 0.0f, 0.25f, 0.0f);
+    AnimationSystem::ChannelId RugMiddleWaves[2] = {
+        Animation.AddWave(7.5f, 13.0f / 4, 1.0f / 120, 0.0f), Animation.AddWave(7.5f, 25.0f / 4, 1.0f / 120, 0.0f),
+    };
+    const Model* Star = SceneObjects.FindModel("star");
+    const Model* Bee = SceneObjects.FindModel("bee");
+
+    // Stress mode fills the world with copies of the scene's building blocks, N steps the object count,
+    // M switches between grid and Poisson placement and K steps the animated share
+    StressScene Stress;
+    const char* StressBlocks[][2] = {
+        { "tree1", 0 }, { "pyramid1", "pyramid_cap1" }, { "star0", 0 }, { "bee0", 0 }, { "goku", 0 }, { "dragon", 0 },
+    };
+    for (const auto& BlockRoots : StressBlocks) {
+        std::vector<std::string> Roots;
+        for (const char* Root : BlockRoots) {
+            if (Root) {
+                Roots.push_back(Root);
+            }
+        }
+        if (!SceneObjects.AddStressBlock(SceneDescription, Roots, Stress)) {
+            std::cerr << "Failed to add stress block " << Roots[0] << ", the stress field goes without it" << std::endl;
+        }
+    }
+    const unsigned StressCounts[] = { 0, 1000, 10000, 100000, 1000000 };
+    const float AnimatedFractions[] = { 0.25f, 0.5f, 1.0f, 0.0f };
+    unsigned StressLevel = 0;
+    unsigned AnimatedLevel = 0;
+    StressScene::Settings StressSettings = { 0, StressScene::LAYOUT_GRID, AnimatedFractions[0], 3.0f, 1 };
+    double StressSubmitTime = 0.0;
+    double StressMergeTime = 0.0;
+    double StressExecuteTime = 0.0;
+    double FrameWorkTime = 0.0;
+
+    RenderQueue Queue;
+    Queue.SetDefaultTextures(WhiteTexture, WhiteTexture);
+    Queue.EnableMultiDraw(BasicShader, MultiDrawShader);
+    Queue.SetDepthProgram(BasicShader, DepthShader);
+    Queue.SetDepthProgram(MultiDrawShader, DepthMultiDrawShader);
+    // Per-frame GPU data: lights, indirect commands and multi-draw records
+    FrameRing Ring(256 * 1024);
+    Queue.SetFrameRing(&Ring);
+    // Only the per-frame queue is culled, the static pass is recorded and replayed from any view
+    FrustumCuller Culler;
+    Queue.SetCuller(&Culler);
+    // The scene's moving draws and the rug are culled as whole objects through a BVH before any job
+    // touches them, boxes are filled in every frame before the first Update builds the tree
+    BVH SceneBvh;
+    for (unsigned DrawIdx = 0; DrawIdx < SceneObjects.GetDrawCount(); ++DrawIdx) {
+        SceneBvh.Insert(glm::vec3(0.0f), glm::vec3(0.0f), DrawIdx);
+    }
+    const unsigned RugObjectData = SceneObjects.GetDrawCount();
+    BVH::ObjectId RugObject = SceneBvh.Insert(glm::vec3(0.0f), glm::vec3(0.0f), RugObjectData);
+    // A cell rotates within its cube's sphere, scaled like shaders/rug.vert scales the cube
+    const float RugCellPadding = cube.GetBounds().Radius * 2.5f * RugCellSize;
+    std::vector<unsigned> VisibleObjects(SceneObjects.GetDrawCount() + 1);
+    std::vector<unsigned> VisibleDraws(SceneObjects.GetDrawCount());
+    unsigned VisibleDrawCount = 0;
+    bool RugVisible = true;
+
+    // The ground and the baked scenery only change when the scene rotates, they are recorded once and replayed
+    RenderQueue StaticQueue;
+    StaticQueue.SetDefaultTextures(WhiteTexture, WhiteTexture);
+    CommandList StaticPass;
+    CommandList StaticDepthPass;
+    StaticQueue.SetDepthProgram(BasicShader, DepthShader);
+    GpuTimer PrepassTimer;
+    GpuTimer MainPassTimer;
+    double StaticPassTime = 0.0;
     
-    float angle = 0;
-    glEnable(GL_DEPTH_TEST);
-    glEnable(GL_CULL_FACE);
+    GLState::SetEnabled(GL_DEPTH_TEST, true);
+    GLState::SetEnabled(GL_CULL_FACE, true);
     glClearColor(0.05, 0.1, 0.2, 1.0);
 
     float FrameStartTime = glfwGetTime();
@@ -320,7 +592,10 @@ int main() {
     float dt = FrameEndTime - FrameStartTime;
     float RugXPosition = -0.6;
     float RugZPosition = -0.3;
+    FixedTimestep Simulation(SimulationStep, MaxSimulationSteps);
     float Distance = 2.5f;
+    float LastStatsTime = glfwGetTime();
+    float LastStressStatsTime = glfwGetTime();
 
     EngineState State = { 0 };
     Camera FPSCamera;
@@ -334,32 +609,85 @@ int main() {
     glfwWindowHint(GLFW_DECORATED, false);
     UserInput.ShouldRotate = false;
     UserInput.MoveRug = true;
+    UserInput.RecordStatic = true;
+    UserInput.OcclusionCulling = true;
+
+    SimulationState CurrentState = { FPSCamera.GetPosition(), RugXPosition, RugZPosition, 0.0f };
+    SimulationState PreviousState = CurrentState;
 
     glm::mat4 v = glm::lookAt(FPSCamera.GetPosition(), FPSCamera.GetTarget(), FPSCamera.GetUp());
     glm::mat4 p = glm::perspective(glm::radians(90.0f), (float)WindowWidth / WindowHeight, 0.1f, 100.0f);
+    const glm::quat NoRotation(1.0f, 0.0f, 0.0f, 0.0f);
+    const glm::vec3 YAxis(0.0f, 1.0f, 0.0f);
+    unsigned SceneUpdates = 0;
+
+    // Per-frame scene work split into jobs, each job fills its own draw list
+    enum ESceneJob {
+        JOB_LIGHTS = 0,
+        // The scene's visible moving draws are split evenly over the next jobs
+        JOB_SCENE_FIRST,
+        // Then the visible objects of the stress field, if there is one
+        JOB_STRESS_FIRST = JOB_SCENE_FIRST + 3,
+        JOB_COUNT = JOB_STRESS_FIRST + 8,
+    };
+    unsigned SceneDrawsPerJob = 0;
+    unsigned StressObjectsPerJob = 0;
+    JobSystem Jobs;
+    std::vector<RenderQueue::DrawList> SceneLists(JOB_COUNT);
+    float rotationAngle = 0;
+    // Simulation time of the rendered state, what every animation is evaluated at
+    double FrameTime = 0;
+    std::function<void(unsigned)> SceneJob = [&](unsigned jobIdx) {
+        RenderQueue::DrawList& List = SceneLists[jobIdx];
+        List.Clear();
+
+        if (jobIdx >= JOB_STRESS_FIRST) {
+            Stress.Submit(List, (jobIdx - JOB_STRESS_FIRST) * StressObjectsPerJob, StressObjectsPerJob);
+            return;
+        }
+        if (jobIdx >= JOB_SCENE_FIRST) {
+            unsigned First = (jobIdx - JOB_SCENE_FIRST) * SceneDrawsPerJob;
+            if (First < VisibleDrawCount) {
+                SceneObjects.Submit(List, Scene, &VisibleDraws[First], std::min(SceneDrawsPerJob, VisibleDrawCount - First));
+            }
+            return;
+        }
+
+        Animation.ApplyLights(Lights);
+
+        //spotlight follows the middle of the rug
+        int widthPolygons = 13;
+        int heightPolygons = 25;
+        glm::vec3 rugPos = glm::vec3(RugXPosition + (float)widthPolygons * 0.02,
+            0.7f + Animation.GetValue(RugBob) + Animation.GetValue(RugMiddleWaves[0]) + Animation.GetValue(RugMiddleWaves[1])
+            , RugZPosition + (float)heightPolygons * 0.02);
+        glm::vec3 moonPos = glm::vec3(-2.5, 2.5, -2.5);
+        glm::vec3 temp = glm::normalize(rugPos - moonPos);
+        Lights.SetDirection(Spotlight, temp);
+    };
+
     while (!glfwWindowShouldClose(Window)) {
-        v = glm::lookAt(FPSCamera.GetPosition(), FPSCamera.GetTarget(), FPSCamera.GetUp());
         HandleInput(&State, Window);
         glfwPollEvents();
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        FrameStartTime = glfwGetTime();
 
-        if (UserInput.MoveDown)
-        {
-            RugZPosition = RugZPosition - 0.05;
-        }
-        if (UserInput.MoveUp)
-        {
-            RugZPosition = RugZPosition + 0.05;
-        }
-        if (UserInput.MoveRight)
-        {
-            RugXPosition = RugXPosition + 0.05;
+        unsigned Steps = Simulation.Advance(glfwGetTime());
+        for (unsigned StepIdx = 0; StepIdx < Steps; ++StepIdx) {
+            PreviousState = CurrentState;
+            StepSimulation(UserInput, FPSCamera, CurrentState, (float)Simulation.GetStep());
         }
-        if (UserInput.MoveLeft)
-        {
-            RugXPosition = RugXPosition - 0.05;
-        }
-        FrameStartTime = glfwGetTime();
+        // The frame shows the state alpha of the way from the previous step to the latest
+        float Alpha = Simulation.GetAlpha();
+        FPSCamera.SetPosition(glm::mix(PreviousState.CameraPosition, CurrentState.CameraPosition, Alpha));
+        RugXPosition = glm::mix(PreviousState.RugXPosition, CurrentState.RugXPosition, Alpha);
+        RugZPosition = glm::mix(PreviousState.RugZPosition, CurrentState.RugZPosition, Alpha);
+        float AngleStep = CurrentState.SceneAngle - PreviousState.SceneAngle;
+        rotationAngle = PreviousState.SceneAngle + (AngleStep < -180.0f ? AngleStep + 360.0f : AngleStep) * Alpha;
+        FrameTime = Simulation.GetRenderTime();
+        v = glm::lookAt(FPSCamera.GetPosition(), FPSCamera.GetTarget(), FPSCamera.GetUp());
+        Watcher.Update();
+        GLState::ResetFrameCounters();
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
         //algorithm for screen resizing
         int currWidth;
@@ -373,560 +701,276 @@ int main() {
         w[0][0] = 1.0f;
         w[1][1] = currHeight/ currWidth;
         //w[1][1] = 1.0f;
-        float rotationAngle = (float)++angle / 6;
+        Culler.SetViewProjection(w * p * v);
 
-        glUseProgram(LightShader.GetId());
+        Ring.BeginFrame();
+        Queue.Begin(FPSCamera.GetPosition(), 20.0f);
 
+        GLState::UseProgram(LightShader.GetId());
         LightShader.SetViewport(w);
         LightShader.SetProjection(p);
         LightShader.SetView(v);
         LightShader.SetUniform3f("uViewPos", FPSCamera.GetPosition());
-        //moon
-        for (int i = 0; i < 4; i++)
-        {
-            m = glm::mat4(1.0f);
-            if (UserInput.ShouldRotate)
-                m = glm::rotate(m, glm::radians(rotationAngle), glm::vec3(0.0, 1.0, 0.0));
-            m = glm::translate(m, glm::vec3(-2.5, 2.5, -2.5));
-            m = glm::rotate(m, glm::radians((i * 15.0f) * 2), glm::vec3(1.0, 1.0, 1.0));
-            LightShader.SetColor(1.2, 1.2, 1.2);
-            LightShader.SetModel(m);
-            cube.Render(MoonTexture,WhiteTexture);
-            m = glm::mat4(1.0f);
-            if (UserInput.ShouldRotate)
-                m = glm::rotate(m, glm::radians(rotationAngle), glm::vec3(0.0, 1.0, 0.0));
-            m = glm::translate(m, glm::vec3(-2.5, 2.5, -2.5));
-            m = glm::rotate(m, glm::radians((i * 15.0f) * 2 + 15.0f), glm::vec3(1.0, 1.0, 1.0));
-            LightShader.SetColor(1.2, 1.2, 1.2);
-            LightShader.SetModel(m);
-            cube.Render(MoonTexture, WhiteTexture);
-        }
-
-
-        glUseProgram(BasicShader.GetId());
-
-        float pointLightPower = 1 - std::max(sin((glfwGetTime() * 15) / 4),0.0);
-        BasicShader.SetUniform3f("uPointLight1.Ka", glm::vec3(0.1 + pointLightPower * 0.1, 0.01f, 0.01f));
-        BasicShader.SetUniform3f("uPointLight1.Kd", glm::vec3(pointLightPower * 0.4, 0.1f, 0.1f));
-        BasicShader.SetUniform3f("uPointLight1.Ks", glm::vec3(pointLightPower, 0.1f, 0.1f));
-
-        pointLightPower = 1 - std::max(sin((60 + glfwGetTime() * 15) / 4), 0.0);
-        BasicShader.SetUniform3f("uPointLight2.Ka", glm::vec3(0.1 + pointLightPower * 0.1, 0.01f, 0.01f));
-        BasicShader.SetUniform3f("uPointLight2.Kd", glm::vec3(pointLightPower * 0.4, 0.1f, 0.1f));
-        BasicShader.SetUniform3f("uPointLight2.Ks", glm::vec3(pointLightPower, 0.1f, 0.1f));
-
-        pointLightPower = 1 - std::max(sin((120 + glfwGetTime() * 15) / 4), 0.0);
-        BasicShader.SetUniform3f("uPointLight3.Ka", glm::vec3(0.1 + pointLightPower * 0.1, 0.01f, 0.01f));
-        BasicShader.SetUniform3f("uPointLight3.Kd", glm::vec3(pointLightPower * 0.4, 0.1f, 0.1f));
-        BasicShader.SetUniform3f("uPointLight3.Ks", glm::vec3(pointLightPower, 0.1f, 0.1f));
-
-        pointLightPower = 1 - std::max(sin((180 + glfwGetTime() * 15) / 4), 0.0);
-        BasicShader.SetUniform3f("uPointLight4.Ka", glm::vec3(0.1 + pointLightPower * 0.1, 0.01f, 0.01f));
-        BasicShader.SetUniform3f("uPointLight4.Kd", glm::vec3(pointLightPower * 0.4, 0.1f, 0.1f));
-        BasicShader.SetUniform3f("uPointLight4.Ks", glm::vec3(pointLightPower, 0.1f, 0.1f));
-
-
-        //BasicShader.SetUniform3f("uPointLight1.Ka", glm::vec3(0.0f,0.0f, 0.0f));
-        //BasicShader.SetUniform3f("uPointLight1.Kd", glm::vec3(0.0f, 0.0f, 0.0f));
-        //BasicShader.SetUniform3f("uPointLight1.Ks", glm::vec3(0.0f, 0.0f, 0.0f));
-
-        //BasicShader.SetUniform3f("uPointLight2.Ka", glm::vec3(0.0f, 0.0f, 0.0f));
-        //BasicShader.SetUniform3f("uPointLight2.Kd", glm::vec3(0.0f, 0.0f, 0.0f));
-        //BasicShader.SetUniform3f("uPointLight2.Ks", glm::vec3(0.0f, 0.0f, 0.0f));
-
-        //BasicShader.SetUniform3f("uPointLight3.Ka", glm::vec3(0.0f, 0.0f, 0.0f));
-        //BasicShader.SetUniform3f("uPointLight3.Kd", glm::vec3(0.0f, 0.0f, 0.0f));
-        //BasicShader.SetUniform3f("uPointLight3.Ks", glm::vec3(0.0f, 0.0f, 0.0f));
-
-        //BasicShader.SetUniform3f("uPointLight4.Ka", glm::vec3(0.0f, 0.0f, 0.0f));
-        //BasicShader.SetUniform3f("uPointLight4.Kd", glm::vec3(0.0f, 0.0f, 0.0f));
-        //BasicShader.SetUniform3f("uPointLight4.Ks", glm::vec3(0.0f, 0.0f, 0.0f));
 
+        GLState::UseProgram(BasicShader.GetId());
         BasicShader.SetViewport(w);
         BasicShader.SetProjection(p);
         BasicShader.SetView(v);
         BasicShader.SetUniform3f("uViewPos", FPSCamera.GetPosition());
-        BasicShader.SetUniform3f("uPointLight1.Position", glm::vec3(1.34, 1.25 + sin((glfwGetTime() * 15) / 4) / 10, -1.34));
-        BasicShader.SetUniform3f("uPointLight2.Position", glm::vec3(-1.34, 1.25 + sin((glfwGetTime() * 15) / 4) / 10, -1.34));
-        BasicShader.SetUniform3f("uPointLight3.Position", glm::vec3(1.4, 1.05 + sin((glfwGetTime() * 15) / 4) / 10, 1.4));
-        BasicShader.SetUniform3f("uPointLight4.Position", glm::vec3(-1.4, 1.05 + sin((glfwGetTime() * 15) / 4) / 10, 1.4));
-        BasicShader.SetUniform3f("uSpotlight.Position", glm::vec3(-2.5, 2.5, -2.5));
 
-        BasicShader.SetUniform3f("uSpotlight.Ka", glm::vec3(0.8f, 0.1f, 0.8f));
-        BasicShader.SetUniform3f("uSpotlight.Kd", glm::vec3(0.8f, 0.1f, 0.8f));
-        BasicShader.SetUniform3f("uSpotlight.Ks", glm::vec3(0.8f, 0.1f, 0.8f));
+        GLState::UseProgram(MultiDrawShader.GetId());
+        MultiDrawShader.SetViewport(w);
+        MultiDrawShader.SetProjection(p);
+        MultiDrawShader.SetView(v);
+        MultiDrawShader.SetUniform3f("uViewPos", FPSCamera.GetPosition());
+
+        GLState::UseProgram(InstancedShader.GetId());
+        InstancedShader.SetViewport(w);
+        InstancedShader.SetProjection(p);
+        InstancedShader.SetView(v);
+        InstancedShader.SetUniform3f("uViewPos", FPSCamera.GetPosition());
+
+        Shader* DepthShaders[] = { &DepthShader, &DepthMultiDrawShader };
+        for (Shader* DepthProgram : DepthShaders) {
+            GLState::UseProgram(DepthProgram->GetId());
+            DepthProgram->SetViewport(w);
+            DepthProgram->SetProjection(p);
+            DepthProgram->SetView(v);
+        }
 
-        //Rug Model
-        for (int widthPolygons = 0; widthPolygons <= 25; widthPolygons++)
-        {
-            for (int heightPolygons = 0; heightPolygons <= 50; heightPolygons++)
-            {
-                m = glm::mat4(1.0f);
-                if ((10 < widthPolygons && widthPolygons < 15) && (5 <= heightPolygons && heightPolygons <= 45))
-                    BasicShader.SetColor(1, 0, 0);
-                else if ((5 < widthPolygons && widthPolygons < 20) && (5 <= heightPolygons && heightPolygons <= 45))
-                    BasicShader.SetColor(1, 1, 0);
-                else
-                    BasicShader.SetColor(0, 0, 0);
-                if (UserInput.ShouldRotate)
-                    m = glm::rotate(m, glm::radians(rotationAngle), glm::vec3(0.0, 1.0, 0.0));
-                if (widthPolygons == 13 && heightPolygons == 25) 
-                {
-                    glm::vec3 rugPos = glm::vec3(RugXPosition + (float)widthPolygons * 0.02,
-                        0.7 + sin(glfwGetTime() * 1.5) / 4 + sin(((float)widthPolygons + glfwGetTime() * 30) / 4) / 120 + sin(((float)heightPolygons + glfwGetTime() * 30) / 4) / 120
-                        , RugZPosition + (float)heightPolygons * 0.02);
-                    glm::vec3 moonPos = glm::vec3(-2.5, 2.5, -2.5);
-                    glm::vec3 temp = glm::normalize(rugPos-moonPos);
-                    BasicShader.SetUniform3f("uSpotlight.Direction", temp);
+        GLState::UseProgram(RugShader.GetId());
+        RugShader.SetViewport(w);
+        RugShader.SetProjection(p);
+        RugShader.SetView(v);
+        RugShader.SetUniform3f("uViewPos", FPSCamera.GetPosition());
+        // Every wave term repeats after 4 pi seconds, wrapping keeps the float time precise
+        RugShader.SetUniform1f("uTime", (float)fmod(FrameTime, RugWavePeriod));
+        RugShader.SetUniform3f("uRugOffset", glm::vec3(RugXPosition, 0.7f, RugZPosition));
+        RugShader.SetUniform1i("uGridRows", RugRows);
+        RugShader.SetUniform1f("uCellSize", RugCellSize);
+
+        Scene.SetRotation(SceneRoot, UserInput.ShouldRotate ? glm::angleAxis(glm::radians(rotationAngle), YAxis) : NoRotation);
+        Animation.Evaluate(FrameTime);
+        Animation.ApplyNodes(Scene);
+        SceneUpdates = Scene.Update();
+
+        glm::vec3 BoxMin;
+        glm::vec3 BoxMax;
+        for (unsigned DrawIdx = 0; DrawIdx < SceneObjects.GetDrawCount(); ++DrawIdx) {
+            SceneObjects.GetDrawBox(DrawIdx, Scene, BoxMin, BoxMax);
+            SceneBvh.Move(DrawIdx, BoxMin, BoxMax);
+        }
+        // Rug box from the wave in shaders/rug.vert: the whole rug bobs by a quarter, cells by 2 / 120 around that
+        Bounds RugBounds;
+        float RugHeight = 0.7f + Animation.GetValue(RugBob);
+        RugBounds.Min = glm::vec3(RugXPosition, RugHeight - 2.0f / 120, RugZPosition) - glm::vec3(RugCellPadding);
+        RugBounds.Max = glm::vec3(RugXPosition + (RugColumns - 1) * RugCellSize, RugHeight + 2.0f / 120, RugZPosition + (RugRows - 1) * RugCellSize) + glm::vec3(RugCellPadding);
+        RugBounds.WorldBox(Scene.GetWorld(SceneRoot), BoxMin, BoxMax);
+        SceneBvh.Move(RugObject, BoxMin, BoxMax);
+        SceneBvh.Update();
+
+        unsigned VisibleCount = SceneBvh.QueryFrustum(Culler, &VisibleObjects[0], VisibleObjects.size());
+        VisibleDrawCount = 0;
+        RugVisible = false;
+        for (unsigned VisibleIdx = 0; VisibleIdx < VisibleCount; ++VisibleIdx) {
+            if (VisibleObjects[VisibleIdx] == RugObjectData) {
+                RugVisible = true;
+            }
+            else {
+                VisibleDraws[VisibleDrawCount++] = VisibleObjects[VisibleIdx];
+            }
+        }
+        // Draws that survived the frustum are then tested against the occluders
+        if (UserInput.OcclusionCulling) {
+            Occlusion.Render(w * p * v, Scene.GetWorld(SceneRoot), Jobs);
+            unsigned Unoccluded = 0;
+            for (unsigned VisibleIdx = 0; VisibleIdx < VisibleDrawCount; ++VisibleIdx) {
+                SceneObjects.GetDrawBox(VisibleDraws[VisibleIdx], Scene, BoxMin, BoxMax);
+                if (Occlusion.IsBoxVisible(BoxMin, BoxMax)) {
+                    VisibleDraws[Unoccluded++] = VisibleDraws[VisibleIdx];
                 }
-                    m = glm::translate(m, glm::vec3(RugXPosition + (float)widthPolygons * 0.02,
-                        0.7 + sin(glfwGetTime() * 1.5) / 4 + sin(((float)widthPolygons + glfwGetTime() * 30) / 4) / 120 + sin(((float)heightPolygons + glfwGetTime() * 30) / 4) / 120
-                        , RugZPosition + (float)heightPolygons * 0.02));
-                m = glm::scale(m, glm::vec3(0.05, 0.01, 0.05));
-
-                //dont even ask me(rotation of individual elements for fabric)
-                float z = 0.01;
-
-                //for z finding angle
-                float y1 = sin(glfwGetTime() * 1.5) / 3 + sin(((float)widthPolygons + glfwGetTime() * 30) / 3) / 120 + sin(((float)heightPolygons + glfwGetTime() * 30) / 3) / 120;
-                float y2 = sin(glfwGetTime() * 1.5) / 3 + sin(((float)widthPolygons + glfwGetTime() * 30) / 3) / 120 + sin(((float)heightPolygons + 1 + glfwGetTime() * 30) / 3) / 120;
-                float y = y2 - y1;
-                float zHypotenuse = pow(pow(y, 2) + pow(0.01, 2), 0.5);
-                float angleForZ = asin((y) / (zHypotenuse)) / 2;
-                m = glm::rotate(m, glm::radians(angleForZ * 120), glm::vec3(0.0, 0.0, 1.0));
-
-                //for x finding angle
-                y1 = sin(glfwGetTime() * 1.5) / 6 + sin(((float)widthPolygons + glfwGetTime() * 30) / 4) / 120 + sin(((float)heightPolygons + glfwGetTime() * 30) / 4) / 120;
-                y2 = sin(glfwGetTime() * 1.5) / 6 + sin(((float)widthPolygons + glfwGetTime() * 30) / 4) / 120 + sin(((float)heightPolygons + 1 + glfwGetTime() * 30) / 4) / 120;
-                y = y2 - y1;
-                float xHypotenuse = pow(pow(y, 2) + pow(0.01, 2), 0.5);
-                float angleForX = asin((y) / (xHypotenuse)) / 2;
-                m = glm::rotate(m, glm::radians(-angleForX * 120), glm::vec3(1.0, 0.0, 0.0));
-
-                BasicShader.SetModel(m);
-                cube.Render(ClothTexture, WhiteTexture);
+            }
+            VisibleDrawCount = Unoccluded;
+            if (RugVisible) {
+                RugBounds.WorldBox(Scene.GetWorld(SceneRoot), BoxMin, BoxMax);
+                RugVisible = Occlusion.IsBoxVisible(BoxMin, BoxMax);
             }
         }
-        //BasicShader.SetUniform3f("uSpotlight.Ka", glm::vec3(0.0f, 0.0f, 0.0f));
-        //BasicShader.SetUniform3f("uSpotlight.Kd", glm::vec3(0.0f, 0.0f, 0.0f));
-        //BasicShader.SetUniform3f("uSpotlight.Ks", glm::vec3(0.0f, 0.0f, 0.0f));
-
-        //base
-        m = glm::mat4(1.0f);
-        if(UserInput.ShouldRotate)
-            m = glm::rotate(m, glm::radians(rotationAngle), glm::vec3(0.0, 1.0, 0.0));
-        m = glm::translate(m, glm::vec3(0, -0.5, 0));
-        m = glm::scale(m, glm::vec3(10, 0.3,10));
-        BasicShader.SetColor(0.5, 0.5, 0.2);
-        BasicShader.SetModel(m);
-        cube.Render(SandTexture, BlackDotsTexture);
-
-        //pyramid 1
-        m = glm::mat4(1.0f);
-        if (UserInput.ShouldRotate)
-            m = glm::rotate(m, glm::radians(rotationAngle), glm::vec3(0.0, 1.0, 0.0));
-        m = glm::translate(m, glm::vec3(1.34, 0.2, -1.34));
-        m = glm::scale(m, glm::vec3(3.3));
-        BasicShader.SetColor(0.5, 0.5, 0.2);
-        BasicShader.SetModel(m);
-        pyramid.Render(BrickTexture, WhiteTexture);
-
-        //pyramid cap 1
-        m = glm::mat4(1.0f);
-        if (UserInput.ShouldRotate)
-            m = glm::rotate(m, glm::radians(rotationAngle), glm::vec3(0.0, 1.0, 0.0));
-        m = glm::translate(m, glm::vec3(1.34, 0.8, -1.34));
-        m = glm::scale(m, glm::vec3(0.375));
-        BasicShader.SetColor(0.7, 0.7, 0.2);
-        BasicShader.SetModel(m);
-
-        pyramid.Render(BrickSmallTexture, WhiteTexture);
-
-        //star 1
-        m = glm::mat4(1.0f);
-        if (UserInput.ShouldRotate)
-            m = glm::rotate(m, glm::radians(rotationAngle), glm::vec3(0.0, 1.0, 0.0));
-        m = glm::translate(m, glm::vec3(1.34, 1.05 + sin((glfwGetTime() * 15) / 4) / 10, -1.34));
-        m = glm::rotate(m, glm::radians(rotationAngle*5), glm::vec3(0.0, 1.0, 0.0));
-        m = glm::scale(m, glm::vec3(0.012));
-        BasicShader.SetModel(m);
-        Star.Render();
-        m = glm::rotate(m, glm::radians(180.0f), glm::vec3(0.0, 1.0, 0.0));
-        BasicShader.SetModel(m);
-        Star.Render();
-
-        //pyramid 2
-        m = glm::mat4(1.0f);
-        if (UserInput.ShouldRotate)
-            m = glm::rotate(m, glm::radians(rotationAngle), glm::vec3(0.0, 1.0, 0.0));
-        m = glm::translate(m, glm::vec3(-1.34, 0.2, -1.34));
-        m = glm::scale(m, glm::vec3(3.3));
-        BasicShader.SetColor(0.5, 0.5, 0.2);
-        BasicShader.SetModel(m);
-        pyramid.Render(BrickTexture, WhiteTexture);
-
-        //pyramid cap 2
-        m = glm::mat4(1.0f);
-        if (UserInput.ShouldRotate)
-            m = glm::rotate(m, glm::radians(rotationAngle), glm::vec3(0.0, 1.0, 0.0));
-        m = glm::translate(m, glm::vec3(-1.34, 0.8, -1.34));
-        m = glm::scale(m, glm::vec3(0.375));
-        BasicShader.SetColor(0.7, 0.7, 0.2);
-        BasicShader.SetModel(m);
-        pyramid.Render(BrickSmallTexture, WhiteTexture);
-
-        //star 2
-        m = glm::mat4(1.0f);
-        if (UserInput.ShouldRotate)
-            m = glm::rotate(m, glm::radians(rotationAngle), glm::vec3(0.0, 1.0, 0.0));
-        m = glm::translate(m, glm::vec3(-1.34, 1.05 + sin((60 + glfwGetTime() * 15) / 4) / 10, -1.34));
-        m = glm::rotate(m, glm::radians(rotationAngle * 5), glm::vec3(0.0, 1.0, 0.0));
-        m = glm::scale(m, glm::vec3(0.012));
-        BasicShader.SetModel(m);
-        Star.Render();
-        m = glm::rotate(m, glm::radians(180.0f), glm::vec3(0.0, 1.0, 0.0));
-        BasicShader.SetModel(m);
-        Star.Render();
-
-        //pyramid 3
-        m = glm::mat4(1.0f);
-        if (UserInput.ShouldRotate)
-            m = glm::rotate(m, glm::radians(rotationAngle), glm::vec3(0.0, 1.0, 0.0));
-        m = glm::translate(m, glm::vec3(1.4, 0, 1.4));
-        m = glm::scale(m, glm::vec3(2.2));
-        BasicShader.SetColor(0.5, 0.5, 0.2);
-        BasicShader.SetModel(m);
-        pyramid.Render(BrickTexture, WhiteTexture);
-
-        //pyramid cap 3
-        m = glm::mat4(1.0f);
-        if (UserInput.ShouldRotate)
-            m = glm::rotate(m, glm::radians(rotationAngle), glm::vec3(0.0, 1.0, 0.0));
-        m = glm::translate(m, glm::vec3(1.4, 0.4, 1.4));
-        m = glm::scale(m, glm::vec3(0.25));
-        BasicShader.SetColor(0.7, 0.7, 0.2);
-        BasicShader.SetModel(m);
-        pyramid.Render(BrickSmallTexture, WhiteTexture);
-
-        //star 3
-        m = glm::mat4(1.0f);
-        if (UserInput.ShouldRotate)
-            m = glm::rotate(m, glm::radians(rotationAngle), glm::vec3(0.0, 1.0, 0.0));
-        m = glm::translate(m, glm::vec3(1.4, 0.6 + sin((120 + glfwGetTime() * 15) / 4) / 10, 1.4));
-        m = glm::rotate(m, glm::radians(rotationAngle * 5), glm::vec3(0.0, 1.0, 0.0));
-        m = glm::scale(m, glm::vec3(0.012));
-        BasicShader.SetModel(m);
-        Star.Render();
-        m = glm::rotate(m, glm::radians(180.0f), glm::vec3(0.0, 1.0, 0.0));
-        BasicShader.SetModel(m);
-        Star.Render();
-
-        //pyramid 4
-        m = glm::mat4(1.0f);
-        if (UserInput.ShouldRotate)
-            m = glm::rotate(m, glm::radians(rotationAngle), glm::vec3(0.0, 1.0, 0.0));
-        m = glm::translate(m, glm::vec3(-1.4, 0, 1.4));
-        m = glm::scale(m, glm::vec3(2.2));
-        BasicShader.SetColor(0.5, 0.5, 0.2);
-        BasicShader.SetModel(m);
-        pyramid.Render(BrickTexture, WhiteTexture);
-
-        //pyramid cap 4
-        m = glm::mat4(1.0f);
-        if (UserInput.ShouldRotate)
-            m = glm::rotate(m, glm::radians(rotationAngle), glm::vec3(0.0, 1.0, 0.0));
-        m = glm::translate(m, glm::vec3(-1.4, 0.4, 1.4));
-        m = glm::scale(m, glm::vec3(0.25));
-        BasicShader.SetColor(0.7, 0.7, 0.2);
-        BasicShader.SetModel(m);
-        pyramid.Render(BrickSmallTexture, WhiteTexture);
-
-        //star 4
-        m = glm::mat4(1.0f);
-        if (UserInput.ShouldRotate)
-            m = glm::rotate(m, glm::radians(rotationAngle), glm::vec3(0.0, 1.0, 0.0));
-        m = glm::translate(m, glm::vec3(-1.4, 0.6 + sin((180 + glfwGetTime() * 15) / 4) / 10, 1.4));
-        m = glm::rotate(m, glm::radians(rotationAngle * 5), glm::vec3(0.0, 1.0, 0.0));
-        m = glm::scale(m, glm::vec3(0.012));
-        BasicShader.SetModel(m);
-        Star.Render();
-        m = glm::rotate(m, glm::radians(180.0f), glm::vec3(0.0, 1.0, 0.0));
-        BasicShader.SetModel(m);
-        Star.Render();
-
-        //Bee Model 1
-        m = glm::mat4(1.0f);
-        if (UserInput.ShouldRotate)
-            m = glm::rotate(m, glm::radians(rotationAngle), glm::vec3(0.0, 1.0, 0.0));
-        m = glm::rotate(m, glm::radians(-5*rotationAngle/2), glm::vec3(0.0, 1.0, 0.0));
-        m = glm::translate(m, glm::vec3(1, 1, 0));
-        m = glm::scale(m, glm::vec3(0.03));
-        BasicShader.SetModel(m);
-        Bee.Render();
-
-        //Bee Model 2
-        m = glm::mat4(1.0f);
-        if (UserInput.ShouldRotate)
-            m = glm::rotate(m, glm::radians(rotationAngle), glm::vec3(0.0, 1.0, 0.0));
-        m = glm::rotate(m, glm::radians(-5 * rotationAngle/2), glm::vec3(0.0, 1.0, 0.0));
-        m = glm::translate(m, glm::vec3(-1, 1, 0));
-        m = glm::rotate(m, glm::radians(180.0f), glm::vec3(0.0, 1.0, 0.0));
-        m = glm::scale(m, glm::vec3(0.03));
-        BasicShader.SetModel(m);
-        BasicShader.SetColor(1.0f,1.0f,1.0f);
-        Bee.Render();
-
-        //Goku model
-        m = glm::mat4(1.0f);
-        if (UserInput.ShouldRotate)
-            m = glm::rotate(m, glm::radians(rotationAngle), glm::vec3(0.0, 1.0, 0.0));
-        m = glm::translate(m, glm::vec3(0, -0.4, -0.2));
-        m = glm::scale(m, glm::vec3(0.1));
-        BasicShader.SetModel(m);
-        Goku.Render();
-
-        //Dragon model
-        m = glm::mat4(1.0f);
-        if (UserInput.ShouldRotate)
-            m = glm::rotate(m, glm::radians(rotationAngle), glm::vec3(0.0, 1.0, 0.0));
-        m = glm::rotate(m, glm::radians(180.0f), glm::vec3(0.0, 1.0, 0.0));
-        m = glm::translate(m, glm::vec3(0, 0, -2));
-        m = glm::scale(m, glm::vec3(0.3));
-        BasicShader.SetModel(m);
-        Dragon.Render();
-
-        //Detailed tree 1
-        //trunk part1 (cube)
-        for (int i = 0; i < 3; i++)
-        {
-            m = glm::mat4(1.0f);
-            if (UserInput.ShouldRotate)
-                m = glm::rotate(m, glm::radians(rotationAngle), glm::vec3(0.0, 1.0, 0.0));
-            m = glm::translate(m, glm::vec3(1.5, 0, 0));
-            m = glm::scale(m, glm::vec3(0.5, 2, 0.5));
-            m = glm::rotate(m, glm::radians(i*30.0f), glm::vec3(0.0, 1.0, 0.0));
-            BasicShader.SetColor(0.3, 0.2, 0.1);
-            BasicShader.SetModel(m);
-            cube.Render(TreeTexture, WhiteTexture);
+        // Animated nodes nothing visible hangs off are only written every 4th frame, bounds lag a few frames at most
+        SceneObjects.SetAnimationRates(VisibleDrawCount ? &VisibleDraws[0] : 0, VisibleDrawCount, 4);
+        SceneDrawsPerJob = (VisibleDrawCount + JOB_STRESS_FIRST - JOB_SCENE_FIRST - 1) / (JOB_STRESS_FIRST - JOB_SCENE_FIRST);
+
+        if (UserInput.NextStressCount || UserInput.NextStressLayout || UserInput.NextAnimatedFraction) {
+            StressLevel = UserInput.NextStressCount ? (StressLevel + 1) % (sizeof(StressCounts) / sizeof(StressCounts[0])) : StressLevel;
+            AnimatedLevel = UserInput.NextAnimatedFraction ? (AnimatedLevel + 1) % (sizeof(AnimatedFractions) / sizeof(AnimatedFractions[0])) : AnimatedLevel;
+            if (UserInput.NextStressLayout) {
+                StressSettings.Layout = StressSettings.Layout == StressScene::LAYOUT_GRID ? StressScene::LAYOUT_POISSON : StressScene::LAYOUT_GRID;
+            }
+            StressSettings.Count = StressCounts[StressLevel];
+            StressSettings.AnimatedFraction = AnimatedFractions[AnimatedLevel];
+            Stress.Generate(StressSettings);
+            if (Stress.GetObjectCount()) {
+                std::cout << "Stress field: " << Stress.GetObjectCount() << " objects " << (StressSettings.Layout == StressScene::LAYOUT_GRID ? "on a grid" : "Poisson disk")
+                    << ", " << StressSettings.AnimatedFraction * 100 << "% animated, generated in " << Stress.GetStats().GenerateTime * 1e3 << " ms" << std::endl;
+            }
+            UserInput.NextStressCount = UserInput.NextStressLayout = UserInput.NextAnimatedFraction = false;
         }
+        Stress.Update(FrameTime, Culler);
 
-        //trunk part2 (pyramid)
-        for (int i = 0; i < 3; i++)
-        {
-            m = glm::mat4(1.0f);
-            if (UserInput.ShouldRotate)
-                m = glm::rotate(m, glm::radians(rotationAngle), glm::vec3(0.0, 1.0, 0.0));
-            m = glm::translate(m, glm::vec3(1.5, -0.3, 0));
-            m = glm::rotate(m, glm::radians(i * 30.0f), glm::vec3(0.0, 1.0, 0.0));
-            m = glm::scale(m, glm::vec3(0.8, 0.4, 0.8));
-            BasicShader.SetColor(0.3, 0.2, 0.1);
-            BasicShader.SetModel(m);
-            pyramid.Render(TreeTexture, WhiteTexture);
+        if (UserInput.ToggleForest && TreePrefab != PrefabSet::INVALID_PREFAB) {
+            if (Prefabs.GetInstanceCount(TreePrefab) > SceneTrees) {
+                Prefabs.SetInstanceCount(TreePrefab, SceneTrees);
+            }
+            else {
+                float Offset = (ForestSide - 1) * ForestSpacing * 0.5f;
+                for (unsigned TreeIdx = 0; TreeIdx < ForestSide * ForestSide; ++TreeIdx) {
+                    glm::vec3 Position(TreeIdx % ForestSide * ForestSpacing - Offset, 0.0f, TreeIdx / ForestSide * ForestSpacing - Offset);
+                    if (std::fabs(Position.x) < 6.0f && std::fabs(Position.z) < 6.0f) {
+                        continue;
+                    }
+                    glm::mat4 Tree = glm::rotate(glm::translate(glm::mat4(1.0f), Position), glm::radians((float)(TreeIdx * 37 % 360)), YAxis);
+                    Prefabs.AddInstance(TreePrefab, Tree);
+                }
+            }
+            std::cout << "Forest: " << Prefabs.GetInstanceCount(TreePrefab) << " trees" << std::endl;
+        }
+        UserInput.ToggleForest = false;
+        Prefabs.Update(Scene.GetWorld(SceneRoot), Culler);
+        StressObjectsPerJob = (Stress.GetVisibleCount() + JOB_COUNT - JOB_STRESS_FIRST - 1) / (JOB_COUNT - JOB_STRESS_FIRST);
+
+        if (UserInput.Pick) {
+            unsigned Picked;
+            float PickDistance;
+            glm::vec3 Direction = glm::normalize(FPSCamera.GetTarget() - FPSCamera.GetPosition());
+            if (SceneBvh.RayCast(FPSCamera.GetPosition(), Direction, 100.0f, Picked, PickDistance)) {
+                std::cout << "Picked " << (Picked == RugObjectData ? std::string("rug") : SceneObjects.GetDrawName(Picked)) << " at " << PickDistance << std::endl;
+            }
+            else {
+                std::cout << "Picked nothing" << std::endl;
+            }
+            UserInput.Pick = false;
         }
 
-        //switching culling bcs negative y scaling
-        glCullFace(GL_FRONT);
-        //leafs part1 (pyramid)
-        for (int i = 0; i < 3; i++)
-        {
-            m = glm::mat4(1.0f);
-            if (UserInput.ShouldRotate)
-                m = glm::rotate(m, glm::radians(rotationAngle), glm::vec3(0.0, 1.0, 0.0));
-            m = glm::translate(m, glm::vec3(1.5, 0.3, 0));
-            m = glm::scale(m, glm::vec3(1.55, -0.6, 1.55));
-            m = glm::rotate(m, glm::radians(i * 30.0f), glm::vec3(0.0, 1.0, 0.0));
-            BasicShader.SetColor(0.1, 0.3, 0.1);
-            BasicShader.SetModel(m);
-            pyramid.Render(LeafTexture, WhiteTexture);
+        // Lights and the scene's moving draws are built on the job system, then merged in job order
+        std::chrono::high_resolution_clock::time_point SubmitStart = std::chrono::high_resolution_clock::now();
+        Jobs.Run(SceneJob, JOB_COUNT);
+        StressSubmitTime = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - SubmitStart).count();
+        Lights.Upload(Ring);
+
+        //Rug Model
+        if (RugVisible) {
+            cube.Submit(Queue, RugShader, Scene.GetWorld(SceneRoot), glm::vec3(1.0f), ClothTexture, WhiteTexture, RugColumns * RugRows);
         }
-        glCullFace(GL_BACK);
-        
-        //leafs part2 (cube)
-        for (int i = 0; i < 3; i++)
-        {
-            m = glm::mat4(1.0f);
-            if (UserInput.ShouldRotate)
-                m = glm::rotate(m, glm::radians(rotationAngle), glm::vec3(0.0, 1.0, 0.0));
-            m = glm::translate(m, glm::vec3(1.5, 0.52, 0));
-            m = glm::scale(m, glm::vec3(1.5, 0.6, 1.5));
-            m = glm::rotate(m, glm::radians(i * 30.0f), glm::vec3(0.0, 1.0, 0.0));
-            BasicShader.SetColor(0.1, 0.3, 0.1);
-            BasicShader.SetModel(m);
-            cube.Render(LeafTexture, WhiteTexture);
+
+        //ground and pyramids
+        StaticQueue.SetDepthPrepass(UserInput.DepthPrepass);
+        Queue.SetDepthPrepass(UserInput.DepthPrepass);
+        const glm::mat4& Root = Scene.GetWorld(SceneRoot);
+        // The pre-pass changes the depth state the static pass is recorded with, so it is one of its inputs
+        uint64_t StaticInputs = CommandList::HashInputs(&Root, sizeof(Root), CommandList::HashInputs(&UserInput.DepthPrepass, sizeof(bool)));
+        bool ReplayStatic = UserInput.RecordStatic && StaticPass.IsValid(StaticInputs) && StaticDepthPass.IsValid(StaticInputs);
+        if (!ReplayStatic) {
+            StaticQueue.Begin(FPSCamera.GetPosition(), 20.0f);
+            StaticScene.Submit(StaticQueue, BasicShader, Root);
+            if (UserInput.RecordStatic) {
+                StaticQueue.Record(StaticPass, StaticInputs);
+                StaticQueue.RecordDepthPrepass(StaticDepthPass, StaticInputs);
+            }
         }
-        //leafs part3 (pyramid)
-        for (int i = 0; i < 3; i++)
-        {
-            m = glm::mat4(1.0f);
-            if (UserInput.ShouldRotate)
-                m = glm::rotate(m, glm::radians(rotationAngle), glm::vec3(0.0, 1.0, 0.0));
-            m = glm::translate(m, glm::vec3(1.5, 0.77, 0));
-            m = glm::scale(m, glm::vec3(1.55, 0.6, 1.55));
-            m = glm::rotate(m, glm::radians(i * 30.0f), glm::vec3(0.0, 1.0, 0.0));
-            BasicShader.SetColor(0.1, 0.3, 0.1);
-            BasicShader.SetModel(m);
-            pyramid.Render(LeafTexture, WhiteTexture);
+        std::chrono::high_resolution_clock::time_point MergeStart = std::chrono::high_resolution_clock::now();
+        for (unsigned JobIdx = 0; JobIdx < JOB_COUNT; ++JobIdx) {
+            Queue.Submit(SceneLists[JobIdx]);
         }
+        StressMergeTime = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - MergeStart).count();
 
-        //Detailed tree 2
-        //trunk part1 (cube)
-        for (int i = 0; i < 3; i++)
-        {
-            m = glm::mat4(1.0f);
-            if (UserInput.ShouldRotate)
-                m = glm::rotate(m, glm::radians(rotationAngle), glm::vec3(0.0, 1.0, 0.0));
-            m = glm::translate(m, glm::vec3(-1.5, 0, 0));
-            m = glm::scale(m, glm::vec3(0.5, 2, 0.5));
-            m = glm::rotate(m, glm::radians(i * 30.0f), glm::vec3(0.0, 1.0, 0.0));
-            BasicShader.SetColor(0.3, 0.2, 0.1);
-            BasicShader.SetModel(m);
-            cube.Render(TreeTexture, WhiteTexture);
+        if (UserInput.DepthPrepass) {
+            PrepassTimer.Begin();
+            GLState::SetColorMask(false);
+            if (UserInput.RecordStatic) {
+                StaticDepthPass.Replay();
+            }
+            else {
+                StaticQueue.ExecuteDepthPrepass();
+            }
+            Queue.ExecuteDepthPrepass();
+            GLState::SetColorMask(true);
+            PrepassTimer.End();
         }
 
-        //trunk part2 (pyramid)
-        for (int i = 0; i < 3; i++)
-        {
-            m = glm::mat4(1.0f);
-            if (UserInput.ShouldRotate)
-                m = glm::rotate(m, glm::radians(rotationAngle), glm::vec3(0.0, 1.0, 0.0));
-            m = glm::translate(m, glm::vec3(-1.5, -0.3, 0));
-            m = glm::rotate(m, glm::radians(i * 30.0f), glm::vec3(0.0, 1.0, 0.0));
-            m = glm::scale(m, glm::vec3(0.8, 0.4, 0.8));
-            BasicShader.SetColor(0.3, 0.2, 0.1);
-            BasicShader.SetModel(m);
-            pyramid.Render(TreeTexture, WhiteTexture);
+        MainPassTimer.Begin();
+        std::chrono::high_resolution_clock::time_point StaticStart = std::chrono::high_resolution_clock::now();
+        if (UserInput.RecordStatic) {
+            StaticPass.Replay();
         }
-
-        //switching culling bcs negative y scaling
-        glCullFace(GL_FRONT);
-        //leafs part1 (pyramid)
-        for (int i = 0; i < 3; i++)
-        {
-            m = glm::mat4(1.0f);
-            if (UserInput.ShouldRotate)
-                m = glm::rotate(m, glm::radians(rotationAngle), glm::vec3(0.0, 1.0, 0.0));
-            m = glm::translate(m, glm::vec3(-1.5, 0.3, 0));
-            m = glm::scale(m, glm::vec3(1.55, -0.6, 1.55));
-            m = glm::rotate(m, glm::radians(i * 30.0f), glm::vec3(0.0, 1.0, 0.0));
-            BasicShader.SetColor(0.1, 0.3, 0.1);
-            BasicShader.SetModel(m);
-            pyramid.Render(LeafTexture, WhiteTexture);
+        else {
+            StaticQueue.Execute();
         }
-        glCullFace(GL_BACK);
-        //leafs part2 (cube)
-        for (int i = 0; i < 3; i++)
-        {
-            m = glm::mat4(1.0f);
-            if (UserInput.ShouldRotate)
-                m = glm::rotate(m, glm::radians(rotationAngle), glm::vec3(0.0, 1.0, 0.0));
-            m = glm::translate(m, glm::vec3(-1.5, 0.52, 0));
-            m = glm::scale(m, glm::vec3(1.5, 0.6, 1.5));
-            m = glm::rotate(m, glm::radians(i * 30.0f), glm::vec3(0.0, 1.0, 0.0));
-            BasicShader.SetColor(0.1, 0.3, 0.1);
-            BasicShader.SetModel(m);
-            cube.Render(LeafTexture, WhiteTexture);
+        // Frames that had to record are left out, the time compares steady state replay against immediate submission
+        std::chrono::duration<double> StaticTime = std::chrono::high_resolution_clock::now() - StaticStart;
+        if (ReplayStatic || !UserInput.RecordStatic) {
+            StaticPassTime = StaticTime.count();
         }
-        //leafs part3 (pyramid)
-        for (int i = 0; i < 3; i++)
-        {
-            m = glm::mat4(1.0f);
-            if (UserInput.ShouldRotate)
-                m = glm::rotate(m, glm::radians(rotationAngle), glm::vec3(0.0, 1.0, 0.0));
-            m = glm::translate(m, glm::vec3(-1.5, 0.77, 0));
-            m = glm::scale(m, glm::vec3(1.55, 0.6, 1.55));
-            m = glm::rotate(m, glm::radians(i * 30.0f), glm::vec3(0.0, 1.0, 0.0));
-            BasicShader.SetColor(0.1, 0.3, 0.1);
-            BasicShader.SetModel(m);
-            pyramid.Render(LeafTexture, WhiteTexture);
+        std::chrono::high_resolution_clock::time_point ExecuteStart = std::chrono::high_resolution_clock::now();
+        Queue.Execute();
+        StressExecuteTime = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - ExecuteStart).count();
+        Prefabs.Render(InstancedShader);
+        MainPassTimer.End();
+
+        if (UserInput.RunTransformBenchmark) {
+            RunTransformBenchmark();
+            UserInput.RunTransformBenchmark = false;
         }
-       
-        //Detailed tree 3
-        //trunk part1 (cube)
-        for (int i = 0; i < 3; i++)
-        {
-            m = glm::mat4(1.0f);
-            if (UserInput.ShouldRotate)
-                m = glm::rotate(m, glm::radians(rotationAngle), glm::vec3(0.0, 1.0, 0.0));
-            m = glm::translate(m, glm::vec3(0, 0, -1.5));
-            m = glm::scale(m, glm::vec3(0.5, 2, 0.5));
-            m = glm::rotate(m, glm::radians(i * 30.0f), glm::vec3(0.0, 1.0, 0.0));
-            BasicShader.SetColor(0.3, 0.2, 0.1);
-            BasicShader.SetModel(m);
-            cube.Render(TreeTexture, WhiteTexture);
+        if (UserInput.RunJobBenchmark) {
+            if (Star && Bee) {
+                RunJobBenchmark(Jobs, StaticQueue, *Star, *Bee, BasicShader);
+            }
+            StaticPass.Invalidate();
+            UserInput.RunJobBenchmark = false;
         }
+        Ring.EndFrame();
 
-        //trunk part2 (pyramid)
-        for (int i = 0; i < 3; i++)
-        {
-            m = glm::mat4(1.0f);
-            if (UserInput.ShouldRotate)
-                m = glm::rotate(m, glm::radians(rotationAngle), glm::vec3(0.0, 1.0, 0.0));
-            m = glm::translate(m, glm::vec3(0, -0.3, -1.5));
-            m = glm::rotate(m, glm::radians(i * 30.0f), glm::vec3(0.0, 1.0, 0.0));
-            m = glm::scale(m, glm::vec3(0.8, 0.4, 0.8));
-            BasicShader.SetColor(0.3, 0.2, 0.1);
-            BasicShader.SetModel(m);
-            pyramid.Render(TreeTexture, WhiteTexture);
-        }
+        glfwSwapBuffers(Window);
 
-        //switching culling bcs negative y scaling
-        glCullFace(GL_FRONT);
-        //leafs part1 (pyramid)
-        for (int i = 0; i < 3; i++)
-        {
-            m = glm::mat4(1.0f);
-            if (UserInput.ShouldRotate)
-                m = glm::rotate(m, glm::radians(rotationAngle), glm::vec3(0.0, 1.0, 0.0));
-            m = glm::translate(m, glm::vec3(0, 0.3, -1.5));
-            m = glm::scale(m, glm::vec3(1.55, -0.6, 1.55));
-            m = glm::rotate(m, glm::radians(i * 30.0f), glm::vec3(0.0, 1.0, 0.0));
-            BasicShader.SetColor(0.1, 0.3, 0.1);
-            BasicShader.SetModel(m);
-            pyramid.Render(LeafTexture, WhiteTexture);
-        }
-        glCullFace(GL_BACK);
-
-        //leafs part2 (cube)
-        for (int i = 0; i < 3; i++)
-        {
-            m = glm::mat4(1.0f);
-            if (UserInput.ShouldRotate)
-                m = glm::rotate(m, glm::radians(rotationAngle), glm::vec3(0.0, 1.0, 0.0));
-            m = glm::translate(m, glm::vec3(0, 0.52, -1.5));
-            m = glm::scale(m, glm::vec3(1.5, 0.6, 1.5));
-            m = glm::rotate(m, glm::radians(i * 30.0f), glm::vec3(0.0, 1.0, 0.0));
-            BasicShader.SetColor(0.1, 0.3, 0.1);
-            BasicShader.SetModel(m);
-            cube.Render(LeafTexture, WhiteTexture);
+        if (UserInput.ShowStats && glfwGetTime() - LastStatsTime >= 1.0f) {
+            PrintFrameStats(Queue, Ring, StaticQueue, StaticPass, UserInput.RecordStatic, StaticPassTime);
+            PrintPassTimes(PrepassTimer, MainPassTimer, UserInput.DepthPrepass);
+            FixedTimestep::Stats SimulationStats = Simulation.GetStats();
+            std::cout << "Simulation: " << SimulationStats.FrameSteps << " steps of " << Simulation.GetStep() * 1e3 << " ms this frame, "
+                << SimulationStats.TotalSteps << " in total, " << SimulationStats.DroppedTime << " s dropped" << std::endl;
+            std::cout << "Scene graph: " << SceneUpdates << "/" << Scene.GetNodeCount() << " world matrices updated" << std::endl;
+            PrintBvhStats(SceneBvh, Lights, PointLights, 4, VisibleCount);
+            if (UserInput.OcclusionCulling) {
+                OcclusionCuller::Stats OcclusionStats = Occlusion.GetStats();
+                std::cout << "Occlusion culling: " << OcclusionStats.Occluded << "/" << OcclusionStats.Tested << " objects hidden, "
+                    << OcclusionStats.RasterizedTriangles << "/" << OcclusionStats.OccluderTriangles << " occluder triangles in "
+                    << OcclusionStats.RenderTime * 1e6 << " us" << std::endl;
+            }
+            PrefabSet::Stats PrefabStats = Prefabs.GetStats();
+            std::cout << "Prefabs: " << PrefabStats.Visible << "/" << PrefabStats.Instances << " instances visible in " << PrefabStats.DrawCalls
+                << " instanced draws, " << PrefabStats.UploadedBytes << " bytes uploaded, updated in " << PrefabStats.UpdateTime * 1e6 << " us" << std::endl;
+            AnimationSystem::Stats AnimationStats = Animation.GetStats();
+            std::cout << "Animation: " << AnimationStats.Channels << " channels evaluated in " << AnimationStats.EvaluateTime * 1e6 << " us, "
+                << AnimationStats.Applied << " bindings applied, " << AnimationStats.Skipped << " skipped" << std::endl;
+            LastStatsTime = glfwGetTime();
         }
-
-        //leafs part3 (pyramid)
-        for (int i = 0; i < 3; i++)
-        {
-            m = glm::mat4(1.0f);
-            if (UserInput.ShouldRotate)
-                m = glm::rotate(m, glm::radians(rotationAngle), glm::vec3(0.0, 1.0, 0.0));
-            m = glm::translate(m, glm::vec3(0, 0.77, -1.5));
-            m = glm::scale(m, glm::vec3(1.55, 0.6, 1.55));
-            m = glm::rotate(m, glm::radians(i * 30.0f), glm::vec3(0.0, 1.0, 0.0));
-            BasicShader.SetColor(0.1, 0.3, 0.1);
-            BasicShader.SetModel(m);
-            pyramid.Render(LeafTexture, WhiteTexture);
+        // The stress field reports on its own, scaling numbers are what it is for
+        if (Stress.GetObjectCount() && glfwGetTime() - LastStressStatsTime >= 1.0f) {
+            PrintStressStats(Stress, Queue, FrameWorkTime, StressSubmitTime, StressMergeTime, StressExecuteTime, MainPassTimer.GetMilliseconds());
+            LastStressStatsTime = glfwGetTime();
         }
 
-        glUseProgram(0);
-        glfwSwapBuffers(Window);
-
         FrameEndTime = glfwGetTime();
         dt = FrameEndTime - FrameStartTime;
-        if (dt < TargetFPS) {
+        FrameWorkTime = dt;
+        // Only caps the render rate, the simulation keeps its own
+        if (dt < TargetFrameTime) {
             int DeltaMS = (int)((TargetFrameTime - dt) * 1e3f);
             std::this_thread::sleep_for(std::chrono::milliseconds(DeltaMS));
-            FrameEndTime = glfwGetTime();
         }
-        State.mDT = FrameEndTime - FrameStartTime;
     }
 
+    SceneObjects.Destroy();
+    GeometryArena::Shutdown();
     glfwTerminate();
     return 0;
 }
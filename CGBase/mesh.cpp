@@ -6,27 +6,65 @@ Mesh::Mesh(const aiMesh* mesh, const aiMaterial* material, const std::string& re
 
 void
 Mesh::Render() const {
-    glBindVertexArray(mVAO);
+    GLState::BindVertexArray(mVAO);
 
     if (mDiffuseTexture) {
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, mDiffuseTexture);
+        GLState::BindTexture(0, mDiffuseTexture);
     }
 
     if (mSpecularTexture) {
-        glActiveTexture(GL_TEXTURE1);
-        glBindTexture(GL_TEXTURE_2D, mSpecularTexture);
+        GLState::BindTexture(1, mSpecularTexture);
     }
 
+    // The arena's EBO is part of the VAO state
     if (mIndexCount) {
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mEBO);
-        glDrawElements(GL_TRIANGLES, mIndexCount, GL_UNSIGNED_INT, (void*)0);
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+        glDrawElementsBaseVertex(GL_TRIANGLES, mIndexCount, GL_UNSIGNED_INT, (void*)(mRange.FirstIndex * sizeof(unsigned)), mRange.BaseVertex);
         return;
     }
 
-    glDrawArrays(GL_TRIANGLES, 0, mVertexCount);
-    glBindVertexArray(0);
+    glDrawArrays(GL_TRIANGLES, mRange.BaseVertex, mVertexCount);
+}
+
+void
+Mesh::Submit(RenderQueue& queue, RenderQueue::DrawCall draw) const {
+    fillDrawCall(draw);
+    queue.Submit(draw);
+}
+
+void
+Mesh::Submit(RenderQueue::DrawList& list, RenderQueue::DrawCall draw) const {
+    fillDrawCall(draw);
+    list.Submit(draw);
+}
+
+void
+Mesh::fillDrawCall(RenderQueue::DrawCall& draw) const {
+    draw.VAO = mVAO;
+    draw.Indexed = mIndexCount > 0;
+    draw.Count = draw.Indexed ? mIndexCount : mVertexCount;
+    draw.FirstIndex = mRange.FirstIndex;
+    draw.BaseVertex = mRange.BaseVertex;
+    draw.DiffuseTexture = mDiffuseTexture;
+    draw.SpecularTexture = mSpecularTexture;
+    draw.Sphere = mBounds.WorldSphere(draw.Model);
+}
+
+void
+Mesh::Release() {
+    GeometryArena::Free(mRange);
+    mRange.VertexCount = mRange.IndexCount = 0;
+    if (mDiffuseTexture) {
+        GLState::DeleteTexture(mDiffuseTexture);
+    }
+    if (mSpecularTexture) {
+        GLState::DeleteTexture(mSpecularTexture);
+    }
+    mDiffuseTexture = mSpecularTexture = 0;
+}
+
+const Bounds&
+Mesh::GetBounds() const {
+    return mBounds;
 }
 
 unsigned
@@ -64,30 +102,13 @@ Mesh::processMesh(const aiMesh* mesh, const aiMaterial* material, const std::str
         mIndices.push_back(Face.mIndices[2]);
     }
 
-    mVertexCount = mVertices.size() / 6;
+    mVertexCount = mVertices.size() / 8;
     mIndexCount = mIndices.size();
+    mBounds = Bounds::FromVertices(mVertices.data(), mVertexCount, 8);
 
     mDiffuseTexture = loadMeshTexture(material, resPath, aiTextureType_DIFFUSE);
     mSpecularTexture = loadMeshTexture(material, resPath, aiTextureType_SPECULAR);
 
-    glGenVertexArrays(1, &mVAO);
-    glBindVertexArray(mVAO);
-    glGenBuffers(1, &mVBO);
-    glBindBuffer(GL_ARRAY_BUFFER, mVBO);
-    glBufferData(GL_ARRAY_BUFFER, mVertices.size() * sizeof(float), mVertices.data(), GL_STATIC_DRAW);
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)0);
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(3 * sizeof(float)));
-    glEnableVertexAttribArray(1);
-    glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(6 * sizeof(float)));
-    glEnableVertexAttribArray(2);
-    glBindBuffer(GL_ARRAY_BUFFER, 0);
-
-    if (mIndexCount) {
-        glGenBuffers(1, &mEBO);
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mEBO);
-        glBufferData(GL_ELEMENT_ARRAY_BUFFER, mIndexCount * sizeof(float), mIndices.data(), GL_STATIC_DRAW);
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
-    }
-    glBindVertexArray(0);
+    mRange = GeometryArena::Allocate(GeometryArena::FORMAT_POS_NORMAL_UV, mVertices.data(), mVertexCount, mIndices.data(), mIndexCount);
+    mVAO = GeometryArena::GetVAO(GeometryArena::FORMAT_POS_NORMAL_UV);
 }
\ No newline at end of file
@@ -16,6 +16,10 @@
 #include <GL/glew.h>
 #include <iostream>
 #include "texture.hpp"
+#include "glstate.hpp"
+#include "renderqueue.hpp"
+#include "geometryarena.hpp"
+#include "bounds.hpp"
 
 class Mesh {
 public:
@@ -25,15 +29,28 @@ public:
     Mesh(const aiMesh* mesh, const aiMaterial* material, const std::string& resPath);
 
     void Render() const;
+    /**
+     * @brief Queues the mesh with its own geometry and textures, the rest of the draw
+     * (program, transform, color) comes from draw
+     */
+    void Submit(RenderQueue& queue, RenderQueue::DrawCall draw) const;
+    void Submit(RenderQueue::DrawList& list, RenderQueue::DrawCall draw) const;
+    /**
+     * @brief Returns the mesh's geometry to the arena and deletes its textures. Copies of the
+     * mesh share both, so only one of them may release it.
+     */
+    void Release();
+    const Bounds& GetBounds() const;
 
 private:
     unsigned mVAO;
-    unsigned mVBO;
-    unsigned mEBO;
+    GeometryArena::Range mRange;
     unsigned mVertexCount;
     unsigned mIndexCount;
     unsigned mDiffuseTexture;
     unsigned mSpecularTexture;
+    Bounds mBounds;
+    void fillDrawCall(RenderQueue::DrawCall& draw) const;
     unsigned loadMeshTexture(const aiMaterial* material, const std::string& resPath, aiTextureType type);
     void processMesh(const aiMesh* mesh, const aiMaterial* material, const std::string& resPath);
 };
\ No newline at end of file
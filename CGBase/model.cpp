@@ -25,10 +25,57 @@ Model::Load() {
     return true;
 }
 
+void
+Model::Unload() {
+    for (unsigned MeshIdx = 0; MeshIdx < mMeshes.size(); ++MeshIdx) {
+        mMeshes[MeshIdx].Release();
+    }
+    mMeshes.clear();
+}
+
 void
 Model::Render() {
     for (unsigned MeshIdx = 0; MeshIdx < mMeshes.size(); ++MeshIdx) {
         Mesh& Mesh = mMeshes[MeshIdx];
         mMeshes[MeshIdx].Render();
     }
-}
\ No newline at end of file
+}
+
+void
+Model::Submit(RenderQueue& queue, Shader& shader, const glm::mat4& model, const glm::vec3& color) const {
+    RenderQueue::DrawCall Draw = drawCall(shader, model, color);
+    for (unsigned MeshIdx = 0; MeshIdx < mMeshes.size(); ++MeshIdx) {
+        mMeshes[MeshIdx].Submit(queue, Draw);
+    }
+}
+
+void
+Model::Submit(RenderQueue::DrawList& list, Shader& shader, const glm::mat4& model, const glm::vec3& color) const {
+    RenderQueue::DrawCall Draw = drawCall(shader, model, color);
+    for (unsigned MeshIdx = 0; MeshIdx < mMeshes.size(); ++MeshIdx) {
+        mMeshes[MeshIdx].Submit(list, Draw);
+    }
+}
+
+Bounds
+Model::GetBounds() const {
+    if (mMeshes.empty()) {
+        return Bounds::FromVertices(0, 0, 0);
+    }
+    Bounds Result = mMeshes[0].GetBounds();
+    for (unsigned MeshIdx = 1; MeshIdx < mMeshes.size(); ++MeshIdx) {
+        Result = Bounds::Merge(Result, mMeshes[MeshIdx].GetBounds());
+    }
+    return Result;
+}
+
+RenderQueue::DrawCall
+Model::drawCall(Shader& shader, const glm::mat4& model, const glm::vec3& color) const {
+    RenderQueue::DrawCall Draw = RenderQueue::DrawCall();
+    Draw.Pass = RenderQueue::PASS_OPAQUE;
+    Draw.Program = &shader;
+    Draw.Instances = 1;
+    Draw.Model = model;
+    Draw.Color = color;
+    return Draw;
+}
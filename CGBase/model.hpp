@@ -1,5 +1,5 @@
 
-#ifndef MESH_H
+#pragma once
 
 #include <assimp/Importer.hpp>
 #include <assimp/scene.h>
@@ -30,6 +30,8 @@ class Model {
 private:
     std::vector<Mesh> mMeshes;
 
+    RenderQueue::DrawCall drawCall(Shader& shader, const glm::mat4& model, const glm::vec3& color) const;
+
 public:
     std::string mFilename;
     std::string mDirectory;
@@ -37,10 +39,17 @@ public:
     Model(std::string filename);
 
     bool Load();
+    /**
+     * @brief Frees the meshes and their geometry, Load can be called again afterwards
+     */
+    void Unload();
 
     void Render();
+    void Submit(RenderQueue& queue, Shader& shader, const glm::mat4& model, const glm::vec3& color) const;
+    void Submit(RenderQueue::DrawList& list, Shader& shader, const glm::mat4& model, const glm::vec3& color) const;
+    /**
+     * @brief Local bounds of all meshes together
+     */
+    Bounds GetBounds() const;
 
 };
-
-#define MESH_HP
-#endif
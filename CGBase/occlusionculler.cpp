@@ -0,0 +1,285 @@
+#include "occlusionculler.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cfloat>
+#include <map>
+#include <emmintrin.h>
+
+// Vertices closer to the eye plane than this are treated as behind it
+static const float MIN_W = 1e-3f;
+
+OcclusionCuller::OcclusionCuller()
+    : mDepth(WIDTH * HEIGHT, 0.0f), mTileDepth(TILES_X * TILES_Y, 0.0f), mViewProjection(1.0f) {
+    mTested = 0;
+    mOccluded = 0;
+    mRenderTime = 0.0;
+}
+
+void
+OcclusionCuller::AddOccluder(const float* vertices, unsigned vertexCount, unsigned stride, const unsigned* indices, unsigned indexCount, const glm::mat4& model) {
+    unsigned First = mVertices.size();
+    for (unsigned VertexIdx = 0; VertexIdx < vertexCount; ++VertexIdx) {
+        const float* Position = vertices + VertexIdx * stride;
+        mVertices.push_back(glm::vec3(model * glm::vec4(Position[0], Position[1], Position[2], 1.0f)));
+    }
+    // Edges are matched by index, meshes that split vertices along an edge leave it open,
+    // which only costs occlusion along it
+    unsigned FirstTriangle = mIndices.size() / 3;
+    std::map<std::pair<unsigned, unsigned>, unsigned> Edges;
+    for (unsigned IndexIdx = 0; IndexIdx + 2 < indexCount; IndexIdx += 3) {
+        unsigned TriangleIdx = FirstTriangle + IndexIdx / 3;
+        for (unsigned Edge = 0; Edge < 3; ++Edge) {
+            unsigned From = First + indices[IndexIdx + Edge];
+            unsigned To = First + indices[IndexIdx + (Edge + 1) % 3];
+            mIndices.push_back(From);
+            mNeighbors.push_back(NO_NEIGHBOR);
+            std::pair<unsigned, unsigned> Key(std::min(From, To), std::max(From, To));
+            std::map<std::pair<unsigned, unsigned>, unsigned>::iterator Match = Edges.find(Key);
+            if (Match == Edges.end()) {
+                Edges[Key] = TriangleIdx * 3 + Edge;
+                continue;
+            }
+            // Edges of more than two triangles keep the first pairing, the rest stay open
+            if (mNeighbors[Match->second] == NO_NEIGHBOR) {
+                mNeighbors[Match->second] = TriangleIdx;
+                mNeighbors.back() = Match->second / 3;
+            }
+        }
+    }
+}
+
+void
+OcclusionCuller::ClearOccluders() {
+    mVertices.clear();
+    mIndices.clear();
+    mNeighbors.clear();
+}
+
+void
+OcclusionCuller::Render(const glm::mat4& viewProjection, const glm::mat4& occluderWorld, JobSystem& jobs) {
+    std::chrono::high_resolution_clock::time_point Start = std::chrono::high_resolution_clock::now();
+    mViewProjection = viewProjection;
+    mTested = 0;
+    mOccluded = 0;
+
+    // Occluder vertices to screen space, one column multiply-add per coordinate
+    glm::mat4 Transform = viewProjection * occluderWorld;
+    __m128 Columns[4];
+    for (unsigned Column = 0; Column < 4; ++Column) {
+        Columns[Column] = _mm_loadu_ps(&Transform[Column][0]);
+    }
+    mScreen.resize(mVertices.size());
+    for (unsigned VertexIdx = 0; VertexIdx < mVertices.size(); ++VertexIdx) {
+        const glm::vec3& Position = mVertices[VertexIdx];
+        __m128 Clip = _mm_add_ps(_mm_add_ps(_mm_mul_ps(Columns[0], _mm_set1_ps(Position.x)), _mm_mul_ps(Columns[1], _mm_set1_ps(Position.y))),
+            _mm_add_ps(_mm_mul_ps(Columns[2], _mm_set1_ps(Position.z)), Columns[3]));
+        float Coordinates[4];
+        _mm_storeu_ps(Coordinates, Clip);
+        glm::vec4& Screen = mScreen[VertexIdx];
+        Screen.w = Coordinates[3];
+        if (Screen.w > MIN_W) {
+            Screen.z = 1.0f / Screen.w;
+            Screen.x = (Coordinates[0] * Screen.z * 0.5f + 0.5f) * WIDTH;
+            Screen.y = (Coordinates[1] * Screen.z * 0.5f + 0.5f) * HEIGHT;
+        }
+    }
+
+    // Areas first, whether an edge is on the outline depends on how its neighbor faces
+    mAreas.assign(mIndices.size() / 3, 0.0f);
+    for (unsigned IndexIdx = 0; IndexIdx + 2 < mIndices.size(); IndexIdx += 3) {
+        const glm::vec4& V0 = mScreen[mIndices[IndexIdx]];
+        const glm::vec4& V1 = mScreen[mIndices[IndexIdx + 1]];
+        const glm::vec4& V2 = mScreen[mIndices[IndexIdx + 2]];
+        // Clipping is left out, skipping an occluder only ever keeps more objects visible
+        if (V0.w <= MIN_W || V1.w <= MIN_W || V2.w <= MIN_W) {
+            continue;
+        }
+        float Area = (V1.x - V0.x) * (V2.y - V0.y) - (V2.x - V0.x) * (V1.y - V0.y);
+        if (std::fabs(Area) >= 1e-6f) {
+            mAreas[IndexIdx / 3] = Area;
+        }
+    }
+
+    mTriangles.clear();
+    for (unsigned IndexIdx = 0; IndexIdx + 2 < mIndices.size(); IndexIdx += 3) {
+        float Area = mAreas[IndexIdx / 3];
+        if (Area == 0.0f) {
+            continue;
+        }
+        const glm::vec4& V0 = mScreen[mIndices[IndexIdx]];
+        const glm::vec4& V1 = mScreen[mIndices[IndexIdx + 1]];
+        const glm::vec4& V2 = mScreen[mIndices[IndexIdx + 2]];
+        float MinX = std::max(std::min(V0.x, std::min(V1.x, V2.x)), 0.0f);
+        float MinY = std::max(std::min(V0.y, std::min(V1.y, V2.y)), 0.0f);
+        float MaxX = std::min(std::max(V0.x, std::max(V1.x, V2.x)), (float)WIDTH - 1);
+        float MaxY = std::min(std::max(V0.y, std::max(V1.y, V2.y)), (float)HEIGHT - 1);
+        if (MinX > MaxX || MinY > MaxY) {
+            continue;
+        }
+
+        Triangle Setup;
+        Setup.MinX = (int)MinX;
+        Setup.MinY = (int)MinY;
+        Setup.MaxX = (int)MaxX;
+        Setup.MaxY = (int)MaxY;
+        // Both windings are drawn, the sign flip makes the inside positive for either
+        float Sign = Area > 0.0f ? 1.0f : -1.0f;
+        const glm::vec4* Vertices[3] = { &V0, &V1, &V2 };
+        for (unsigned Edge = 0; Edge < 3; ++Edge) {
+            const glm::vec4& From = *Vertices[Edge];
+            const glm::vec4& To = *Vertices[(Edge + 1) % 3];
+            Setup.EdgeA[Edge] = Sign * (From.y - To.y);
+            Setup.EdgeB[Edge] = Sign * (To.x - From.x);
+            Setup.EdgeC[Edge] = Sign * (From.x * To.y - From.y * To.x);
+            // Outline edges are tested at the pixel corner nearest them instead of the center.
+            // Inside a mesh the neighbor covers the other side, unless it faces away or was skipped.
+            unsigned Neighbor = mNeighbors[IndexIdx + Edge];
+            if (Neighbor == NO_NEIGHBOR || mAreas[Neighbor] * Area <= 0.0f) {
+                Setup.EdgeC[Edge] -= 0.5f * (std::fabs(Setup.EdgeA[Edge]) + std::fabs(Setup.EdgeB[Edge]));
+            }
+        }
+        Setup.DepthX = ((V1.z - V0.z) * (V2.y - V0.y) - (V1.y - V0.y) * (V2.z - V0.z)) / Area;
+        Setup.DepthY = ((V1.x - V0.x) * (V2.z - V0.z) - (V1.z - V0.z) * (V2.x - V0.x)) / Area;
+        // Farthest depth over the pixel square rather than at its centre
+        Setup.Depth = V0.z - Setup.DepthX * V0.x - Setup.DepthY * V0.y - 0.5f * (std::fabs(Setup.DepthX) + std::fabs(Setup.DepthY));
+        mTriangles.push_back(Setup);
+    }
+
+    std::function<void(unsigned)> Band = [this](unsigned band) {
+        rasterizeBand(band);
+    };
+    jobs.Run(Band, BAND_COUNT);
+    std::chrono::duration<double> Elapsed = std::chrono::high_resolution_clock::now() - Start;
+    mRenderTime = Elapsed.count();
+}
+
+bool
+OcclusionCuller::IsBoxVisible(const glm::vec3& min, const glm::vec3& max) {
+    mTested++;
+    // Screen rectangle of the corners and the depth of the nearest one, depth is linear in
+    // view space so no point of the box is nearer than its nearest corner
+    float MinX = FLT_MAX;
+    float MinY = FLT_MAX;
+    float MaxX = -FLT_MAX;
+    float MaxY = -FLT_MAX;
+    float Nearest = 0.0f;
+    for (unsigned Corner = 0; Corner < 8; ++Corner) {
+        glm::vec4 Position((Corner & 1) ? max.x : min.x, (Corner & 2) ? max.y : min.y, (Corner & 4) ? max.z : min.z, 1.0f);
+        glm::vec4 Clip = mViewProjection * Position;
+        if (Clip.w <= MIN_W) {
+            return true;
+        }
+        float InverseW = 1.0f / Clip.w;
+        float X = (Clip.x * InverseW * 0.5f + 0.5f) * WIDTH;
+        float Y = (Clip.y * InverseW * 0.5f + 0.5f) * HEIGHT;
+        MinX = std::min(MinX, X);
+        MinY = std::min(MinY, Y);
+        MaxX = std::max(MaxX, X);
+        MaxY = std::max(MaxY, Y);
+        Nearest = std::max(Nearest, InverseW);
+    }
+    if (MaxX < 0.0f || MaxY < 0.0f || MinX >= WIDTH || MinY >= HEIGHT) {
+        // Off screen is the frustum culler's call
+        return true;
+    }
+
+    int X0 = (int)std::max(MinX, 0.0f);
+    int Y0 = (int)std::max(MinY, 0.0f);
+    int X1 = (int)std::min(MaxX, (float)WIDTH - 1);
+    int Y1 = (int)std::min(MaxY, (float)HEIGHT - 1);
+    for (int TileY = Y0 / TILE_SIZE; TileY <= Y1 / (int)TILE_SIZE; ++TileY) {
+        for (int TileX = X0 / TILE_SIZE; TileX <= X1 / (int)TILE_SIZE; ++TileX) {
+            // Behind the farthest occluder pixel of the tile, nothing in it can show
+            if (Nearest < mTileDepth[TileY * TILES_X + TileX]) {
+                continue;
+            }
+            int PixelY1 = std::min(Y1, (TileY + 1) * (int)TILE_SIZE - 1);
+            int PixelX1 = std::min(X1, (TileX + 1) * (int)TILE_SIZE - 1);
+            for (int Y = std::max(Y0, TileY * (int)TILE_SIZE); Y <= PixelY1; ++Y) {
+                for (int X = std::max(X0, TileX * (int)TILE_SIZE); X <= PixelX1; ++X) {
+                    if (mDepth[Y * WIDTH + X] <= Nearest) {
+                        return true;
+                    }
+                }
+            }
+        }
+    }
+    mOccluded++;
+    return false;
+}
+
+OcclusionCuller::Stats
+OcclusionCuller::GetStats() const {
+    Stats Result;
+    Result.OccluderTriangles = mIndices.size() / 3;
+    Result.RasterizedTriangles = mTriangles.size();
+    Result.Tested = mTested;
+    Result.Occluded = mOccluded;
+    Result.RenderTime = mRenderTime;
+    return Result;
+}
+
+void
+OcclusionCuller::rasterizeBand(unsigned band) {
+    const int BandMinY = band * BAND_TILES * TILE_SIZE;
+    const int BandMaxY = BandMinY + BAND_TILES * TILE_SIZE - 1;
+    std::fill(mDepth.begin() + BandMinY * WIDTH, mDepth.begin() + (BandMaxY + 1) * WIDTH, 0.0f);
+
+    const __m128 Zero = _mm_setzero_ps();
+    const __m128 PixelCenters = _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f);
+    for (const Triangle& Current : mTriangles) {
+        if (Current.MaxY < BandMinY || Current.MinY > BandMaxY) {
+            continue;
+        }
+
+        // Spans of four start on a multiple of four, WIDTH is one too so they never run past a row
+        int StartX = Current.MinX & ~3;
+        __m128 StartPixelX = _mm_add_ps(_mm_set1_ps((float)StartX), PixelCenters);
+        __m128 EdgeA[3];
+        __m128 EdgeStep[3];
+        for (unsigned Edge = 0; Edge < 3; ++Edge) {
+            EdgeA[Edge] = _mm_set1_ps(Current.EdgeA[Edge]);
+            EdgeStep[Edge] = _mm_set1_ps(Current.EdgeA[Edge] * 4.0f);
+        }
+        __m128 DepthX = _mm_set1_ps(Current.DepthX);
+        __m128 DepthStep = _mm_set1_ps(Current.DepthX * 4.0f);
+
+        int EndY = std::min(Current.MaxY, BandMaxY);
+        for (int Y = std::max(Current.MinY, BandMinY); Y <= EndY; ++Y) {
+            float PixelY = Y + 0.5f;
+            __m128 Edges[3];
+            for (unsigned Edge = 0; Edge < 3; ++Edge) {
+                Edges[Edge] = _mm_add_ps(_mm_mul_ps(EdgeA[Edge], StartPixelX), _mm_set1_ps(Current.EdgeB[Edge] * PixelY + Current.EdgeC[Edge]));
+            }
+            __m128 Depth = _mm_add_ps(_mm_mul_ps(DepthX, StartPixelX), _mm_set1_ps(Current.DepthY * PixelY + Current.Depth));
+            float* Row = &mDepth[Y * WIDTH];
+            for (int X = StartX; X <= Current.MaxX; X += 4) {
+                __m128 Covered = _mm_and_ps(_mm_and_ps(_mm_cmpge_ps(Edges[0], Zero), _mm_cmpge_ps(Edges[1], Zero)), _mm_cmpge_ps(Edges[2], Zero));
+                if (_mm_movemask_ps(Covered)) {
+                    __m128 Old = _mm_loadu_ps(Row + X);
+                    __m128 Nearer = _mm_max_ps(Old, Depth);
+                    _mm_storeu_ps(Row + X, _mm_or_ps(_mm_and_ps(Covered, Nearer), _mm_andnot_ps(Covered, Old)));
+                }
+                for (unsigned Edge = 0; Edge < 3; ++Edge) {
+                    Edges[Edge] = _mm_add_ps(Edges[Edge], EdgeStep[Edge]);
+                }
+                Depth = _mm_add_ps(Depth, DepthStep);
+            }
+        }
+    }
+
+    // Farthest depth of each tile in the band
+    for (unsigned TileY = band * BAND_TILES; TileY < (band + 1) * BAND_TILES; ++TileY) {
+        for (unsigned TileX = 0; TileX < TILES_X; ++TileX) {
+            __m128 Farthest = _mm_set1_ps(FLT_MAX);
+            for (unsigned Y = TileY * TILE_SIZE; Y < (TileY + 1) * TILE_SIZE; ++Y) {
+                const float* Row = &mDepth[Y * WIDTH + TileX * TILE_SIZE];
+                Farthest = _mm_min_ps(Farthest, _mm_min_ps(_mm_loadu_ps(Row), _mm_loadu_ps(Row + 4)));
+            }
+            float Lanes[4];
+            _mm_storeu_ps(Lanes, Farthest);
+            mTileDepth[TileY * TILES_X + TileX] = std::min(std::min(Lanes[0], Lanes[1]), std::min(Lanes[2], Lanes[3]));
+        }
+    }
+}
@@ -0,0 +1,107 @@
+/**
+ * @file occlusionculler.hpp
+ * @brief CPU occlusion culling: a few simple occluders are rasterized into a small depth buffer
+ * and object boxes are tested against it before their draws are submitted.
+ *
+ * The buffer stores 1 / w, larger is nearer, so depth interpolates linearly across the screen.
+ * Rasterization covers four pixels per SSE step, coverage is the lane mask of the three edge
+ * tests, and runs on the job system in horizontal bands of tiles. Every 8x8 tile also keeps
+ * its farthest depth, so a box behind all of a tile is rejected without reading its pixels.
+ *
+ * Coverage errs on the side of visible: edges on an occluder's outline are moved in by half a
+ * pixel, so a pixel counts only when its whole square lies inside, and it stores the farthest
+ * depth of the triangle's plane over the square. Edges shared with a neighbor facing the same
+ * way stay put, so the diagonals of a quad do not open cracks. Near sharp outline corners a
+ * pixel may still overhang by less than half a pixel.
+ */
+
+#pragma once
+#include <vector>
+#include <glm/glm.hpp>
+#include "jobsystem.hpp"
+
+class OcclusionCuller {
+public:
+    static const unsigned WIDTH = 256;
+    static const unsigned HEIGHT = 144;
+    static const unsigned TILE_SIZE = 8;
+
+    struct Stats {
+        unsigned OccluderTriangles;
+        // Triangles that passed setup in the last Render
+        unsigned RasterizedTriangles;
+        unsigned Tested;
+        unsigned Occluded;
+        double RenderTime;
+    };
+
+    OcclusionCuller();
+
+    /**
+     * @brief Adds the triangles of an indexed mesh, transformed by model, to the occluders.
+     * Positions are the first 3 of every stride floats. Occluders should be solid and closed,
+     * both of their faces are rasterized.
+     */
+    void AddOccluder(const float* vertices, unsigned vertexCount, unsigned stride, const unsigned* indices, unsigned indexCount, const glm::mat4& model);
+    void ClearOccluders();
+
+    /**
+     * @brief Clears the buffer and rasterizes every occluder placed by occluderWorld
+     *
+     * @param viewProjection Transform to clip space boxes are tested with
+     */
+    void Render(const glm::mat4& viewProjection, const glm::mat4& occluderWorld, JobSystem& jobs);
+    /**
+     * @brief False only if the world-space box is hidden behind the occluders of the last Render.
+     * Every pixel the box's screen rectangle touches has to be wholly covered by a nearer
+     * occluder, so a sliver between occluders keeps what is behind it visible.
+     */
+    bool IsBoxVisible(const glm::vec3& min, const glm::vec3& max);
+    /**
+     * @brief Counts tests since the last Render
+     */
+    Stats GetStats() const;
+
+private:
+    static const unsigned TILES_X = WIDTH / TILE_SIZE;
+    static const unsigned TILES_Y = HEIGHT / TILE_SIZE;
+    // Tile rows per job
+    static const unsigned BAND_TILES = 2;
+    static const unsigned BAND_COUNT = TILES_Y / BAND_TILES;
+
+    static const unsigned NO_NEIGHBOR = 0xFFFFFFFF;
+
+    // Edge functions and depth plane of a screen-space triangle, inside is where all edges are >= 0
+    struct Triangle {
+        float EdgeA[3];
+        float EdgeB[3];
+        float EdgeC[3];
+        float Depth;
+        float DepthX;
+        float DepthY;
+        int MinX;
+        int MinY;
+        int MaxX;
+        int MaxY;
+    };
+
+    // Occluder positions relative to occluderWorld
+    std::vector<glm::vec3> mVertices;
+    std::vector<unsigned> mIndices;
+    // Triangle across each edge of every occluder triangle, NO_NEIGHBOR on open edges
+    std::vector<unsigned> mNeighbors;
+    // Per-frame scratch: x, y in pixels, 1 / w, and w
+    std::vector<glm::vec4> mScreen;
+    // Signed screen area of every occluder triangle, 0 for the ones skipped
+    std::vector<float> mAreas;
+    std::vector<Triangle> mTriangles;
+    std::vector<float> mDepth;
+    // Farthest depth of every tile
+    std::vector<float> mTileDepth;
+    glm::mat4 mViewProjection;
+    unsigned mTested;
+    unsigned mOccluded;
+    double mRenderTime;
+
+    void rasterizeBand(unsigned band);
+};
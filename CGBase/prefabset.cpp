@@ -0,0 +1,212 @@
+#include "prefabset.hpp"
+#include <chrono>
+#include <cstring>
+
+PrefabSet::PrefabSet() {
+    // Anything but a valid matrix, so the first Update places every instance
+    mRoot = glm::mat4(0.0f);
+    mVisible = 0;
+    mDrawCalls = 0;
+    mUploadedBytes = 0;
+    mUpdateTime = 0.0;
+}
+
+PrefabSet::~PrefabSet() {
+    for (Prefab& Current : mPrefabs) {
+        for (Batch& Part : Current.Batches) {
+            delete Part.Buffers[0];
+            delete Part.Buffers[1];
+        }
+    }
+}
+
+PrefabSet::PrefabId
+PrefabSet::AddPrefab(const std::string& name) {
+    Prefab NewPrefab;
+    NewPrefab.Name = name;
+    NewPrefab.HasBounds = false;
+    NewPrefab.Dirty = true;
+    mPrefabs.push_back(NewPrefab);
+    return mPrefabs.size() - 1;
+}
+
+PrefabSet::PrefabId
+PrefabSet::FindPrefab(const std::string& name) const {
+    for (PrefabId Id = 0; Id < mPrefabs.size(); ++Id) {
+        if (mPrefabs[Id].Name == name) {
+            return Id;
+        }
+    }
+    return INVALID_PREFAB;
+}
+
+void
+PrefabSet::AddPart(PrefabId prefab, const Renderable* primitive, const glm::mat4& local, const glm::vec3& color, unsigned diffuseTexture, unsigned specularTexture) {
+    Prefab& Current = mPrefabs[prefab];
+    bool Mirrored = glm::determinant(glm::mat3(local)) < 0.0f;
+    Batch* Target = 0;
+    for (Batch& Candidate : Current.Batches) {
+        if (Candidate.Primitive == primitive && Candidate.DiffuseTexture == diffuseTexture && Candidate.SpecularTexture == specularTexture && Candidate.Mirrored == Mirrored) {
+            Target = &Candidate;
+        }
+    }
+    if (!Target) {
+        Batch NewBatch;
+        NewBatch.Primitive = primitive;
+        NewBatch.DiffuseTexture = diffuseTexture;
+        NewBatch.SpecularTexture = specularTexture;
+        NewBatch.Mirrored = Mirrored;
+        NewBatch.Buffers[0] = new InstanceBuffer();
+        NewBatch.Buffers[1] = new InstanceBuffer();
+        Current.Batches.push_back(NewBatch);
+        Target = &Current.Batches.back();
+    }
+    Target->Locals.push_back(local);
+    Target->Colors.push_back(glm::vec4(color, 1.0f));
+
+    glm::vec3 Min;
+    glm::vec3 Max;
+    primitive->GetBounds().WorldBox(local, Min, Max);
+    Bounds PartBounds = Bounds();
+    PartBounds.Min = Min;
+    PartBounds.Max = Max;
+    PartBounds.Center = (Min + Max) * 0.5f;
+    PartBounds.Radius = glm::length(Max - Min) * 0.5f;
+    Current.LocalBounds = Current.HasBounds ? Bounds::Merge(Current.LocalBounds, PartBounds) : PartBounds;
+    Current.HasBounds = true;
+    Current.Dirty = true;
+}
+
+unsigned
+PrefabSet::AddInstance(PrefabId prefab, const glm::mat4& world) {
+    Prefab& Current = mPrefabs[prefab];
+    Current.Instances.push_back(world);
+    Current.Dirty = true;
+    return Current.Instances.size() - 1;
+}
+
+void
+PrefabSet::SetInstance(PrefabId prefab, unsigned instance, const glm::mat4& world) {
+    mPrefabs[prefab].Instances[instance] = world;
+    mPrefabs[prefab].Dirty = true;
+}
+
+void
+PrefabSet::SetInstanceCount(PrefabId prefab, unsigned count) {
+    Prefab& Current = mPrefabs[prefab];
+    if (count < Current.Instances.size()) {
+        Current.Instances.resize(count);
+        Current.Dirty = true;
+    }
+}
+
+unsigned
+PrefabSet::GetInstanceCount(PrefabId prefab) const {
+    return mPrefabs[prefab].Instances.size();
+}
+
+void
+PrefabSet::Update(const glm::mat4& root, const FrustumCuller& culler) {
+    std::chrono::high_resolution_clock::time_point Start = std::chrono::high_resolution_clock::now();
+    bool RootChanged = std::memcmp(&root, &mRoot, sizeof(root)) != 0;
+    mRoot = root;
+    mVisible = 0;
+    mUploadedBytes = 0;
+    for (Prefab& Current : mPrefabs) {
+        updatePrefab(Current, RootChanged, culler);
+    }
+    std::chrono::duration<double> Elapsed = std::chrono::high_resolution_clock::now() - Start;
+    mUpdateTime = Elapsed.count();
+}
+
+void
+PrefabSet::Render(Shader& program) {
+    mDrawCalls = 0;
+    GLState::UseProgram(program.GetId());
+    GLState::SetDepthFunc(GL_LESS);
+    GLState::SetDepthMask(true);
+    for (Prefab& Current : mPrefabs) {
+        for (Batch& Part : Current.Batches) {
+            for (unsigned WorldMirrored = 0; WorldMirrored < 2; ++WorldMirrored) {
+                InstanceBuffer* Buffer = Part.Buffers[WorldMirrored];
+                if (!Buffer->GetCount()) {
+                    continue;
+                }
+                // Two mirrorings cancel out
+                GLState::SetCullFace(Part.Mirrored != (WorldMirrored != 0) ? GL_FRONT : GL_BACK);
+                Part.Primitive->RenderInstanced(Buffer->GetCount(), Buffer->GetId(), Part.DiffuseTexture, Part.SpecularTexture);
+                mDrawCalls++;
+            }
+        }
+    }
+}
+
+PrefabSet::Stats
+PrefabSet::GetStats() const {
+    Stats Result;
+    Result.Prefabs = mPrefabs.size();
+    Result.Instances = 0;
+    for (const Prefab& Current : mPrefabs) {
+        Result.Instances += Current.Instances.size();
+    }
+    Result.Visible = mVisible;
+    Result.DrawCalls = mDrawCalls;
+    Result.UploadedBytes = mUploadedBytes;
+    Result.UpdateTime = mUpdateTime;
+    return Result;
+}
+
+void
+PrefabSet::updatePrefab(Prefab& prefab, bool rootChanged, const FrustumCuller& culler) {
+    unsigned Count = prefab.Instances.size();
+    bool Moved = rootChanged || prefab.Dirty;
+    if (Moved) {
+        prefab.Worlds.resize(Count);
+        prefab.MirroredWorlds.resize(Count);
+        prefab.Spheres.assign((Count + 3) / 4 * FrustumCuller::BLOCK_FLOATS, 0.0f);
+        for (unsigned InstanceIdx = 0; InstanceIdx < Count; ++InstanceIdx) {
+            prefab.Worlds[InstanceIdx] = mRoot * prefab.Instances[InstanceIdx];
+            prefab.MirroredWorlds[InstanceIdx] = glm::determinant(glm::mat3(prefab.Worlds[InstanceIdx])) < 0.0f;
+            glm::vec4 Sphere = prefab.LocalBounds.WorldSphere(prefab.Worlds[InstanceIdx]);
+            float* Block = &prefab.Spheres[InstanceIdx / 4 * FrustumCuller::BLOCK_FLOATS + InstanceIdx % 4];
+            Block[0] = Sphere.x;
+            Block[4] = Sphere.y;
+            Block[8] = Sphere.z;
+            Block[12] = Sphere.w;
+        }
+        prefab.Dirty = false;
+    }
+
+    prefab.Visible.resize(Count);
+    if (Count) {
+        mVisible += culler.Cull(&prefab.Spheres[0], Count, &prefab.Visible[0]);
+    }
+    // A camera standing still keeps the buffers of the last frame
+    if (!Moved && prefab.Visible == prefab.LastVisible) {
+        return;
+    }
+    prefab.LastVisible = prefab.Visible;
+
+    for (Batch& Part : prefab.Batches) {
+        Part.Instances[0].clear();
+        Part.Instances[1].clear();
+        for (unsigned InstanceIdx = 0; InstanceIdx < Count; ++InstanceIdx) {
+            if (!prefab.Visible[InstanceIdx]) {
+                continue;
+            }
+            std::vector<InstanceData>& Target = Part.Instances[prefab.MirroredWorlds[InstanceIdx]];
+            for (unsigned LocalIdx = 0; LocalIdx < Part.Locals.size(); ++LocalIdx) {
+                InstanceData Data = { prefab.Worlds[InstanceIdx] * Part.Locals[LocalIdx], Part.Colors[LocalIdx] };
+                Target.push_back(Data);
+            }
+        }
+        for (unsigned WorldMirrored = 0; WorldMirrored < 2; ++WorldMirrored) {
+            // Most prefabs never mirror, leave the buffer that stays empty alone
+            if (Part.Instances[WorldMirrored].empty() && !Part.Buffers[WorldMirrored]->GetCount()) {
+                continue;
+            }
+            Part.Buffers[WorldMirrored]->Upload(Part.Instances[WorldMirrored]);
+            mUploadedBytes += Part.Instances[WorldMirrored].size() * sizeof(InstanceData);
+        }
+    }
+}
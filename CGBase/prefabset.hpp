@@ -0,0 +1,113 @@
+/**
+ * @file prefabset.hpp
+ * @brief Composite objects defined once as a list of parts and placed many times, every part of
+ * every instance of a prefab drawn by a single instanced draw.
+ *
+ * Parts of a prefab that share geometry and textures are merged into one batch, so a prefab
+ * costs one draw per batch however many instances it has. Mirroring parts and instances get
+ * batches and buffers of their own, drawn with the front faces culled instead of the back.
+ * Update culls the instances' bounding spheres against the frustum and rebuilds a batch's
+ * instance buffer only when the visible instances or their transforms changed. Draws go
+ * straight to GL after the queue, through a program that reads the model matrix and color per
+ * instance (shaders/phong_instanced.vert).
+ */
+
+#pragma once
+#include <string>
+#include <vector>
+#include <glm/glm.hpp>
+#include "renderable.hpp"
+#include "instancebuffer.hpp"
+#include "frustumculler.hpp"
+#include "bounds.hpp"
+
+class PrefabSet {
+public:
+    typedef unsigned PrefabId;
+    static const PrefabId INVALID_PREFAB = 0xFFFFFFFF;
+
+    struct Stats {
+        unsigned Prefabs;
+        unsigned Instances;
+        unsigned Visible;
+        // Instanced draws issued by the last Render, one per batch buffer with visible instances
+        unsigned DrawCalls;
+        // Instance buffer bytes uploaded by the last Update
+        unsigned UploadedBytes;
+        double UpdateTime;
+    };
+
+    PrefabSet();
+    ~PrefabSet();
+
+    PrefabId AddPrefab(const std::string& name);
+    PrefabId FindPrefab(const std::string& name) const;
+    /**
+     * @brief Adds primitive placed at local relative to the prefab origin
+     */
+    void AddPart(PrefabId prefab, const Renderable* primitive, const glm::mat4& local, const glm::vec3& color, unsigned diffuseTexture, unsigned specularTexture);
+    /**
+     * @brief Places prefab at world relative to the root passed to Update
+     *
+     * @returns Index of the instance within its prefab
+     */
+    unsigned AddInstance(PrefabId prefab, const glm::mat4& world);
+    void SetInstance(PrefabId prefab, unsigned instance, const glm::mat4& world);
+    // Drops the instances from count on
+    void SetInstanceCount(PrefabId prefab, unsigned count);
+    unsigned GetInstanceCount(PrefabId prefab) const;
+
+    /**
+     * @brief Culls the instances placed under root against culler and refills the instance
+     * buffers of the prefabs whose visible instances changed
+     */
+    void Update(const glm::mat4& root, const FrustumCuller& culler);
+    /**
+     * @brief Draws every batch with visible instances. Per-frame uniforms of program have to be
+     * set beforehand, depth testing is left at GL_LESS with writes on and the cull face at
+     * whatever the last batch needed.
+     */
+    void Render(Shader& program);
+    Stats GetStats() const;
+
+private:
+    // Parts sharing geometry, textures and handedness, one instanced draw per buffer
+    struct Batch {
+        const Renderable* Primitive;
+        unsigned DiffuseTexture;
+        unsigned SpecularTexture;
+        // Locals flip the winding of the primitive
+        bool Mirrored;
+        std::vector<glm::mat4> Locals;
+        std::vector<glm::vec4> Colors;
+        // Indexed by whether the instance world mirrors, the two need opposite cull faces
+        std::vector<InstanceData> Instances[2];
+        InstanceBuffer* Buffers[2];
+    };
+
+    struct Prefab {
+        std::string Name;
+        std::vector<Batch> Batches;
+        // Box around every part, relative to the prefab origin
+        Bounds LocalBounds;
+        bool HasBounds;
+        std::vector<glm::mat4> Instances;
+        // World matrices under the root and bounding spheres in FrustumCuller blocks
+        std::vector<glm::mat4> Worlds;
+        std::vector<unsigned char> MirroredWorlds;
+        std::vector<float> Spheres;
+        std::vector<unsigned char> Visible;
+        std::vector<unsigned char> LastVisible;
+        // Transforms or parts changed since the last Update
+        bool Dirty;
+    };
+
+    std::vector<Prefab> mPrefabs;
+    glm::mat4 mRoot;
+    unsigned mVisible;
+    unsigned mDrawCalls;
+    unsigned mUploadedBytes;
+    double mUpdateTime;
+
+    void updatePrefab(Prefab& prefab, bool rootChanged, const FrustumCuller& culler);
+};
@@ -1,80 +1,115 @@
 #include "renderable.hpp"
+#include <cstddef>
 int Renderable::rCount;
+unsigned int Renderable::instanceVBO = 0;
 
 Renderable::Renderable(const float* vertices, const unsigned int verticesSize, const  unsigned int* indices, const int indicesSize) {
-	vCount = verticesSize / (6 * sizeof(float));
-	iCount = indicesSize / 3;
+	//Velicine su u bajtovima, tjeme ima 8 float-ova (pozicija, normala, UV)
+	vCount = verticesSize / (8 * sizeof(float));
+	iCount = indicesSize / sizeof(unsigned int);
 
-	
-	glGenVertexArrays(1, &VAO);
-	std::cout << "-Made an array-" << std::endl;
-	glBindVertexArray(VAO);
-
-	glGenBuffers(1, &VBO);
-	glBindBuffer(GL_ARRAY_BUFFER, VBO);
-	std::cout << "-Made a buffer-" << std::endl;
-	glBufferData(GL_ARRAY_BUFFER, verticesSize, vertices, GL_STATIC_DRAW);
-
-	glVertexAttribPointer(0, 3, GL_FLOAT, false, (8 * sizeof(float)), (void*)0);
-	glEnableVertexAttribArray(0);
-	glVertexAttribPointer(1, 3, GL_FLOAT, false, (8 * sizeof(float)), (void*)(3 * sizeof(float)));
-	glEnableVertexAttribArray(1);					
-	glVertexAttribPointer(2, 2, GL_FLOAT, false, (8 * sizeof(float)), (void*)(6 * sizeof(float)));
-	glEnableVertexAttribArray(2);
-
-	if (iCount > 0)
-	{
-		std::cout << "-Made a buffer for indexing-" << std::endl;
-		glGenBuffers(1, &EBO);
-		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-		glBufferData(GL_ELEMENT_ARRAY_BUFFER, indicesSize, indices, GL_STATIC_DRAW);
-	}
-
-	glBindVertexArray(0);
+	//Geometrija ide u zajednicki bafer, svi objekti istog formata dijele jedan VAO
+	range = GeometryArena::Allocate(GeometryArena::FORMAT_POS_NORMAL_UV, vertices, vCount, indices, iCount);
+	VAO = GeometryArena::GetVAO(GeometryArena::FORMAT_POS_NORMAL_UV);
+	bounds = Bounds::FromVertices(vertices, vCount, 8);
+	std::cout << "-Allocated " << vCount << " vertices and " << iCount << " indices in the geometry arena-" << std::endl;
 
 	Renderable:rCount++;
 }
 Renderable::~Renderable() {
-
-	glDeleteBuffers(1, &VBO);
-	std::cout << "-Deleted a buffer-" << std::endl;
-	if (iCount > 0){
-		glDeleteBuffers(1, &EBO);
-		std::cout << "-Deleted a buffer for indexing-" << std::endl;
-	}
-	std::cout << "-Deleted an array-" << std::endl;
-	glDeleteVertexArrays(1, &VAO);
+	GeometryArena::Free(range);
+	std::cout << "-Freed geometry arena range-" << std::endl;
 
 	Renderable::rCount--;
 }
 void Renderable::Render(unsigned diffuseTexture, unsigned specularTexture) {
-	glActiveTexture(GL_TEXTURE0);
-	glBindTexture(GL_TEXTURE_2D, diffuseTexture);
-	glActiveTexture(GL_TEXTURE1);
-	glBindTexture(GL_TEXTURE_2D, specularTexture);
-	glBindVertexArray(VAO);
+	GLState::BindTexture(0, diffuseTexture);
+	GLState::BindTexture(1, specularTexture);
+	Render();
+}
+void Renderable::Render() {
+	GLState::BindVertexArray(VAO);
 	if (iCount > 0)
 	{
-		glDrawElements(GL_TRIANGLES, iCount, GL_UNSIGNED_INT, 0);
+		glDrawElementsBaseVertex(GL_TRIANGLES, iCount, GL_UNSIGNED_INT, (void*)(range.FirstIndex * sizeof(unsigned int)), range.BaseVertex);
 	}
 	else
 	{
-		std::cout << "-Drawing with vertices-" << std::endl;
-		glDrawArrays(GL_TRIANGLES, 0, vCount);
+		glDrawArrays(GL_TRIANGLES, range.BaseVertex, vCount);
 	}
-	glBindVertexArray(0);
 }
-void Renderable::Render() {
-	glBindVertexArray(VAO);
+const Bounds& Renderable::GetBounds() const {
+	return bounds;
+}
+void Renderable::RenderInstanced(unsigned count, unsigned instanceBuffer, unsigned diffuseTexture, unsigned specularTexture) const {
+	GLState::BindTexture(0, diffuseTexture);
+	GLState::BindTexture(1, specularTexture);
+	GLState::BindVertexArray(VAO);
+	attachInstanceBuffer(instanceBuffer);
 	if (iCount > 0)
 	{
-
-		glDrawElements(GL_TRIANGLES, iCount, GL_UNSIGNED_INT, 0);
+		glDrawElementsInstancedBaseVertex(GL_TRIANGLES, iCount, GL_UNSIGNED_INT, (void*)(range.FirstIndex * sizeof(unsigned int)), count, range.BaseVertex);
 	}
 	else
 	{
-		std::cout << "-Drawing with vertices-" << std::endl;
-		glDrawArrays(GL_TRIANGLES, 0, vCount);
+		glDrawArraysInstanced(GL_TRIANGLES, range.BaseVertex, vCount, count);
 	}
-	glBindVertexArray(0);
-}
\ No newline at end of file
+}
+void Renderable::attachInstanceBuffer(unsigned instanceBuffer) const {
+	if (instanceVBO == instanceBuffer)
+	{
+		return;
+	}
+
+	//Bez bafera shader sam racuna instancu iz gl_InstanceID, atributi instance se iskljucuju
+	if (instanceBuffer == 0)
+	{
+		for (unsigned Location = INSTANCE_MODEL_LOCATION; Location <= INSTANCE_COLOR_LOCATION; Location++)
+		{
+			glDisableVertexAttribArray(Location);
+		}
+		instanceVBO = 0;
+		return;
+	}
+
+	//Atributi se podese samo kad se promijeni bafer, VAO ih pamti
+	GLState::BindBuffer(GL_ARRAY_BUFFER, instanceBuffer);
+	const GLsizei Stride = sizeof(InstanceData);
+	for (unsigned Column = 0; Column < 4; Column++)
+	{
+		glVertexAttribPointer(INSTANCE_MODEL_LOCATION + Column, 4, GL_FLOAT, false, Stride, (void*)(Column * 4 * sizeof(float)));
+		glEnableVertexAttribArray(INSTANCE_MODEL_LOCATION + Column);
+		glVertexAttribDivisor(INSTANCE_MODEL_LOCATION + Column, 1);
+	}
+	glVertexAttribPointer(INSTANCE_COLOR_LOCATION, 4, GL_FLOAT, false, Stride, (void*)offsetof(InstanceData, Color));
+	glEnableVertexAttribArray(INSTANCE_COLOR_LOCATION);
+	glVertexAttribDivisor(INSTANCE_COLOR_LOCATION, 1);
+	instanceVBO = instanceBuffer;
+}
+void Renderable::Submit(RenderQueue& queue, Shader& shader, const glm::mat4& model, const glm::vec3& color, unsigned diffuseTexture, unsigned specularTexture, unsigned instances) const {
+	queue.Submit(drawCall(shader, model, color, diffuseTexture, specularTexture, instances));
+}
+void Renderable::Submit(RenderQueue::DrawList& list, Shader& shader, const glm::mat4& model, const glm::vec3& color, unsigned diffuseTexture, unsigned specularTexture, unsigned instances) const {
+	list.Submit(drawCall(shader, model, color, diffuseTexture, specularTexture, instances));
+}
+RenderQueue::DrawCall Renderable::drawCall(Shader& shader, const glm::mat4& model, const glm::vec3& color, unsigned diffuseTexture, unsigned specularTexture, unsigned instances) const {
+	RenderQueue::DrawCall Draw = RenderQueue::DrawCall();
+	Draw.Pass = RenderQueue::PASS_OPAQUE;
+	Draw.Program = &shader;
+	Draw.VAO = VAO;
+	Draw.Indexed = iCount > 0;
+	Draw.Count = Draw.Indexed ? iCount : vCount;
+	Draw.FirstIndex = range.FirstIndex;
+	Draw.BaseVertex = range.BaseVertex;
+	Draw.Instances = instances;
+	Draw.DiffuseTexture = diffuseTexture;
+	Draw.SpecularTexture = specularTexture;
+	Draw.Model = model;
+	Draw.Color = color;
+	//Instance postavlja shader ili bafer instanci, a ne model matrica, pa se takvo crtanje ne odbacuje
+	if (instances == 1)
+	{
+		Draw.Sphere = bounds.WorldSphere(model);
+	}
+	return Draw;
+}
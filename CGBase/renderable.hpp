@@ -1,15 +1,37 @@
-//Za olaksano crtanje objekata. Generise potrebne bafere pri konstrukciji objekta, brise ih pri destrukciji.
+//Za olaksano crtanje objekata. Zauzima prostor u GeometryArena pri konstrukciji objekta, oslobadja ga pri destrukciji.
+#pragma once
 #include <iostream>
 #include <GL/glew.h> //Da bi koristili OpenGL funkcije za bafere
+#include "glstate.hpp"
+#include "instancebuffer.hpp"
+#include "renderqueue.hpp"
+#include "geometryarena.hpp"
+#include "bounds.hpp"
 
 class Renderable { 
-	unsigned int VAO, VBO, EBO;
+	unsigned int VAO;
+	GeometryArena::Range range; //Dio zajednickog bafera koji zauzima ovaj objekat
 	unsigned int vCount;
 	unsigned int iCount;
+	Bounds bounds; //Granice u lokalnom prostoru, racunaju se jednom iz tjemena
+	static unsigned int instanceVBO; //Bafer instanci trenutno vezan za zajednicki VAO
+	void attachInstanceBuffer(unsigned instanceBuffer) const;
+	RenderQueue::DrawCall drawCall(Shader& shader, const glm::mat4& model, const glm::vec3& color, unsigned diffuseTexture, unsigned specularTexture, unsigned instances) const;
 public:
 	static int rCount;
+	//Lokacije atributa instance, model matrica zauzima 4 uzastopne lokacije. Lokacija 3 je aCol iz basic.vert
+	static const unsigned INSTANCE_MODEL_LOCATION = 4;
+	static const unsigned INSTANCE_COLOR_LOCATION = 8;
 	Renderable(const float* vertices, const unsigned int verticesSize, const  unsigned int* indices, const int indicesSize);
 	~Renderable();
 	void Render(unsigned diffuseTexture, unsigned specularTexture);
 	void Render();
+	const Bounds& GetBounds() const;
+	//Crta count instanci jednim pozivom, model matrica i boja svake instance se citaju iz instanceBuffer (raspored kao InstanceData)
+	//Za instanceBuffer 0 shader sam racuna instancu iz gl_InstanceID (npr. shaders/rug.vert)
+	void RenderInstanced(unsigned count, unsigned instanceBuffer, unsigned diffuseTexture, unsigned specularTexture) const;
+	//Umjesto crtanja odmah, dodaje crtanje u red koji ga sortira po stanju, vidi RenderQueue
+	void Submit(RenderQueue& queue, Shader& shader, const glm::mat4& model, const glm::vec3& color, unsigned diffuseTexture, unsigned specularTexture, unsigned instances = 1) const;
+	//Isto, ali u listu koju moze puniti posao na drugoj niti (JobSystem)
+	void Submit(RenderQueue::DrawList& list, Shader& shader, const glm::mat4& model, const glm::vec3& color, unsigned diffuseTexture, unsigned specularTexture, unsigned instances = 1) const;
 };
\ No newline at end of file
@@ -0,0 +1,612 @@
+#include "renderqueue.hpp"
+#include <algorithm>
+#include <cstring>
+#include <cfloat>
+
+// Key layout, most significant first:
+// pass 2 | program 8 | front-face culling 1 | material 15 | VAO 14 | depth 24
+static const unsigned PASS_SHIFT = 62;
+static const unsigned PROGRAM_SHIFT = 54;
+static const unsigned CULL_FRONT_SHIFT = 53;
+static const unsigned MATERIAL_SHIFT = 38;
+static const unsigned VAO_SHIFT = 24;
+static const uint64_t PROGRAM_MASK = 0xFF;
+static const uint64_t MATERIAL_MASK = 0x7FFF;
+static const uint64_t VAO_MASK = 0x3FFF;
+static const uint64_t DEPTH_MASK = 0xFFFFFF;
+static const uint64_t CULL_FRONT_BIT = (uint64_t)1 << CULL_FRONT_SHIFT;
+// Model matrix columns, then color
+static const unsigned DRAW_RECORD_TEXELS = 5;
+
+RenderQueue::RenderQueue() {
+    mCameraPosition = glm::vec3(0.0f);
+    mMaxDistance = 1.0f;
+    mDefaultDiffuse = 0;
+    mDefaultSpecular = 0;
+    mDrawIdCapacity = 0;
+    mDrawCalls = 0;
+    // The base instance of each command has to reach the shader, so ARB_base_instance is needed too
+    mIndirect = GLEW_VERSION_4_3 || (GLEW_ARB_multi_draw_indirect && GLEW_ARB_base_instance);
+
+    glGenBuffers(1, &mDrawDataBuffer);
+    GLState::BindBuffer(GL_TEXTURE_BUFFER, mDrawDataBuffer);
+    glBufferData(GL_TEXTURE_BUFFER, DRAW_RECORD_TEXELS * sizeof(glm::vec4), 0, GL_STREAM_DRAW);
+    glGenTextures(1, &mDrawDataTexture);
+    GLState::BindTexture(DRAW_DATA_UNIT, mDrawDataTexture, GL_TEXTURE_BUFFER);
+    glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, mDrawDataBuffer);
+
+    glGenBuffers(1, &mIndirectBuffer);
+    mCommandBuffer = mIndirectBuffer;
+    mCommandOffset = 0;
+    mRing = 0;
+    mTextureBufferRange = GLEW_VERSION_4_3 || GLEW_ARB_texture_buffer_range;
+    mDrawDataInRing = false;
+    GLint Alignment = 256;
+    if (mTextureBufferRange) {
+        glGetIntegerv(GL_TEXTURE_BUFFER_OFFSET_ALIGNMENT, &Alignment);
+    }
+    mTextureBufferAlignment = Alignment;
+    glGenBuffers(1, &mDrawIdBuffer);
+    mDepthPrepass = false;
+    mPrepared = false;
+    mCuller = 0;
+    mCulled = 0;
+}
+
+RenderQueue::~RenderQueue() {
+    GLState::DeleteBuffer(mDrawDataBuffer);
+    GLState::DeleteTexture(mDrawDataTexture);
+    GLState::DeleteBuffer(mIndirectBuffer);
+    GLState::DeleteBuffer(mDrawIdBuffer);
+}
+
+void
+RenderQueue::SetDefaultTextures(unsigned diffuse, unsigned specular) {
+    mDefaultDiffuse = diffuse;
+    mDefaultSpecular = specular;
+}
+
+void
+RenderQueue::Begin(const glm::vec3& cameraPosition, float maxDistance) {
+    mCameraPosition = cameraPosition;
+    mMaxDistance = maxDistance;
+    mDraws.clear();
+    mPackets.clear();
+    mPrepared = false;
+    mCulled = 0;
+}
+
+void
+RenderQueue::Submit(const DrawCall& draw) {
+    DrawCall Draw = draw;
+    if (!Draw.DiffuseTexture) {
+        Draw.DiffuseTexture = mDefaultDiffuse;
+    }
+    if (!Draw.SpecularTexture) {
+        Draw.SpecularTexture = mDefaultSpecular;
+    }
+
+    mPrepared = false;
+    Packet NewPacket;
+    NewPacket.Key = makeKey(Draw);
+    NewPacket.Draw = mDraws.size();
+    mDraws.push_back(Draw);
+    mPackets.push_back(NewPacket);
+}
+
+void
+RenderQueue::Submit(const DrawList& list) {
+    mDraws.reserve(mDraws.size() + list.mDraws.size());
+    mPackets.reserve(mPackets.size() + list.mDraws.size());
+    for (unsigned DrawIdx = 0; DrawIdx < list.mDraws.size(); ++DrawIdx) {
+        Submit(list.mDraws[DrawIdx]);
+    }
+}
+
+void
+RenderQueue::DrawList::Clear() {
+    mDraws.clear();
+}
+
+void
+RenderQueue::DrawList::Submit(const DrawCall& draw) {
+    mDraws.push_back(draw);
+}
+
+unsigned
+RenderQueue::DrawList::GetCount() const {
+    return mDraws.size();
+}
+
+void
+RenderQueue::EnableMultiDraw(Shader& program, Shader& multiDrawProgram) {
+    mMultiDrawPrograms[&program] = &multiDrawProgram;
+}
+
+void
+RenderQueue::SetFrameRing(FrameRing* ring) {
+    mRing = ring;
+}
+
+void
+RenderQueue::SetDepthProgram(Shader& program, Shader& depthProgram) {
+    mDepthPrograms[&program] = &depthProgram;
+}
+
+void
+RenderQueue::SetDepthPrepass(bool enabled) {
+    mDepthPrepass = enabled;
+}
+
+void
+RenderQueue::SetCuller(const FrustumCuller* culler) {
+    mCuller = culler;
+}
+
+void
+RenderQueue::ExecuteDepthPrepass() {
+    if (!mDepthPrepass) {
+        return;
+    }
+    prepare();
+
+    GLState::SetDepthFunc(GL_LESS);
+    GLState::SetDepthMask(true);
+    for (unsigned RunIdx = 0; RunIdx < mRuns.size(); ++RunIdx) {
+        const Run& CurrRun = mRuns[RunIdx];
+        const DrawCall& FirstDraw = mDraws[mPackets[CurrRun.First].Draw];
+        Shader* DepthProgram = depthProgram(FirstDraw);
+        if (!DepthProgram) {
+            continue;
+        }
+        if (CurrRun.MultiDrawProgram) {
+            auto MultiDrawDepth = mDepthPrograms.find(CurrRun.MultiDrawProgram);
+            if (MultiDrawDepth != mDepthPrograms.end()) {
+                drawMulti(CurrRun, MultiDrawDepth->second, false);
+                continue;
+            }
+        }
+        // Every packet of a run shares program and pass, so they all have DepthProgram
+        GLState::UseProgram(DepthProgram->GetId());
+        for (unsigned PacketIdx = CurrRun.First; PacketIdx < CurrRun.First + CurrRun.Count; ++PacketIdx) {
+            const Packet& CurrPacket = mPackets[PacketIdx];
+            const DrawCall& Draw = mDraws[CurrPacket.Draw];
+            DepthProgram->SetModel(Draw.Model);
+            GLState::SetCullFace(CurrPacket.Key & CULL_FRONT_BIT ? GL_FRONT : GL_BACK);
+            GLState::BindVertexArray(Draw.VAO);
+            issueDraw(Draw);
+        }
+    }
+    GLState::SetCullFace(GL_BACK);
+}
+
+void
+RenderQueue::Execute() {
+    prepare();
+
+    Shader* Program = 0;
+    glm::vec3 Color;
+    for (unsigned RunIdx = 0; RunIdx < mRuns.size(); ++RunIdx) {
+        const Run& CurrRun = mRuns[RunIdx];
+        applyDepthState(mDraws[mPackets[CurrRun.First].Draw]);
+        if (CurrRun.MultiDrawProgram) {
+            drawMulti(CurrRun, CurrRun.MultiDrawProgram, true);
+            // The multi-draw program took over, single draws have to set theirs up again
+            Program = 0;
+            continue;
+        }
+        for (unsigned PacketIdx = CurrRun.First; PacketIdx < CurrRun.First + CurrRun.Count; ++PacketIdx) {
+            drawSingle(mPackets[PacketIdx], Program, Color);
+        }
+    }
+    GLState::SetCullFace(GL_BACK);
+    GLState::SetDepthFunc(GL_LESS);
+    GLState::SetDepthMask(true);
+}
+
+void
+RenderQueue::Record(CommandList& list, uint64_t inputs) {
+    radixSort();
+
+    list.BeginRecording(inputs);
+    for (unsigned PacketIdx = 0; PacketIdx < mPackets.size(); ++PacketIdx) {
+        const Packet& CurrPacket = mPackets[PacketIdx];
+        const DrawCall& Draw = mDraws[CurrPacket.Draw];
+        bool DepthTested = mDepthPrepass && depthProgram(Draw);
+        list.SetDepthState(DepthTested ? GL_EQUAL : GL_LESS, !DepthTested);
+        list.UseProgram(*Draw.Program);
+        list.SetColor(Draw.Color);
+        list.SetModel(Draw.Model);
+        list.SetCullFace(CurrPacket.Key & CULL_FRONT_BIT ? GL_FRONT : GL_BACK);
+        list.BindTexture(0, Draw.DiffuseTexture);
+        list.BindTexture(1, Draw.SpecularTexture);
+        list.BindVertexArray(Draw.VAO);
+        recordDraw(list, Draw);
+    }
+    list.SetDepthState(GL_LESS, true);
+    list.EndRecording();
+}
+
+void
+RenderQueue::RecordDepthPrepass(CommandList& list, uint64_t inputs) {
+    radixSort();
+
+    list.BeginRecording(inputs);
+    list.SetDepthState(GL_LESS, true);
+    for (unsigned PacketIdx = 0; PacketIdx < mPackets.size(); ++PacketIdx) {
+        const Packet& CurrPacket = mPackets[PacketIdx];
+        const DrawCall& Draw = mDraws[CurrPacket.Draw];
+        Shader* DepthProgram = depthProgram(Draw);
+        if (!DepthProgram) {
+            continue;
+        }
+        list.UseProgram(*DepthProgram);
+        list.SetModel(Draw.Model);
+        list.SetCullFace(CurrPacket.Key & CULL_FRONT_BIT ? GL_FRONT : GL_BACK);
+        list.BindVertexArray(Draw.VAO);
+        recordDraw(list, Draw);
+    }
+    list.EndRecording();
+}
+
+unsigned
+RenderQueue::GetPacketCount() const {
+    return mPackets.size();
+}
+
+unsigned
+RenderQueue::GetCulledCount() const {
+    return mCulled;
+}
+
+unsigned
+RenderQueue::GetDrawCallCount() const {
+    return mDrawCalls;
+}
+
+void
+RenderQueue::prepare() {
+    if (mPrepared) {
+        return;
+    }
+    cull();
+    radixSort();
+    buildRuns();
+    uploadFrameData();
+    mDrawCalls = 0;
+    mPrepared = true;
+}
+
+void
+RenderQueue::cull() {
+    if (!mCuller || mPackets.empty()) {
+        return;
+    }
+
+    unsigned Count = mPackets.size();
+    mCullBlocks.resize((Count + 3) / 4 * FrustumCuller::BLOCK_FLOATS);
+    mCullVisible.resize(Count);
+    for (unsigned PacketIdx = 0; PacketIdx < Count; ++PacketIdx) {
+        const glm::vec4& Sphere = mDraws[mPackets[PacketIdx].Draw].Sphere;
+        float* Lane = &mCullBlocks[PacketIdx / 4 * FrustumCuller::BLOCK_FLOATS + PacketIdx % 4];
+        Lane[0] = Sphere.x;
+        Lane[4] = Sphere.y;
+        Lane[8] = Sphere.z;
+        // Draws without bounds pass every plane
+        Lane[12] = Sphere.w > 0.0f ? Sphere.w : FLT_MAX;
+    }
+    mCuller->Cull(&mCullBlocks[0], Count, &mCullVisible[0]);
+
+    unsigned Kept = 0;
+    for (unsigned PacketIdx = 0; PacketIdx < Count; ++PacketIdx) {
+        if (mCullVisible[PacketIdx]) {
+            mPackets[Kept++] = mPackets[PacketIdx];
+        }
+    }
+    mCulled += Count - Kept;
+    mPackets.resize(Kept);
+}
+
+Shader*
+RenderQueue::depthProgram(const DrawCall& draw) const {
+    if (draw.Pass != PASS_OPAQUE) {
+        return 0;
+    }
+    auto It = mDepthPrograms.find(draw.Program);
+    return It != mDepthPrograms.end() ? It->second : 0;
+}
+
+void
+RenderQueue::applyDepthState(const DrawCall& draw) {
+    // Depth from the pre-pass is final, the main pass only shades the fragments that won
+    bool DepthTested = mDepthPrepass && depthProgram(draw);
+    GLState::SetDepthFunc(DepthTested ? GL_EQUAL : GL_LESS);
+    GLState::SetDepthMask(!DepthTested);
+}
+
+void
+RenderQueue::drawSingle(const Packet& packet, Shader*& program, glm::vec3& color) {
+    const DrawCall& Draw = mDraws[packet.Draw];
+
+    bool NewProgram = Draw.Program != program;
+    if (NewProgram) {
+        program = Draw.Program;
+        GLState::UseProgram(program->GetId());
+    }
+    if (NewProgram || Draw.Color != color) {
+        color = Draw.Color;
+        program->SetColor(color.x, color.y, color.z);
+    }
+    program->SetModel(Draw.Model);
+
+    GLState::SetCullFace(packet.Key & CULL_FRONT_BIT ? GL_FRONT : GL_BACK);
+    GLState::BindTexture(0, Draw.DiffuseTexture);
+    GLState::BindTexture(1, Draw.SpecularTexture);
+    GLState::BindVertexArray(Draw.VAO);
+    issueDraw(Draw);
+}
+
+void
+RenderQueue::issueDraw(const DrawCall& draw) {
+    mDrawCalls++;
+    if (draw.Indexed) {
+        void* Offset = (void*)(draw.FirstIndex * sizeof(unsigned));
+        if (draw.Instances > 1) {
+            glDrawElementsInstancedBaseVertex(GL_TRIANGLES, draw.Count, GL_UNSIGNED_INT, Offset, draw.Instances, draw.BaseVertex);
+        }
+        else {
+            glDrawElementsBaseVertex(GL_TRIANGLES, draw.Count, GL_UNSIGNED_INT, Offset, draw.BaseVertex);
+        }
+    }
+    else if (draw.Instances > 1) {
+        glDrawArraysInstanced(GL_TRIANGLES, draw.BaseVertex, draw.Count, draw.Instances);
+    }
+    else {
+        glDrawArrays(GL_TRIANGLES, draw.BaseVertex, draw.Count);
+    }
+}
+
+void
+RenderQueue::recordDraw(CommandList& list, const DrawCall& draw) {
+    if (draw.Indexed) {
+        list.DrawElements(draw.Count, draw.FirstIndex, draw.BaseVertex, draw.Instances);
+    }
+    else {
+        list.DrawArrays(draw.BaseVertex, draw.Count, draw.Instances);
+    }
+}
+
+void
+RenderQueue::drawMulti(const Run& run, Shader* program, bool bindMaterial) {
+    const Packet& FirstPacket = mPackets[run.First];
+    const DrawCall& Draw = mDraws[FirstPacket.Draw];
+
+    GLState::UseProgram(program->GetId());
+    GLState::SetCullFace(FirstPacket.Key & CULL_FRONT_BIT ? GL_FRONT : GL_BACK);
+    if (bindMaterial) {
+        GLState::BindTexture(0, Draw.DiffuseTexture);
+        GLState::BindTexture(1, Draw.SpecularTexture);
+    }
+    GLState::BindTexture(DRAW_DATA_UNIT, mDrawDataTexture, GL_TEXTURE_BUFFER);
+    GLState::BindVertexArray(Draw.VAO);
+
+    if (mIndirect) {
+        attachDrawId(Draw.VAO);
+        GLState::BindBuffer(GL_DRAW_INDIRECT_BUFFER, mCommandBuffer);
+        glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, (void*)(mCommandOffset + run.Command * sizeof(DrawElementsIndirectCommand)), run.Count, 0);
+        mDrawCalls++;
+        return;
+    }
+
+    // The draw id attribute is never enabled on this path, so its constant value is what the shader reads
+    for (unsigned CommandIdx = run.Command; CommandIdx < run.Command + run.Count; ++CommandIdx) {
+        const DrawElementsIndirectCommand& Command = mCommands[CommandIdx];
+        glVertexAttribI1ui(DRAW_ID_LOCATION, Command.BaseInstance);
+        glDrawElementsBaseVertex(GL_TRIANGLES, Command.Count, GL_UNSIGNED_INT, (void*)(Command.FirstIndex * sizeof(unsigned)), Command.BaseVertex);
+        mDrawCalls++;
+    }
+}
+
+void
+RenderQueue::attachDrawId(unsigned vao) {
+    if (mDrawIdVAOs.count(vao)) {
+        return;
+    }
+    // Called with vao bound, the attribute becomes part of its state
+    GLState::BindBuffer(GL_ARRAY_BUFFER, mDrawIdBuffer);
+    glVertexAttribIPointer(DRAW_ID_LOCATION, 1, GL_UNSIGNED_INT, sizeof(GLuint), (void*)0);
+    glEnableVertexAttribArray(DRAW_ID_LOCATION);
+    glVertexAttribDivisor(DRAW_ID_LOCATION, 1);
+    mDrawIdVAOs.insert(vao);
+}
+
+void
+RenderQueue::buildRuns() {
+    mRuns.clear();
+    mCommands.clear();
+    mDrawData.clear();
+
+    unsigned First = 0;
+    while (First < mPackets.size()) {
+        const Packet& FirstPacket = mPackets[First];
+        const DrawCall& FirstDraw = mDraws[FirstPacket.Draw];
+        auto MultiDraw = mMultiDrawPrograms.find(FirstDraw.Program);
+        bool Batchable = MultiDraw != mMultiDrawPrograms.end() && FirstDraw.Indexed && FirstDraw.Instances == 1;
+
+        // Everything above the depth bits matches, so the packets only differ in transform and color
+        unsigned Last = First + 1;
+        while (Batchable && Last < mPackets.size()) {
+            const Packet& CurrPacket = mPackets[Last];
+            const DrawCall& CurrDraw = mDraws[CurrPacket.Draw];
+            if ((CurrPacket.Key >> VAO_SHIFT) != (FirstPacket.Key >> VAO_SHIFT) || CurrDraw.Program != FirstDraw.Program
+                || CurrDraw.VAO != FirstDraw.VAO || !CurrDraw.Indexed || CurrDraw.Instances != 1) {
+                break;
+            }
+            Last++;
+        }
+
+        Run NewRun;
+        NewRun.First = First;
+        NewRun.Count = Last - First;
+        NewRun.MultiDrawProgram = 0;
+        NewRun.Command = mCommands.size();
+        if (NewRun.Count > 1) {
+            NewRun.MultiDrawProgram = MultiDraw->second;
+            for (unsigned PacketIdx = First; PacketIdx < Last; ++PacketIdx) {
+                const DrawCall& Draw = mDraws[mPackets[PacketIdx].Draw];
+                DrawElementsIndirectCommand Command;
+                Command.Count = Draw.Count;
+                Command.InstanceCount = 1;
+                Command.FirstIndex = Draw.FirstIndex;
+                Command.BaseVertex = Draw.BaseVertex;
+                Command.BaseInstance = mDrawData.size() / DRAW_RECORD_TEXELS;
+                mCommands.push_back(Command);
+
+                mDrawData.push_back(Draw.Model[0]);
+                mDrawData.push_back(Draw.Model[1]);
+                mDrawData.push_back(Draw.Model[2]);
+                mDrawData.push_back(Draw.Model[3]);
+                mDrawData.push_back(glm::vec4(Draw.Color, 1.0f));
+            }
+        }
+        mRuns.push_back(NewRun);
+        First = Last;
+    }
+}
+
+void
+RenderQueue::uploadFrameData() {
+    if (mCommands.empty()) {
+        return;
+    }
+
+    const unsigned DrawDataSize = mDrawData.size() * sizeof(glm::vec4);
+    FrameRing::Allocation DrawDataRange = { 0, 0, 0 };
+    if (mRing && mTextureBufferRange) {
+        DrawDataRange = mRing->Allocate(DrawDataSize, mTextureBufferAlignment);
+    }
+    if (DrawDataRange.Data) {
+        memcpy(DrawDataRange.Data, mDrawData.data(), DrawDataSize);
+        GLState::BindTexture(DRAW_DATA_UNIT, mDrawDataTexture, GL_TEXTURE_BUFFER);
+        glTexBufferRange(GL_TEXTURE_BUFFER, GL_RGBA32F, mRing->GetId(), DrawDataRange.Offset, DrawDataSize);
+        mDrawDataInRing = true;
+    }
+    else {
+        GLState::BindBuffer(GL_TEXTURE_BUFFER, mDrawDataBuffer);
+        glBufferData(GL_TEXTURE_BUFFER, DrawDataSize, mDrawData.data(), GL_STREAM_DRAW);
+        if (mDrawDataInRing) {
+            GLState::BindTexture(DRAW_DATA_UNIT, mDrawDataTexture, GL_TEXTURE_BUFFER);
+            glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, mDrawDataBuffer);
+            mDrawDataInRing = false;
+        }
+    }
+    if (!mIndirect) {
+        if (mRing) {
+            mRing->Flush();
+        }
+        return;
+    }
+
+    const unsigned CommandsSize = mCommands.size() * sizeof(DrawElementsIndirectCommand);
+    FrameRing::Allocation CommandRange = { 0, 0, 0 };
+    if (mRing) {
+        CommandRange = mRing->Allocate(CommandsSize, sizeof(GLuint));
+    }
+    if (CommandRange.Data) {
+        memcpy(CommandRange.Data, mCommands.data(), CommandsSize);
+        mCommandBuffer = mRing->GetId();
+        mCommandOffset = CommandRange.Offset;
+    }
+    else {
+        GLState::BindBuffer(GL_DRAW_INDIRECT_BUFFER, mIndirectBuffer);
+        glBufferData(GL_DRAW_INDIRECT_BUFFER, CommandsSize, mCommands.data(), GL_STREAM_DRAW);
+        mCommandBuffer = mIndirectBuffer;
+        mCommandOffset = 0;
+    }
+    if (mRing) {
+        mRing->Flush();
+    }
+
+    if (mCommands.size() > mDrawIdCapacity) {
+        mDrawIdCapacity = std::max<unsigned>(mCommands.size(), 2 * mDrawIdCapacity);
+        std::vector<GLuint> DrawIds(mDrawIdCapacity);
+        for (unsigned DrawId = 0; DrawId < mDrawIdCapacity; ++DrawId) {
+            DrawIds[DrawId] = DrawId;
+        }
+        GLState::BindBuffer(GL_ARRAY_BUFFER, mDrawIdBuffer);
+        glBufferData(GL_ARRAY_BUFFER, DrawIds.size() * sizeof(GLuint), DrawIds.data(), GL_STATIC_DRAW);
+    }
+}
+
+uint64_t
+RenderQueue::makeKey(const DrawCall& draw) {
+    float Distance = glm::length(glm::vec3(draw.Model[3]) - mCameraPosition) / mMaxDistance;
+    uint64_t Depth = (uint64_t)(glm::clamp(Distance, 0.0f, 1.0f) * DEPTH_MASK);
+    // Transparent draws blend over what is behind them, so they go back to front
+    if (draw.Pass == PASS_TRANSPARENT) {
+        Depth = DEPTH_MASK - Depth;
+    }
+
+    // A mirroring transform flips the winding, its back faces are the front ones
+    bool CullFront = glm::determinant(glm::mat3(draw.Model)) < 0.0f;
+
+    return (uint64_t)draw.Pass << PASS_SHIFT
+        | (programIndex(draw.Program) & PROGRAM_MASK) << PROGRAM_SHIFT
+        | (CullFront ? CULL_FRONT_BIT : 0)
+        | (materialIndex(draw.DiffuseTexture, draw.SpecularTexture) & MATERIAL_MASK) << MATERIAL_SHIFT
+        | (draw.VAO & VAO_MASK) << VAO_SHIFT
+        | Depth;
+}
+
+unsigned
+RenderQueue::programIndex(Shader* program) {
+    for (unsigned ProgramIdx = 0; ProgramIdx < mPrograms.size(); ++ProgramIdx) {
+        if (mPrograms[ProgramIdx] == program) {
+            return ProgramIdx;
+        }
+    }
+    mPrograms.push_back(program);
+    return mPrograms.size() - 1;
+}
+
+unsigned
+RenderQueue::materialIndex(unsigned diffuse, unsigned specular) {
+    std::pair<unsigned, unsigned> Material(diffuse, specular);
+    auto It = mMaterials.find(Material);
+    if (It == mMaterials.end()) {
+        It = mMaterials.insert(std::make_pair(Material, (unsigned)mMaterials.size())).first;
+    }
+    return It->second;
+}
+
+void
+RenderQueue::radixSort() {
+    if (mPackets.empty()) {
+        return;
+    }
+
+    // LSD radix sort on 8-bit digits, stable so equal keys keep their submission order
+    mScratch.resize(mPackets.size());
+    for (unsigned Shift = 0; Shift < 64; Shift += 8) {
+        unsigned Counts[256] = { 0 };
+        for (unsigned PacketIdx = 0; PacketIdx < mPackets.size(); ++PacketIdx) {
+            Counts[(mPackets[PacketIdx].Key >> Shift) & 0xFF]++;
+        }
+        // Every key has the same digit, nothing to reorder in this pass
+        if (Counts[(mPackets[0].Key >> Shift) & 0xFF] == mPackets.size()) {
+            continue;
+        }
+
+        unsigned Offset = 0;
+        for (unsigned Digit = 0; Digit < 256; ++Digit) {
+            unsigned Count = Counts[Digit];
+            Counts[Digit] = Offset;
+            Offset += Count;
+        }
+        for (unsigned PacketIdx = 0; PacketIdx < mPackets.size(); ++PacketIdx) {
+            const Packet& CurrPacket = mPackets[PacketIdx];
+            mScratch[Counts[(CurrPacket.Key >> Shift) & 0xFF]++] = CurrPacket;
+        }
+        mPackets.swap(mScratch);
+    }
+}
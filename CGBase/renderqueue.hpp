@@ -0,0 +1,222 @@
+/**
+ * @file renderqueue.hpp
+ * @brief Per-frame list of draw packets. Each packet carries a 64-bit sort key, the packets
+ * are radix sorted once per frame and issued in key order, so draws sharing a program,
+ * material and VAO end up next to each other.
+ *
+ */
+
+#pragma once
+#include <vector>
+#include <map>
+#include <set>
+#include <cstdint>
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+#include "shader.hpp"
+#include "glstate.hpp"
+#include "framering.hpp"
+#include "commandlist.hpp"
+#include "frustumculler.hpp"
+
+class RenderQueue {
+public:
+    // Per-draw record index for multi-draw programs, see shaders/phong_multidraw.vert
+    static const unsigned DRAW_ID_LOCATION = 9;
+    // Texture unit of the per-draw record buffer
+    static const unsigned DRAW_DATA_UNIT = 2;
+
+    enum EPass {
+        PASS_OPAQUE = 0,
+        PASS_TRANSPARENT,
+        PASS_COUNT,
+    };
+
+    struct DrawCall {
+        EPass Pass;
+        Shader* Program;
+        unsigned VAO;
+        // Index count for indexed draws, vertex count otherwise
+        unsigned Count;
+        bool Indexed;
+        // Offset into the bound index and vertex buffers, for geometry sharing one VAO
+        unsigned FirstIndex;
+        int BaseVertex;
+        unsigned Instances;
+        // 0 uses the queue's default texture
+        unsigned DiffuseTexture;
+        unsigned SpecularTexture;
+        glm::mat4 Model;
+        glm::vec3 Color;
+        // World-space bounding sphere, xyz center and w radius. Radius 0 is never culled.
+        glm::vec4 Sphere;
+    };
+
+    /**
+     * @brief Draws gathered away from the queue, so a job on another thread can fill its own
+     * list while the queue is busy. Clear keeps the storage, a list reused every frame stops allocating.
+     */
+    class DrawList {
+    public:
+        void Clear();
+        void Submit(const DrawCall& draw);
+        unsigned GetCount() const;
+
+    private:
+        friend class RenderQueue;
+        std::vector<DrawCall> mDraws;
+    };
+
+    RenderQueue();
+    ~RenderQueue();
+
+    /**
+     * @brief Textures bound for draws that have none of their own, such as model meshes
+     * without a map_Kd or map_Ks
+     */
+    void SetDefaultTextures(unsigned diffuse, unsigned specular);
+    /**
+     * @brief Drops last frame's packets. Depth in the sort key is the distance from
+     * cameraPosition, draws further than maxDistance share the last depth bucket.
+     */
+    void Begin(const glm::vec3& cameraPosition, float maxDistance);
+    void Submit(const DrawCall& draw);
+    // Submits every draw of list in list order, called on the queue's thread
+    void Submit(const DrawList& list);
+    /**
+     * @brief Lets consecutive packets of program that share material and VAO go out as a
+     * single multi-draw. multiDrawProgram replaces program for them; it reads model and
+     * color from the per-draw record buffer instead of uModel and uCol.
+     *
+     * Uses glMultiDrawElementsIndirect with GL 4.3 or ARB_multi_draw_indirect, and a
+     * glDrawElementsBaseVertex loop that passes the record index as a constant attribute otherwise.
+     */
+    void EnableMultiDraw(Shader& program, Shader& multiDrawProgram);
+    /**
+     * @brief Writes the indirect commands and per-draw records into ring instead of the
+     * queue's own buffers. Records need GL 4.3 or ARB_texture_buffer_range to be read from a range.
+     */
+    void SetFrameRing(FrameRing* ring);
+    /**
+     * @brief Position-only stand-in for program in the depth pre-pass. It has to compute
+     * gl_Position exactly like program does (same expression, invariant), the main pass tests GL_EQUAL.
+     * Multi-draw programs need their own depth program.
+     */
+    void SetDepthProgram(Shader& program, Shader& depthProgram);
+    /**
+     * @brief With the pre-pass on, opaque draws whose program has a depth program are drawn
+     * with GL_EQUAL and depth writes off after ExecuteDepthPrepass laid down their depth.
+     * Everything else keeps GL_LESS with writes.
+     */
+    void SetDepthPrepass(bool enabled);
+    /**
+     * @brief Drops packets whose sphere lies outside culler's frustum before they are sorted,
+     * 0 turns culling off. Leave it off for queues that get recorded, a recording is replayed
+     * whatever the camera looks at.
+     */
+    void SetCuller(const FrustumCuller* culler);
+    /**
+     * @brief Sorts the packets and draws depth for every opaque packet that has a depth program.
+     * Color writes have to be masked by the caller. Does nothing with the pre-pass off.
+     */
+    void ExecuteDepthPrepass();
+    /**
+     * @brief Sorts the packets and issues them. Per-frame uniforms (view, projection, ...)
+     * have to be set on every program beforehand, the queue sets only uModel and uCol.
+     */
+    void Execute();
+    /**
+     * @brief Sorts the packets and records them into list instead of issuing them. Packets
+     * are recorded as single draws, the multi-draw path needs per-frame buffers a recording cannot keep.
+     */
+    void Record(CommandList& list, uint64_t inputs);
+    // ExecuteDepthPrepass, recorded into list
+    void RecordDepthPrepass(CommandList& list, uint64_t inputs);
+    // Packets submitted this frame, minus the culled ones once the queue executed
+    unsigned GetPacketCount() const;
+    unsigned GetCulledCount() const;
+    // GL draw calls issued by the last ExecuteDepthPrepass and Execute
+    unsigned GetDrawCallCount() const;
+
+private:
+    struct Packet {
+        uint64_t Key;
+        unsigned Draw;
+    };
+
+    // Layout fixed by GL for glMultiDrawElementsIndirect
+    struct DrawElementsIndirectCommand {
+        GLuint Count;
+        GLuint InstanceCount;
+        GLuint FirstIndex;
+        GLint BaseVertex;
+        GLuint BaseInstance;
+    };
+
+    // Sorted packets [First, First + Count) drawn together, MultiDrawProgram is 0 for single draws
+    struct Run {
+        unsigned First;
+        unsigned Count;
+        Shader* MultiDrawProgram;
+        unsigned Command;
+    };
+
+    std::vector<DrawCall> mDraws;
+    std::vector<Packet> mPackets;
+    std::vector<Packet> mScratch;
+    // Programs and materials get small stable ids the first time they are seen
+    std::vector<Shader*> mPrograms;
+    std::map<std::pair<unsigned, unsigned>, unsigned> mMaterials;
+    glm::vec3 mCameraPosition;
+    float mMaxDistance;
+    unsigned mDefaultDiffuse;
+    unsigned mDefaultSpecular;
+
+    std::map<Shader*, Shader*> mMultiDrawPrograms;
+    std::vector<Run> mRuns;
+    std::vector<DrawElementsIndirectCommand> mCommands;
+    // Model matrix columns and color of every multi-drawn packet, DRAW_RECORD_TEXELS per record
+    std::vector<glm::vec4> mDrawData;
+    unsigned mDrawDataBuffer;
+    unsigned mDrawDataTexture;
+    unsigned mIndirectBuffer;
+    FrameRing* mRing;
+    bool mTextureBufferRange;
+    unsigned mTextureBufferAlignment;
+    // Where this frame's commands were written
+    unsigned mCommandBuffer;
+    unsigned mCommandOffset;
+    // Whether the record texture currently points into the ring
+    bool mDrawDataInRing;
+    // 0, 1, 2, ... read with divisor 1, so the command's base instance becomes the record index
+    unsigned mDrawIdBuffer;
+    unsigned mDrawIdCapacity;
+    std::set<unsigned> mDrawIdVAOs;
+    bool mIndirect;
+    unsigned mDrawCalls;
+    std::map<Shader*, Shader*> mDepthPrograms;
+    bool mDepthPrepass;
+    // Packets sorted and frame data uploaded, shared by the pre-pass and the main pass
+    bool mPrepared;
+    const FrustumCuller* mCuller;
+    // Packet spheres in the culler's blocks of four and the verdict for each packet
+    std::vector<float> mCullBlocks;
+    std::vector<unsigned char> mCullVisible;
+    unsigned mCulled;
+
+    uint64_t makeKey(const DrawCall& draw);
+    unsigned programIndex(Shader* program);
+    unsigned materialIndex(unsigned diffuse, unsigned specular);
+    void cull();
+    void radixSort();
+    void buildRuns();
+    void uploadFrameData();
+    void prepare();
+    Shader* depthProgram(const DrawCall& draw) const;
+    void applyDepthState(const DrawCall& draw);
+    void drawSingle(const Packet& packet, Shader*& program, glm::vec3& color);
+    void drawMulti(const Run& run, Shader* program, bool bindMaterial);
+    void issueDraw(const DrawCall& draw);
+    void recordDraw(CommandList& list, const DrawCall& draw);
+    void attachDrawId(unsigned vao);
+};
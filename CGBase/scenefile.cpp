@@ -0,0 +1,670 @@
+#include "scenefile.hpp"
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <map>
+#include <cstring>
+#include <ctime>
+#include <sys/stat.h>
+#include <glm/gtc/quaternion.hpp>
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+// Records and the string table as they come out of the text, before they are packed into one image
+struct SceneBuilder {
+    std::vector<SceneFile::Texture> Textures;
+    std::vector<SceneFile::Mesh> Meshes;
+    std::vector<SceneFile::Material> Materials;
+    std::vector<SceneFile::Node> Nodes;
+    std::vector<SceneFile::Draw> Draws;
+    std::vector<SceneFile::Light> Lights;
+    std::vector<SceneFile::Animator> Animators;
+    std::vector<SceneFile::Prefab> Prefabs;
+    std::vector<SceneFile::Part> Parts;
+    std::vector<SceneFile::Instance> Instances;
+    std::string Strings;
+    std::map<std::string, uint32_t> StringOffsets;
+    std::map<std::string, uint32_t> TextureIds;
+    std::map<std::string, uint32_t> MeshIds;
+    std::map<std::string, uint32_t> MaterialIds;
+    std::map<std::string, uint32_t> NodeIds;
+    std::map<std::string, uint32_t> PrefabIds;
+    std::map<std::string, uint32_t> InstanceIds;
+
+    uint32_t AddString(const std::string& value) {
+        std::map<std::string, uint32_t>::const_iterator Found = StringOffsets.find(value);
+        if (Found != StringOffsets.end()) {
+            return Found->second;
+        }
+        uint32_t Offset = Strings.size();
+        Strings.append(value);
+        Strings.push_back('\0');
+        StringOffsets[value] = Offset;
+        return Offset;
+    }
+};
+
+static std::time_t
+modificationTime(const std::string& path) {
+    struct stat Info;
+    return stat(path.c_str(), &Info) == 0 ? Info.st_mtime : 0;
+}
+
+static std::string
+binaryPath(const std::string& path) {
+    std::string::size_type Dot = path.find_last_of('.');
+    std::string::size_type Slash = path.find_last_of("/\\");
+    if (Dot == std::string::npos || (Slash != std::string::npos && Dot < Slash)) {
+        return path + ".bin";
+    }
+    return path.substr(0, Dot) + ".bin";
+}
+
+static bool
+readVec3(std::istringstream& line, glm::vec3& value) {
+    return (bool)(line >> value.x >> value.y >> value.z);
+}
+
+// <x y z> <axis x y z> <degrees> <sx sy sz>, the rotation comes out as x, y, z, w
+static bool
+readTransform(std::istringstream& line, glm::vec3& position, glm::vec4& rotation, glm::vec3& scale) {
+    glm::vec3 Axis;
+    float Degrees;
+    if (!readVec3(line, position) || !readVec3(line, Axis) || !(line >> Degrees) || !readVec3(line, scale)) {
+        return false;
+    }
+    glm::quat Rotation(1.0f, 0.0f, 0.0f, 0.0f);
+    if (Degrees != 0.0f && glm::length(Axis) > 0.0f) {
+        Rotation = glm::angleAxis(glm::radians(Degrees), glm::normalize(Axis));
+    }
+    rotation = glm::vec4(Rotation.x, Rotation.y, Rotation.z, Rotation.w);
+    return true;
+}
+
+// Index into a section of count records, NONE only where the field is optional
+static bool
+inRange(uint32_t index, unsigned count, bool optional) {
+    return index < count || (optional && index == SceneFile::NONE);
+}
+
+// Looks a name up in one of the builder's maps, '-' is accepted as NONE when optional
+static bool
+resolve(const std::map<std::string, uint32_t>& ids, const std::string& name, bool optional, uint32_t& id) {
+    if (optional && name == "-") {
+        id = SceneFile::NONE;
+        return true;
+    }
+    std::map<std::string, uint32_t>::const_iterator Found = ids.find(name);
+    if (Found == ids.end()) {
+        return false;
+    }
+    id = Found->second;
+    return true;
+}
+
+// Parses one record into builder, returns an error message or an empty string
+static std::string
+parseRecord(const std::string& kind, std::istringstream& line, SceneBuilder& builder) {
+    std::string Name;
+    if (kind == "texture") {
+        std::string Path;
+        std::string Filter;
+        if (!(line >> Name >> Path)) {
+            return "expected texture <name> <path> [linear]";
+        }
+        line >> Filter;
+        SceneFile::Texture Record = { builder.AddString(Name), builder.AddString(Path), Filter == "linear" };
+        builder.TextureIds[Name] = builder.Textures.size();
+        builder.Textures.push_back(Record);
+        return "";
+    }
+
+    if (kind == "primitive" || kind == "model") {
+        std::string Path;
+        if (!(line >> Name) || (kind == "model" && !(line >> Path))) {
+            return "expected primitive <name> or model <name> <path>";
+        }
+        SceneFile::Mesh Record = { builder.AddString(Name), kind == "model" ? SceneFile::MESH_MODEL : SceneFile::MESH_PRIMITIVE,
+            kind == "model" ? builder.AddString(Path) : SceneFile::NONE };
+        builder.MeshIds[Name] = builder.Meshes.size();
+        builder.Meshes.push_back(Record);
+        return "";
+    }
+
+    if (kind == "material") {
+        std::string Shader;
+        std::string Diffuse;
+        std::string Specular;
+        SceneFile::Material Record;
+        if (!(line >> Name >> Shader >> Diffuse >> Specular) || !readVec3(line, Record.Color)) {
+            return "expected material <name> <shader> <diffuse> <specular> <r g b>";
+        }
+        if (!resolve(builder.TextureIds, Diffuse, true, Record.Diffuse) || !resolve(builder.TextureIds, Specular, true, Record.Specular)) {
+            return "unknown texture";
+        }
+        Record.Name = builder.AddString(Name);
+        Record.Shader = builder.AddString(Shader);
+        builder.MaterialIds[Name] = builder.Materials.size();
+        builder.Materials.push_back(Record);
+        return "";
+    }
+
+    if (kind == "node" || kind == "static") {
+        std::string Parent;
+        SceneFile::Node Record;
+        if (!(line >> Name >> Parent) || !readTransform(line, Record.Position, Record.Rotation, Record.Scale)) {
+            return "expected " + kind + " <name> <parent> <x y z> <axis x y z> <degrees> <sx sy sz>";
+        }
+        if (builder.NodeIds.count(Name)) {
+            return "node " + Name + " declared twice";
+        }
+        if (!resolve(builder.NodeIds, Parent, true, Record.Parent)) {
+            return "unknown parent " + Parent + ", parents have to be declared first";
+        }
+        Record.Static = kind == "static";
+        if (Record.Parent != SceneFile::NONE && builder.Nodes[Record.Parent].Static != Record.Static) {
+            return "static and moving nodes can not be mixed, " + Name + " is under " + Parent;
+        }
+        Record.Name = builder.AddString(Name);
+        builder.NodeIds[Name] = builder.Nodes.size();
+        builder.Nodes.push_back(Record);
+        return "";
+    }
+
+    if (kind == "draw") {
+        std::string Mesh;
+        std::string Material;
+        SceneFile::Draw Record;
+        if (!(line >> Name >> Mesh >> Material)) {
+            return "expected draw <node> <mesh> <material>";
+        }
+        if (!resolve(builder.NodeIds, Name, false, Record.Node) || !resolve(builder.MeshIds, Mesh, false, Record.Mesh)
+            || !resolve(builder.MaterialIds, Material, false, Record.Material)) {
+            return "unknown node, mesh or material";
+        }
+        if (builder.Nodes[Record.Node].Static && builder.Meshes[Record.Mesh].Type != SceneFile::MESH_PRIMITIVE) {
+            return "only primitives can be baked, " + Mesh + " is on static node " + Name;
+        }
+        builder.Draws.push_back(Record);
+        return "";
+    }
+
+    if (kind == "directional" || kind == "point" || kind == "spot") {
+        SceneFile::Light Record = SceneFile::Light();
+        bool Read = (bool)(line >> Name);
+        if (kind == "directional") {
+            Record.Type = SceneFile::LIGHT_DIRECTIONAL;
+            Read = Read && readVec3(line, Record.Direction);
+        }
+        else {
+            Record.Type = kind == "point" ? SceneFile::LIGHT_POINT : SceneFile::LIGHT_SPOT;
+            Read = Read && readVec3(line, Record.Position);
+            if (kind == "spot") {
+                Read = Read && readVec3(line, Record.Direction);
+            }
+            Read = Read && (line >> Record.Attenuation.x >> Record.Attenuation.y >> Record.Attenuation.z);
+            if (kind == "point") {
+                Read = Read && (line >> Record.Attenuation.w);
+            }
+            else {
+                float Inner;
+                float Outer;
+                Read = Read && (line >> Inner >> Outer);
+                Record.CutOff = glm::vec2(glm::cos(glm::radians(Inner)), glm::cos(glm::radians(Outer)));
+            }
+        }
+        Read = Read && readVec3(line, Record.Ka) && readVec3(line, Record.Kd) && readVec3(line, Record.Ks);
+        if (!Read) {
+            return "malformed " + kind + " light";
+        }
+        Record.Name = builder.AddString(Name);
+        builder.Lights.push_back(Record);
+        return "";
+    }
+
+    if (kind == "spin" || kind == "bob") {
+        SceneFile::Animator Record;
+        Record.Type = kind == "spin" ? SceneFile::ANIMATOR_SPIN : SceneFile::ANIMATOR_BOB;
+        Record.Amplitude = 0.0f;
+        Record.Phase = 0.0f;
+        bool Read = (line >> Name) && readVec3(line, Record.Axis);
+        if (kind == "spin") {
+            Read = Read && (line >> Record.Speed);
+        }
+        else {
+            Read = Read && (line >> Record.Amplitude >> Record.Speed >> Record.Phase);
+        }
+        if (!Read || glm::length(Record.Axis) == 0.0f) {
+            return "malformed " + kind + " animator";
+        }
+        if (!resolve(builder.NodeIds, Name, false, Record.Node)) {
+            return "unknown node " + Name;
+        }
+        if (builder.Nodes[Record.Node].Static) {
+            return "static node " + Name + " can not be animated";
+        }
+        Record.Axis = glm::normalize(Record.Axis);
+        builder.Animators.push_back(Record);
+        return "";
+    }
+
+    if (kind == "prefab") {
+        if (!(line >> Name)) {
+            return "expected prefab <name>";
+        }
+        if (builder.PrefabIds.count(Name)) {
+            return "prefab " + Name + " declared twice";
+        }
+        SceneFile::Prefab Record = { builder.AddString(Name) };
+        builder.PrefabIds[Name] = builder.Prefabs.size();
+        builder.Prefabs.push_back(Record);
+        return "";
+    }
+
+    if (kind == "part") {
+        std::string Mesh;
+        std::string Material;
+        SceneFile::Part Record;
+        if (!(line >> Name >> Mesh >> Material) || !readTransform(line, Record.Position, Record.Rotation, Record.Scale)) {
+            return "expected part <prefab> <primitive> <material> <x y z> <axis x y z> <degrees> <sx sy sz>";
+        }
+        if (!resolve(builder.PrefabIds, Name, false, Record.Prefab) || !resolve(builder.MeshIds, Mesh, false, Record.Mesh)
+            || !resolve(builder.MaterialIds, Material, false, Record.Material)) {
+            return "unknown prefab, mesh or material";
+        }
+        if (builder.Meshes[Record.Mesh].Type != SceneFile::MESH_PRIMITIVE) {
+            return "only primitives can be prefab parts, " + Mesh + " is in " + Name;
+        }
+        builder.Parts.push_back(Record);
+        return "";
+    }
+
+    if (kind == "instance") {
+        std::string Prefab;
+        SceneFile::Instance Record;
+        if (!(line >> Name >> Prefab) || !readTransform(line, Record.Position, Record.Rotation, Record.Scale)) {
+            return "expected instance <name> <prefab> <x y z> <axis x y z> <degrees> <sx sy sz>";
+        }
+        if (builder.InstanceIds.count(Name)) {
+            return "instance " + Name + " declared twice";
+        }
+        if (!resolve(builder.PrefabIds, Prefab, false, Record.Prefab)) {
+            return "unknown prefab " + Prefab;
+        }
+        Record.Name = builder.AddString(Name);
+        builder.InstanceIds[Name] = builder.Instances.size();
+        builder.Instances.push_back(Record);
+        return "";
+    }
+
+    return "unknown record " + kind;
+}
+
+template<typename T>
+static void
+packSection(std::vector<char>& image, uint32_t& offset, uint32_t& count, const std::vector<T>& records) {
+    offset = image.size();
+    count = records.size();
+    image.resize(image.size() + records.size() * sizeof(T));
+    if (!records.empty()) {
+        std::memcpy(&image[offset], &records[0], records.size() * sizeof(T));
+    }
+}
+
+SceneFile::SceneFile() {
+    mData = 0;
+    mSize = 0;
+    mMapping = 0;
+    mFile = 0;
+}
+
+SceneFile::~SceneFile() {
+    Unload();
+}
+
+bool
+SceneFile::Load(const std::string& path) {
+    std::string BinaryPath = binaryPath(path);
+    std::time_t BinaryTime = modificationTime(BinaryPath);
+    if (BinaryTime && BinaryTime >= modificationTime(path) && LoadBinary(BinaryPath)) {
+        return true;
+    }
+
+    if (!LoadText(path)) {
+        return false;
+    }
+    if (!WriteBinary(BinaryPath)) {
+        std::cerr << "[Err] Failed to write compiled scene " << BinaryPath << std::endl;
+    }
+    return true;
+}
+
+bool
+SceneFile::LoadText(const std::string& path) {
+    Unload();
+    std::ifstream In(path);
+    if (!In) {
+        std::cerr << "[Err] Failed to open scene " << path << std::endl;
+        return false;
+    }
+
+    SceneBuilder Builder;
+    std::string Text;
+    unsigned LineNumber = 0;
+    while (std::getline(In, Text)) {
+        LineNumber++;
+        std::string::size_type Comment = Text.find('#');
+        if (Comment != std::string::npos) {
+            Text.erase(Comment);
+        }
+        std::istringstream Line(Text);
+        std::string Kind;
+        if (!(Line >> Kind)) {
+            continue;
+        }
+        std::string Error = parseRecord(Kind, Line, Builder);
+        if (!Error.empty()) {
+            std::cerr << "[Err] " << path << ":" << LineNumber << ": " << Error << std::endl;
+            return false;
+        }
+    }
+
+    // Every record is made of 4 byte fields, sections stay aligned as long as strings come last
+    mImage.assign(sizeof(Header), 0);
+    Header FileHeader;
+    std::memset(&FileHeader, 0, sizeof(FileHeader));
+    FileHeader.Magic = MAGIC;
+    FileHeader.Version = VERSION;
+    Section* Sections = FileHeader.Sections;
+    packSection(mImage, Sections[SECTION_TEXTURES].Offset, Sections[SECTION_TEXTURES].Count, Builder.Textures);
+    packSection(mImage, Sections[SECTION_MESHES].Offset, Sections[SECTION_MESHES].Count, Builder.Meshes);
+    packSection(mImage, Sections[SECTION_MATERIALS].Offset, Sections[SECTION_MATERIALS].Count, Builder.Materials);
+    packSection(mImage, Sections[SECTION_NODES].Offset, Sections[SECTION_NODES].Count, Builder.Nodes);
+    packSection(mImage, Sections[SECTION_DRAWS].Offset, Sections[SECTION_DRAWS].Count, Builder.Draws);
+    packSection(mImage, Sections[SECTION_LIGHTS].Offset, Sections[SECTION_LIGHTS].Count, Builder.Lights);
+    packSection(mImage, Sections[SECTION_ANIMATORS].Offset, Sections[SECTION_ANIMATORS].Count, Builder.Animators);
+    packSection(mImage, Sections[SECTION_PREFABS].Offset, Sections[SECTION_PREFABS].Count, Builder.Prefabs);
+    packSection(mImage, Sections[SECTION_PARTS].Offset, Sections[SECTION_PARTS].Count, Builder.Parts);
+    packSection(mImage, Sections[SECTION_INSTANCES].Offset, Sections[SECTION_INSTANCES].Count, Builder.Instances);
+    packSection(mImage, Sections[SECTION_STRINGS].Offset, Sections[SECTION_STRINGS].Count, std::vector<char>(Builder.Strings.begin(), Builder.Strings.end()));
+    FileHeader.Size = mImage.size();
+    std::memcpy(&mImage[0], &FileHeader, sizeof(FileHeader));
+
+    mData = &mImage[0];
+    mSize = mImage.size();
+    return true;
+}
+
+bool
+SceneFile::LoadBinary(const std::string& path) {
+    Unload();
+#ifdef _WIN32
+    HANDLE File = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, 0, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, 0);
+    if (File == INVALID_HANDLE_VALUE) {
+        std::cerr << "[Err] Failed to open compiled scene " << path << std::endl;
+        return false;
+    }
+    LARGE_INTEGER FileSize;
+    HANDLE Mapping = 0;
+    if (GetFileSizeEx(File, &FileSize) && FileSize.QuadPart >= (LONGLONG)sizeof(Header)) {
+        Mapping = CreateFileMappingA(File, 0, PAGE_READONLY, 0, 0, 0);
+    }
+    const void* View = Mapping ? MapViewOfFile(Mapping, FILE_MAP_READ, 0, 0, 0) : 0;
+    if (!View) {
+        std::cerr << "[Err] Failed to map compiled scene " << path << std::endl;
+        if (Mapping) {
+            CloseHandle(Mapping);
+        }
+        CloseHandle(File);
+        return false;
+    }
+    mFile = File;
+    mMapping = Mapping;
+    mData = (const char*)View;
+    mSize = (unsigned)FileSize.QuadPart;
+#else
+    int File = open(path.c_str(), O_RDONLY);
+    struct stat Info;
+    if (File < 0 || fstat(File, &Info) != 0 || Info.st_size < (off_t)sizeof(Header)) {
+        std::cerr << "[Err] Failed to open compiled scene " << path << std::endl;
+        if (File >= 0) {
+            close(File);
+        }
+        return false;
+    }
+    void* View = mmap(0, Info.st_size, PROT_READ, MAP_PRIVATE, File, 0);
+    // The mapping keeps the file referenced on its own
+    close(File);
+    if (View == MAP_FAILED) {
+        std::cerr << "[Err] Failed to map compiled scene " << path << std::endl;
+        return false;
+    }
+    mMapping = View;
+    mData = (const char*)View;
+    mSize = Info.st_size;
+#endif
+
+    if (!validate(path)) {
+        Unload();
+        return false;
+    }
+    return true;
+}
+
+bool
+SceneFile::WriteBinary(const std::string& path) const {
+    if (!mData) {
+        return false;
+    }
+    std::ofstream Out(path, std::ios::binary | std::ios::trunc);
+    Out.write(mData, mSize);
+    return (bool)Out;
+}
+
+void
+SceneFile::Unload() {
+#ifdef _WIN32
+    if (mMapping) {
+        UnmapViewOfFile(mData);
+        CloseHandle((HANDLE)mMapping);
+        CloseHandle((HANDLE)mFile);
+    }
+#else
+    if (mMapping) {
+        munmap(mMapping, mSize);
+    }
+#endif
+    mMapping = 0;
+    mFile = 0;
+    mImage.clear();
+    mData = 0;
+    mSize = 0;
+}
+
+unsigned
+SceneFile::GetCount(ESection section) const {
+    return mData ? ((const Header*)mData)->Sections[section].Count : 0;
+}
+
+const SceneFile::Texture*
+SceneFile::GetTextures() const {
+    return (const Texture*)section(SECTION_TEXTURES);
+}
+
+const SceneFile::Mesh*
+SceneFile::GetMeshes() const {
+    return (const Mesh*)section(SECTION_MESHES);
+}
+
+const SceneFile::Material*
+SceneFile::GetMaterials() const {
+    return (const Material*)section(SECTION_MATERIALS);
+}
+
+const SceneFile::Node*
+SceneFile::GetNodes() const {
+    return (const Node*)section(SECTION_NODES);
+}
+
+const SceneFile::Draw*
+SceneFile::GetDraws() const {
+    return (const Draw*)section(SECTION_DRAWS);
+}
+
+const SceneFile::Light*
+SceneFile::GetLights() const {
+    return (const Light*)section(SECTION_LIGHTS);
+}
+
+const SceneFile::Animator*
+SceneFile::GetAnimators() const {
+    return (const Animator*)section(SECTION_ANIMATORS);
+}
+
+const SceneFile::Prefab*
+SceneFile::GetPrefabs() const {
+    return (const Prefab*)section(SECTION_PREFABS);
+}
+
+const SceneFile::Part*
+SceneFile::GetParts() const {
+    return (const Part*)section(SECTION_PARTS);
+}
+
+const SceneFile::Instance*
+SceneFile::GetInstances() const {
+    return (const Instance*)section(SECTION_INSTANCES);
+}
+
+const char*
+SceneFile::GetString(uint32_t offset) const {
+    return offset == NONE ? "" : (const char*)section(SECTION_STRINGS) + offset;
+}
+
+bool
+SceneFile::IsMapped() const {
+    return mMapping != 0;
+}
+
+const void*
+SceneFile::section(ESection section) const {
+    return mData + ((const Header*)mData)->Sections[section].Offset;
+}
+
+// Framing first, then every reference between records, so Create can index without checks
+bool
+SceneFile::validate(const std::string& path) const {
+    const Header* FileHeader = (const Header*)mData;
+    if (FileHeader->Magic != MAGIC || FileHeader->Version != VERSION || FileHeader->Size != mSize) {
+        std::cerr << "[Err] " << path << " is not a compiled scene of this version" << std::endl;
+        return false;
+    }
+
+    const unsigned RecordSizes[SECTION_COUNT] = { sizeof(Texture), sizeof(Mesh), sizeof(Material), sizeof(Node), sizeof(Draw), sizeof(Light), sizeof(Animator),
+        sizeof(Prefab), sizeof(Part), sizeof(Instance), 1 };
+    for (unsigned SectionIdx = 0; SectionIdx < SECTION_COUNT; ++SectionIdx) {
+        const Section& Current = FileHeader->Sections[SectionIdx];
+        if (Current.Offset % 4 || Current.Offset > mSize || (uint64_t)Current.Count * RecordSizes[SectionIdx] > mSize - Current.Offset) {
+            std::cerr << "[Err] " << path << " is truncated or corrupt" << std::endl;
+            return false;
+        }
+    }
+    if (!validateRecords()) {
+        std::cerr << "[Err] " << path << " has references out of range" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool
+SceneFile::validateRecords() const {
+    // Strings are read up to their terminator, the section has to end with one
+    unsigned StringSize = GetCount(SECTION_STRINGS);
+    if (StringSize && ((const char*)section(SECTION_STRINGS))[StringSize - 1] != '\0') {
+        return false;
+    }
+    unsigned TextureCount = GetCount(SECTION_TEXTURES);
+    unsigned MeshCount = GetCount(SECTION_MESHES);
+    unsigned MaterialCount = GetCount(SECTION_MATERIALS);
+    unsigned NodeCount = GetCount(SECTION_NODES);
+    unsigned PrefabCount = GetCount(SECTION_PREFABS);
+
+    const Texture* Textures = GetTextures();
+    for (unsigned Idx = 0; Idx < TextureCount; ++Idx) {
+        if (!inRange(Textures[Idx].Name, StringSize, false) || !inRange(Textures[Idx].Path, StringSize, false)) {
+            return false;
+        }
+    }
+    const Mesh* Meshes = GetMeshes();
+    for (unsigned Idx = 0; Idx < MeshCount; ++Idx) {
+        bool Primitive = Meshes[Idx].Type == MESH_PRIMITIVE;
+        if (Meshes[Idx].Type > MESH_MODEL || !inRange(Meshes[Idx].Name, StringSize, false) || !inRange(Meshes[Idx].Path, StringSize, Primitive)) {
+            return false;
+        }
+    }
+    const Material* Materials = GetMaterials();
+    for (unsigned Idx = 0; Idx < MaterialCount; ++Idx) {
+        const Material& Current = Materials[Idx];
+        if (!inRange(Current.Name, StringSize, false) || !inRange(Current.Shader, StringSize, false)
+            || !inRange(Current.Diffuse, TextureCount, true) || !inRange(Current.Specular, TextureCount, true)) {
+            return false;
+        }
+    }
+    // Parents come before their children and are of the same kind
+    const Node* Nodes = GetNodes();
+    for (unsigned Idx = 0; Idx < NodeCount; ++Idx) {
+        const Node& Current = Nodes[Idx];
+        if (!inRange(Current.Name, StringSize, false) || !inRange(Current.Parent, Idx, true)
+            || (Current.Parent != NONE && Nodes[Current.Parent].Static != Current.Static)) {
+            return false;
+        }
+    }
+    const Draw* Draws = GetDraws();
+    for (unsigned Idx = 0; Idx < GetCount(SECTION_DRAWS); ++Idx) {
+        const Draw& Current = Draws[Idx];
+        if (!inRange(Current.Node, NodeCount, false) || !inRange(Current.Mesh, MeshCount, false) || !inRange(Current.Material, MaterialCount, false)
+            || (Nodes[Current.Node].Static && Meshes[Current.Mesh].Type != MESH_PRIMITIVE)) {
+            return false;
+        }
+    }
+    const Light* Lights = GetLights();
+    for (unsigned Idx = 0; Idx < GetCount(SECTION_LIGHTS); ++Idx) {
+        if (Lights[Idx].Type > LIGHT_SPOT || !inRange(Lights[Idx].Name, StringSize, false)) {
+            return false;
+        }
+    }
+    const Animator* Animators = GetAnimators();
+    for (unsigned Idx = 0; Idx < GetCount(SECTION_ANIMATORS); ++Idx) {
+        if (Animators[Idx].Type > ANIMATOR_BOB || !inRange(Animators[Idx].Node, NodeCount, false) || Nodes[Animators[Idx].Node].Static) {
+            return false;
+        }
+    }
+    const Prefab* Prefabs = GetPrefabs();
+    for (unsigned Idx = 0; Idx < PrefabCount; ++Idx) {
+        if (!inRange(Prefabs[Idx].Name, StringSize, false)) {
+            return false;
+        }
+    }
+    const Part* Parts = GetParts();
+    for (unsigned Idx = 0; Idx < GetCount(SECTION_PARTS); ++Idx) {
+        const Part& Current = Parts[Idx];
+        if (!inRange(Current.Prefab, PrefabCount, false) || !inRange(Current.Mesh, MeshCount, false) || !inRange(Current.Material, MaterialCount, false)
+            || Meshes[Current.Mesh].Type != MESH_PRIMITIVE) {
+            return false;
+        }
+    }
+    const Instance* Instances = GetInstances();
+    for (unsigned Idx = 0; Idx < GetCount(SECTION_INSTANCES); ++Idx) {
+        if (!inRange(Instances[Idx].Name, StringSize, false) || !inRange(Instances[Idx].Prefab, PrefabCount, false)) {
+            return false;
+        }
+    }
+    return true;
+}
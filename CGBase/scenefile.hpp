@@ -0,0 +1,213 @@
+/**
+ * @file scenefile.hpp
+ * @brief Scene description: textures, meshes, materials, nodes, draws, lights, animators and prefabs.
+ * Authored as text, one record per line, and compiled into a flat binary image that is
+ * memory-mapped and read in place, so loading a compiled scene is a map and a header check.
+ *
+ * Text records, names are single words, '-' stands for none and '#' starts a comment:
+ *   texture   <name> <path> [linear]
+ *   primitive <name>                              geometry registered by the application
+ *   model     <name> <path>
+ *   material  <name> <shader> <diffuse> <specular> <r g b>
+ *   node      <name> <parent> <x y z> <axis x y z> <degrees> <sx sy sz>
+ *   static    <name> <parent> <x y z> <axis x y z> <degrees> <sx sy sz>
+ *   draw      <node> <primitive|model> <material>
+ *   directional <name> <direction xyz> <ka rgb> <kd rgb> <ks rgb>
+ *   point     <name> <position xyz> <kc> <kl> <kq> <range> <ka rgb> <kd rgb> <ks rgb>
+ *   spot      <name> <position xyz> <direction xyz> <kc> <kl> <kq> <inner degrees> <outer degrees> <ka rgb> <kd rgb> <ks rgb>
+ *   spin      <node> <axis x y z> <degrees per second>
+ *   bob       <node> <axis x y z> <amplitude> <radians per second> <phase>
+ *   prefab    <name>
+ *   part      <prefab> <primitive> <material> <x y z> <axis x y z> <degrees> <sx sy sz>
+ *   instance  <name> <prefab> <x y z> <axis x y z> <degrees> <sx sy sz>
+ *
+ * Static nodes never move relative to the scene root, their draws get baked. A node's parent
+ * has to be the root or a node of the same kind.
+ *
+ * A prefab is a composite defined once by its parts and placed by instances under the scene
+ * root, like static nodes. All instances of a prefab are drawn together, one instanced draw per part.
+ */
+
+#pragma once
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <glm/glm.hpp>
+
+class SceneFile {
+public:
+    static const uint32_t NONE = 0xFFFFFFFF;
+
+    enum ESection {
+        SECTION_TEXTURES = 0,
+        SECTION_MESHES,
+        SECTION_MATERIALS,
+        SECTION_NODES,
+        SECTION_DRAWS,
+        SECTION_LIGHTS,
+        SECTION_ANIMATORS,
+        SECTION_PREFABS,
+        SECTION_PARTS,
+        SECTION_INSTANCES,
+        SECTION_STRINGS,
+        SECTION_COUNT,
+    };
+
+    enum EMeshType {
+        MESH_PRIMITIVE = 0,
+        MESH_MODEL,
+    };
+
+    enum ELightType {
+        LIGHT_DIRECTIONAL = 0,
+        LIGHT_POINT,
+        LIGHT_SPOT,
+    };
+
+    enum EAnimatorType {
+        ANIMATOR_SPIN = 0,
+        ANIMATOR_BOB,
+    };
+
+    // Records as laid out in the binary image, names and paths are offsets into the string section
+    struct Texture {
+        uint32_t Name;
+        uint32_t Path;
+        uint32_t Linear;
+    };
+
+    struct Mesh {
+        uint32_t Name;
+        uint32_t Type;
+        uint32_t Path;
+    };
+
+    struct Material {
+        uint32_t Name;
+        uint32_t Shader;
+        // Texture indices, NONE for the queue's default
+        uint32_t Diffuse;
+        uint32_t Specular;
+        glm::vec3 Color;
+    };
+
+    struct Node {
+        uint32_t Name;
+        // Node index, always lower than the node's own, NONE for the scene root
+        uint32_t Parent;
+        uint32_t Static;
+        glm::vec3 Position;
+        // x, y, z, w
+        glm::vec4 Rotation;
+        glm::vec3 Scale;
+    };
+
+    struct Draw {
+        uint32_t Node;
+        uint32_t Mesh;
+        uint32_t Material;
+    };
+
+    struct Light {
+        uint32_t Name;
+        uint32_t Type;
+        glm::vec3 Position;
+        glm::vec3 Direction;
+        // Kc, Kl, Kq, range
+        glm::vec4 Attenuation;
+        // Cosines of the inner and outer cone angles
+        glm::vec2 CutOff;
+        glm::vec3 Ka;
+        glm::vec3 Kd;
+        glm::vec3 Ks;
+    };
+
+    struct Animator {
+        uint32_t Type;
+        uint32_t Node;
+        glm::vec3 Axis;
+        // Degrees per second for spin, radians per second for bob
+        float Speed;
+        float Amplitude;
+        float Phase;
+    };
+
+    struct Prefab {
+        uint32_t Name;
+    };
+
+    struct Part {
+        uint32_t Prefab;
+        // Always a primitive, models have no instanced path
+        uint32_t Mesh;
+        uint32_t Material;
+        glm::vec3 Position;
+        // x, y, z, w
+        glm::vec4 Rotation;
+        glm::vec3 Scale;
+    };
+
+    struct Instance {
+        uint32_t Name;
+        uint32_t Prefab;
+        glm::vec3 Position;
+        // x, y, z, w
+        glm::vec4 Rotation;
+        glm::vec3 Scale;
+    };
+
+    SceneFile();
+    ~SceneFile();
+
+    /**
+     * @brief Maps the compiled form next to path (same name, .bin extension) if it is at least as new
+     * as the text. Otherwise parses the text and writes the compiled form for the next run.
+     */
+    bool Load(const std::string& path);
+    bool LoadText(const std::string& path);
+    bool LoadBinary(const std::string& path);
+    bool WriteBinary(const std::string& path) const;
+    void Unload();
+
+    unsigned GetCount(ESection section) const;
+    const Texture* GetTextures() const;
+    const Mesh* GetMeshes() const;
+    const Material* GetMaterials() const;
+    const Node* GetNodes() const;
+    const Draw* GetDraws() const;
+    const Light* GetLights() const;
+    const Animator* GetAnimators() const;
+    const Prefab* GetPrefabs() const;
+    const Part* GetParts() const;
+    const Instance* GetInstances() const;
+    const char* GetString(uint32_t offset) const;
+    // True if the data is read in place from a mapped file
+    bool IsMapped() const;
+
+private:
+    static const uint32_t MAGIC = 0x43534743; // "CGSC"
+    static const uint32_t VERSION = 2;
+
+    struct Section {
+        uint32_t Offset;
+        uint32_t Count;
+    };
+
+    struct Header {
+        uint32_t Magic;
+        uint32_t Version;
+        uint32_t Size;
+        Section Sections[SECTION_COUNT];
+    };
+
+    // Image parsed from text, unused when mapped
+    std::vector<char> mImage;
+    const char* mData;
+    unsigned mSize;
+    void* mMapping;
+    void* mFile;
+
+    const void* section(ESection section) const;
+    bool validate(const std::string& path) const;
+    bool validateRecords() const;
+};
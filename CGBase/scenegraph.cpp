@@ -0,0 +1,102 @@
+#include "scenegraph.hpp"
+#include <iostream>
+
+SceneGraph::SceneGraph() {
+    mDirty = false;
+}
+
+SceneGraph::NodeId
+SceneGraph::CreateNode(NodeId parent, const glm::vec3& position, const glm::quat& rotation, const glm::vec3& scale) {
+    if (parent != INVALID_NODE && parent >= mNodes.size()) {
+        std::cerr << "[Err] Scene graph parent " << parent << " does not exist" << std::endl;
+        parent = INVALID_NODE;
+    }
+
+    Node NewNode;
+    NewNode.Parent = parent;
+    NewNode.Position = position;
+    NewNode.Rotation = rotation;
+    NewNode.Scale = scale;
+    NewNode.World = glm::mat4(1.0f);
+    NewNode.Dirty = true;
+    NewNode.WorldChanged = false;
+    mNodes.push_back(NewNode);
+    mDirty = true;
+    return mNodes.size() - 1;
+}
+
+void
+SceneGraph::SetPosition(NodeId node, const glm::vec3& position) {
+    if (mNodes[node].Position != position) {
+        mNodes[node].Position = position;
+        markDirty(node);
+    }
+}
+
+void
+SceneGraph::SetRotation(NodeId node, const glm::quat& rotation) {
+    if (mNodes[node].Rotation != rotation) {
+        mNodes[node].Rotation = rotation;
+        markDirty(node);
+    }
+}
+
+void
+SceneGraph::SetScale(NodeId node, const glm::vec3& scale) {
+    if (mNodes[node].Scale != scale) {
+        mNodes[node].Scale = scale;
+        markDirty(node);
+    }
+}
+
+const glm::vec3&
+SceneGraph::GetPosition(NodeId node) const {
+    return mNodes[node].Position;
+}
+
+const glm::quat&
+SceneGraph::GetRotation(NodeId node) const {
+    return mNodes[node].Rotation;
+}
+
+const glm::mat4&
+SceneGraph::GetWorld(NodeId node) const {
+    return mNodes[node].World;
+}
+
+unsigned
+SceneGraph::Update() {
+    if (!mDirty) {
+        return 0;
+    }
+
+    unsigned Updated = 0;
+    for (unsigned NodeIdx = 0; NodeIdx < mNodes.size(); ++NodeIdx) {
+        Node& CurrNode = mNodes[NodeIdx];
+        bool ParentChanged = CurrNode.Parent != INVALID_NODE && mNodes[CurrNode.Parent].WorldChanged;
+        CurrNode.WorldChanged = CurrNode.Dirty || ParentChanged;
+        if (!CurrNode.WorldChanged) {
+            continue;
+        }
+
+        // Same order as chained translate, rotate, scale
+        glm::mat4 Local = glm::translate(glm::mat4(1.0f), CurrNode.Position) * glm::mat4_cast(CurrNode.Rotation);
+        Local = glm::scale(Local, CurrNode.Scale);
+        CurrNode.World = CurrNode.Parent != INVALID_NODE ? mNodes[CurrNode.Parent].World * Local : Local;
+        CurrNode.Dirty = false;
+        Updated++;
+    }
+    mDirty = false;
+    return Updated;
+}
+
+unsigned
+SceneGraph::GetNodeCount() const {
+    return mNodes.size();
+}
+
+void
+SceneGraph::markDirty(NodeId node) {
+    mNodes[node].Dirty = true;
+    mDirty = true;
+}
@@ -0,0 +1,64 @@
+/**
+ * @file scenegraph.hpp
+ * @brief Transform hierarchy. Nodes keep a local position, rotation and scale and a cached
+ * world matrix; Update recomputes only nodes whose local transform changed and their
+ * descendants, so a frame where nothing moves does no matrix math at all.
+ *
+ * A node's parent has to exist before the node, which keeps parents ahead of their children
+ * and lets Update walk the nodes front to back in a single pass.
+ */
+
+#pragma once
+#include <vector>
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+class SceneGraph {
+public:
+    typedef unsigned NodeId;
+    static const NodeId INVALID_NODE = 0xFFFFFFFF;
+
+    SceneGraph();
+
+    NodeId CreateNode(NodeId parent, const glm::vec3& position = glm::vec3(0.0f), const glm::quat& rotation = glm::quat(1.0f, 0.0f, 0.0f, 0.0f), const glm::vec3& scale = glm::vec3(1.0f));
+    /**
+     * @brief Setters only mark the node dirty when the value actually changes
+     */
+    void SetPosition(NodeId node, const glm::vec3& position);
+    void SetRotation(NodeId node, const glm::quat& rotation);
+    void SetScale(NodeId node, const glm::vec3& scale);
+    const glm::vec3& GetPosition(NodeId node) const;
+    const glm::quat& GetRotation(NodeId node) const;
+    /**
+     * @brief World matrix as of the last Update
+     */
+    const glm::mat4& GetWorld(NodeId node) const;
+
+    /**
+     * @brief Recomputes the world matrices of dirty nodes and everything below them
+     *
+     * @returns Number of world matrices recomputed
+     */
+    unsigned Update();
+    unsigned GetNodeCount() const;
+
+private:
+    struct Node {
+        NodeId Parent;
+        glm::vec3 Position;
+        glm::quat Rotation;
+        glm::vec3 Scale;
+        glm::mat4 World;
+        // Local transform changed since the last Update
+        bool Dirty;
+        // World matrix was recomputed by the current Update, children have to follow
+        bool WorldChanged;
+    };
+
+    std::vector<Node> mNodes;
+    // Any node dirty, lets Update return without touching the nodes
+    bool mDirty;
+
+    void markDirty(NodeId node);
+};
@@ -0,0 +1,432 @@
+#include "sceneinstance.hpp"
+#include "model.hpp"
+#include "texture.hpp"
+
+// Nodes, prefab parts and instances all carry a position, rotation and scale
+template<typename T>
+static glm::mat4
+localMatrix(const T& record) {
+    glm::quat Rotation(record.Rotation.w, record.Rotation.x, record.Rotation.y, record.Rotation.z);
+    glm::mat4 Local = glm::translate(glm::mat4(1.0f), record.Position) * glm::mat4_cast(Rotation);
+    return glm::scale(Local, record.Scale);
+}
+
+SceneInstance::SceneInstance() {
+    mOcclusion = 0;
+    mAnimation = 0;
+    mPrefabs = 0;
+}
+
+SceneInstance::~SceneInstance() {
+    Destroy();
+}
+
+void
+SceneInstance::SetShader(const std::string& name, Shader* shader) {
+    mShaders[name] = shader;
+}
+
+void
+SceneInstance::SetPrimitive(const std::string& name, const Renderable* renderable, const StaticBatcher::Geometry& geometry) {
+    Primitive NewPrimitive = { renderable, geometry };
+    mPrimitives[name] = NewPrimitive;
+}
+
+void
+SceneInstance::SetOcclusionCuller(OcclusionCuller* occlusion) {
+    mOcclusion = occlusion;
+}
+
+void
+SceneInstance::SetAnimation(AnimationSystem* animation) {
+    mAnimation = animation;
+}
+
+void
+SceneInstance::SetPrefabs(PrefabSet* prefabs) {
+    mPrefabs = prefabs;
+}
+
+bool
+SceneInstance::Create(const SceneFile& file, SceneGraph& graph, SceneGraph::NodeId root, StaticBatcher& staticScene, LightBuffer& lights) {
+    Destroy();
+
+    const SceneFile::Texture* Textures = file.GetTextures();
+    for (unsigned TextureIdx = 0; TextureIdx < file.GetCount(SceneFile::SECTION_TEXTURES); ++TextureIdx) {
+        unsigned Id = Texture::LoadImageToTexture(file.GetString(Textures[TextureIdx].Path));
+        if (Textures[TextureIdx].Linear) {
+            GLState::BindTexture(0, Id);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+            GLState::BindTexture(0, 0);
+        }
+        mTextures.push_back(Id);
+        mTextureIds[file.GetString(Textures[TextureIdx].Name)] = Id;
+    }
+
+    // Meshes by file index, exactly one of the two is set
+    unsigned MeshCount = file.GetCount(SceneFile::SECTION_MESHES);
+    const SceneFile::Mesh* Meshes = file.GetMeshes();
+    std::vector<const Primitive*> MeshPrimitives(MeshCount, (const Primitive*)0);
+    std::vector<const Model*> MeshModels(MeshCount, (const Model*)0);
+    for (unsigned MeshIdx = 0; MeshIdx < MeshCount; ++MeshIdx) {
+        std::string Name = file.GetString(Meshes[MeshIdx].Name);
+        if (Meshes[MeshIdx].Type == SceneFile::MESH_PRIMITIVE) {
+            std::map<std::string, Primitive>::const_iterator Found = mPrimitives.find(Name);
+            if (Found == mPrimitives.end()) {
+                std::cerr << "[Err] Scene primitive " << Name << " is not registered" << std::endl;
+                return false;
+            }
+            MeshPrimitives[MeshIdx] = &Found->second;
+            continue;
+        }
+
+        Model* NewModel = new Model(file.GetString(Meshes[MeshIdx].Path));
+        mModels[Name] = NewModel;
+        if (!NewModel->Load()) {
+            std::cerr << "[Err] Failed to load scene model " << Name << std::endl;
+            return false;
+        }
+        MeshModels[MeshIdx] = NewModel;
+    }
+
+    // Moving nodes go into the graph, static ones are only needed for baking
+    unsigned NodeCount = file.GetCount(SceneFile::SECTION_NODES);
+    const SceneFile::Node* Nodes = file.GetNodes();
+    std::vector<SceneGraph::NodeId> GraphNodes(NodeCount, SceneGraph::INVALID_NODE);
+    std::vector<glm::mat4> StaticWorld(NodeCount);
+    for (unsigned NodeIdx = 0; NodeIdx < NodeCount; ++NodeIdx) {
+        const SceneFile::Node& Current = Nodes[NodeIdx];
+        if (Current.Static) {
+            glm::mat4 Local = localMatrix(Current);
+            StaticWorld[NodeIdx] = Current.Parent == SceneFile::NONE ? Local : StaticWorld[Current.Parent] * Local;
+            continue;
+        }
+
+        SceneGraph::NodeId Parent = Current.Parent == SceneFile::NONE ? root : GraphNodes[Current.Parent];
+        glm::quat Rotation(Current.Rotation.w, Current.Rotation.x, Current.Rotation.y, Current.Rotation.z);
+        GraphNodes[NodeIdx] = graph.CreateNode(Parent, Current.Position, Rotation, Current.Scale);
+        mNodes[file.GetString(Current.Name)] = GraphNodes[NodeIdx];
+    }
+
+    // Animated nodes every node moves with, so draws can tell which animations they depend on
+    const SceneFile::Animator* Animators = file.GetAnimators();
+    std::vector<bool> Animated(NodeCount, false);
+    for (unsigned AnimatorIdx = 0; AnimatorIdx < file.GetCount(SceneFile::SECTION_ANIMATORS); ++AnimatorIdx) {
+        Animated[Animators[AnimatorIdx].Node] = true;
+    }
+    std::vector<std::vector<SceneGraph::NodeId> > AnimatedNodes(NodeCount);
+    for (unsigned NodeIdx = 0; NodeIdx < NodeCount; ++NodeIdx) {
+        if (Nodes[NodeIdx].Parent != SceneFile::NONE) {
+            AnimatedNodes[NodeIdx] = AnimatedNodes[Nodes[NodeIdx].Parent];
+        }
+        if (Animated[NodeIdx]) {
+            AnimatedNodes[NodeIdx].push_back(GraphNodes[NodeIdx]);
+            mAnimatedNodes.push_back(GraphNodes[NodeIdx]);
+        }
+    }
+
+    const SceneFile::Material* Materials = file.GetMaterials();
+    const SceneFile::Draw* Draws = file.GetDraws();
+    for (unsigned DrawIdx = 0; DrawIdx < file.GetCount(SceneFile::SECTION_DRAWS); ++DrawIdx) {
+        const SceneFile::Draw& Current = Draws[DrawIdx];
+        const SceneFile::Material& DrawMaterial = Materials[Current.Material];
+        unsigned Diffuse = DrawMaterial.Diffuse == SceneFile::NONE ? 0 : mTextures[DrawMaterial.Diffuse];
+        unsigned Specular = DrawMaterial.Specular == SceneFile::NONE ? 0 : mTextures[DrawMaterial.Specular];
+        if (Nodes[Current.Node].Static) {
+            const StaticBatcher::Geometry& Geometry = MeshPrimitives[Current.Mesh]->Geometry;
+            staticScene.Add(Geometry, StaticWorld[Current.Node], DrawMaterial.Color, Diffuse, Specular);
+            if (mOcclusion) {
+                mOcclusion->AddOccluder(Geometry.Vertices, Geometry.VerticesSize / (8 * sizeof(float)), 8,
+                    Geometry.Indices, Geometry.IndicesSize / sizeof(unsigned), StaticWorld[Current.Node]);
+            }
+            continue;
+        }
+
+        std::map<std::string, Shader*>::const_iterator Program = mShaders.find(file.GetString(DrawMaterial.Shader));
+        if (Program == mShaders.end()) {
+            std::cerr << "[Err] Scene shader " << file.GetString(DrawMaterial.Shader) << " is not registered" << std::endl;
+            return false;
+        }
+        Draw NewDraw;
+        NewDraw.Node = GraphNodes[Current.Node];
+        NewDraw.Primitive = MeshPrimitives[Current.Mesh] ? MeshPrimitives[Current.Mesh]->Object : 0;
+        NewDraw.Object = MeshModels[Current.Mesh];
+        NewDraw.Program = Program->second;
+        NewDraw.Color = DrawMaterial.Color;
+        NewDraw.DiffuseTexture = Diffuse;
+        NewDraw.SpecularTexture = Specular;
+        NewDraw.LocalBounds = NewDraw.Primitive ? NewDraw.Primitive->GetBounds() : NewDraw.Object->GetBounds();
+        NewDraw.Name = file.GetString(Nodes[Current.Node].Name);
+        NewDraw.AnimatedNodes = AnimatedNodes[Current.Node];
+        mDraws.push_back(NewDraw);
+    }
+
+    // Instances sit under root like static nodes and hide what is behind them like baked draws
+    const SceneFile::Prefab* Prefabs = file.GetPrefabs();
+    const SceneFile::Part* Parts = file.GetParts();
+    const SceneFile::Instance* Instances = file.GetInstances();
+    std::vector<PrefabSet::PrefabId> PrefabIds(file.GetCount(SceneFile::SECTION_PREFABS), PrefabSet::INVALID_PREFAB);
+    for (unsigned PrefabIdx = 0; PrefabIdx < PrefabIds.size() && mPrefabs; ++PrefabIdx) {
+        PrefabIds[PrefabIdx] = mPrefabs->AddPrefab(file.GetString(Prefabs[PrefabIdx].Name));
+    }
+    for (unsigned PartIdx = 0; PartIdx < file.GetCount(SceneFile::SECTION_PARTS) && mPrefabs; ++PartIdx) {
+        const SceneFile::Part& Current = Parts[PartIdx];
+        const SceneFile::Material& PartMaterial = Materials[Current.Material];
+        unsigned Diffuse = PartMaterial.Diffuse == SceneFile::NONE ? 0 : mTextures[PartMaterial.Diffuse];
+        unsigned Specular = PartMaterial.Specular == SceneFile::NONE ? 0 : mTextures[PartMaterial.Specular];
+        mPrefabs->AddPart(PrefabIds[Current.Prefab], MeshPrimitives[Current.Mesh]->Object, localMatrix(Current), PartMaterial.Color, Diffuse, Specular);
+    }
+    for (unsigned InstanceIdx = 0; InstanceIdx < file.GetCount(SceneFile::SECTION_INSTANCES) && mPrefabs; ++InstanceIdx) {
+        const SceneFile::Instance& Current = Instances[InstanceIdx];
+        glm::mat4 World = localMatrix(Current);
+        mPrefabs->AddInstance(PrefabIds[Current.Prefab], World);
+        for (unsigned PartIdx = 0; PartIdx < file.GetCount(SceneFile::SECTION_PARTS) && mOcclusion; ++PartIdx) {
+            if (Parts[PartIdx].Prefab != Current.Prefab) {
+                continue;
+            }
+            const StaticBatcher::Geometry& Geometry = MeshPrimitives[Parts[PartIdx].Mesh]->Geometry;
+            mOcclusion->AddOccluder(Geometry.Vertices, Geometry.VerticesSize / (8 * sizeof(float)), 8,
+                Geometry.Indices, Geometry.IndicesSize / sizeof(unsigned), World * localMatrix(Parts[PartIdx]));
+        }
+    }
+
+    const SceneFile::Light* Lights = file.GetLights();
+    for (unsigned LightIdx = 0; LightIdx < file.GetCount(SceneFile::SECTION_LIGHTS); ++LightIdx) {
+        const SceneFile::Light& Current = Lights[LightIdx];
+        unsigned Id = 0;
+        switch (Current.Type) {
+        case SceneFile::LIGHT_DIRECTIONAL:
+            Id = lights.AddDirectional(Current.Direction);
+            break;
+        case SceneFile::LIGHT_POINT:
+            Id = lights.AddPoint(Current.Position, Current.Attenuation.x, Current.Attenuation.y, Current.Attenuation.z, Current.Attenuation.w);
+            break;
+        default:
+            Id = lights.AddSpot(Current.Position, Current.Direction, Current.Attenuation.x, Current.Attenuation.y, Current.Attenuation.z,
+                Current.CutOff.x, Current.CutOff.y);
+            break;
+        }
+        if (Id == LightBuffer::INVALID_LIGHT) {
+            std::cerr << "[Err] Scene light " << file.GetString(Current.Name) << " does not fit in the light buffer" << std::endl;
+            return false;
+        }
+        lights.SetColor(Id, Current.Ka, Current.Kd, Current.Ks);
+        mLights[file.GetString(Current.Name)] = Id;
+    }
+
+    for (unsigned AnimatorIdx = 0; AnimatorIdx < file.GetCount(SceneFile::SECTION_ANIMATORS) && mAnimation; ++AnimatorIdx) {
+        const SceneFile::Animator& Current = Animators[AnimatorIdx];
+        const SceneFile::Node& Target = Nodes[Current.Node];
+        if (Current.Type == SceneFile::ANIMATOR_SPIN) {
+            AnimationSystem::ChannelId Channel = mAnimation->AddRamp(Current.Speed, 360.0f);
+            glm::quat BaseRotation(Target.Rotation.w, Target.Rotation.x, Target.Rotation.y, Target.Rotation.z);
+            mAnimation->BindNodeSpin(Channel, GraphNodes[Current.Node], BaseRotation, Current.Axis);
+        }
+        else {
+            AnimationSystem::ChannelId Channel = mAnimation->AddWave(Current.Speed, Current.Phase, Current.Amplitude, 0.0f);
+            mAnimation->BindNodeOffset(Channel, GraphNodes[Current.Node], Target.Position, Current.Axis);
+        }
+    }
+    return true;
+}
+
+bool
+SceneInstance::AddStressBlock(const SceneFile& file, const std::vector<std::string>& roots, StressScene& stress) const {
+    // Transforms relative to the block origin, set for the roots and their descendants only
+    unsigned NodeCount = file.GetCount(SceneFile::SECTION_NODES);
+    const SceneFile::Node* Nodes = file.GetNodes();
+    std::vector<glm::mat4> Relative(NodeCount);
+    std::vector<bool> InBlock(NodeCount, false);
+    const SceneFile::Instance* Instances = file.GetInstances();
+    // Prefab instances among the roots and their transforms relative to the block origin
+    std::vector<unsigned> BlockInstances;
+    std::vector<glm::mat4> InstanceRelative;
+    glm::vec3 Origin(0.0f);
+    for (unsigned RootIdx = 0; RootIdx < roots.size(); ++RootIdx) {
+        unsigned Found = SceneFile::NONE;
+        for (unsigned NodeIdx = 0; NodeIdx < NodeCount && Found == SceneFile::NONE; ++NodeIdx) {
+            Found = roots[RootIdx] == file.GetString(Nodes[NodeIdx].Name) ? NodeIdx : SceneFile::NONE;
+        }
+        if (Found != SceneFile::NONE) {
+            Origin = RootIdx ? Origin : Nodes[Found].Position;
+            Relative[Found] = glm::translate(glm::mat4(1.0f), -Origin) * localMatrix(Nodes[Found]);
+            InBlock[Found] = true;
+            continue;
+        }
+
+        for (unsigned InstanceIdx = 0; InstanceIdx < file.GetCount(SceneFile::SECTION_INSTANCES) && Found == SceneFile::NONE; ++InstanceIdx) {
+            Found = roots[RootIdx] == file.GetString(Instances[InstanceIdx].Name) ? InstanceIdx : SceneFile::NONE;
+        }
+        if (Found == SceneFile::NONE) {
+            std::cerr << "[Err] Stress block node " << roots[RootIdx] << " is not in the scene" << std::endl;
+            return false;
+        }
+        Origin = RootIdx ? Origin : Instances[Found].Position;
+        BlockInstances.push_back(Found);
+        InstanceRelative.push_back(glm::translate(glm::mat4(1.0f), -Origin) * localMatrix(Instances[Found]));
+    }
+    // Parents always come first in the file
+    for (unsigned NodeIdx = 0; NodeIdx < NodeCount; ++NodeIdx) {
+        uint32_t Parent = Nodes[NodeIdx].Parent;
+        if (!InBlock[NodeIdx] && Parent != SceneFile::NONE && InBlock[Parent]) {
+            Relative[NodeIdx] = Relative[Parent] * localMatrix(Nodes[NodeIdx]);
+            InBlock[NodeIdx] = true;
+        }
+    }
+
+    // Every material the block uses needs its shader before the block exists, a failure leaves stress untouched
+    const SceneFile::Mesh* Meshes = file.GetMeshes();
+    const SceneFile::Material* Materials = file.GetMaterials();
+    const SceneFile::Draw* Draws = file.GetDraws();
+    const SceneFile::Part* Parts = file.GetParts();
+    std::vector<bool> BlockMaterials(file.GetCount(SceneFile::SECTION_MATERIALS), false);
+    for (unsigned DrawIdx = 0; DrawIdx < file.GetCount(SceneFile::SECTION_DRAWS); ++DrawIdx) {
+        BlockMaterials[Draws[DrawIdx].Material] = BlockMaterials[Draws[DrawIdx].Material] || InBlock[Draws[DrawIdx].Node];
+    }
+    for (unsigned BlockIdx = 0; BlockIdx < BlockInstances.size(); ++BlockIdx) {
+        for (unsigned PartIdx = 0; PartIdx < file.GetCount(SceneFile::SECTION_PARTS); ++PartIdx) {
+            if (Parts[PartIdx].Prefab == Instances[BlockInstances[BlockIdx]].Prefab) {
+                BlockMaterials[Parts[PartIdx].Material] = true;
+            }
+        }
+    }
+    for (unsigned MaterialIdx = 0; MaterialIdx < BlockMaterials.size(); ++MaterialIdx) {
+        if (BlockMaterials[MaterialIdx] && !mShaders.count(file.GetString(Materials[MaterialIdx].Shader))) {
+            std::cerr << "[Err] Scene shader " << file.GetString(Materials[MaterialIdx].Shader) << " is not registered" << std::endl;
+            return false;
+        }
+    }
+
+    StressScene::BlockId Block = stress.AddBlock(roots.empty() ? std::string() : roots[0]);
+    for (unsigned DrawIdx = 0; DrawIdx < file.GetCount(SceneFile::SECTION_DRAWS); ++DrawIdx) {
+        const SceneFile::Draw& Current = Draws[DrawIdx];
+        if (!InBlock[Current.Node]) {
+            continue;
+        }
+        const SceneFile::Material& DrawMaterial = Materials[Current.Material];
+        std::string Mesh = file.GetString(Meshes[Current.Mesh].Name);
+        std::map<std::string, Shader*>::const_iterator Program = mShaders.find(file.GetString(DrawMaterial.Shader));
+        if (Meshes[Current.Mesh].Type == SceneFile::MESH_PRIMITIVE) {
+            unsigned Diffuse = DrawMaterial.Diffuse == SceneFile::NONE ? 0 : mTextures[DrawMaterial.Diffuse];
+            unsigned Specular = DrawMaterial.Specular == SceneFile::NONE ? 0 : mTextures[DrawMaterial.Specular];
+            stress.AddPart(Block, mPrimitives.find(Mesh)->second.Object, Program->second, Relative[Current.Node], DrawMaterial.Color, Diffuse, Specular);
+        }
+        else {
+            stress.AddPart(Block, mModels.find(Mesh)->second, Program->second, Relative[Current.Node], DrawMaterial.Color);
+        }
+    }
+
+    for (unsigned BlockIdx = 0; BlockIdx < BlockInstances.size(); ++BlockIdx) {
+        for (unsigned PartIdx = 0; PartIdx < file.GetCount(SceneFile::SECTION_PARTS); ++PartIdx) {
+            const SceneFile::Part& Current = Parts[PartIdx];
+            if (Current.Prefab != Instances[BlockInstances[BlockIdx]].Prefab) {
+                continue;
+            }
+            const SceneFile::Material& PartMaterial = Materials[Current.Material];
+            std::map<std::string, Shader*>::const_iterator Program = mShaders.find(file.GetString(PartMaterial.Shader));
+            unsigned Diffuse = PartMaterial.Diffuse == SceneFile::NONE ? 0 : mTextures[PartMaterial.Diffuse];
+            unsigned Specular = PartMaterial.Specular == SceneFile::NONE ? 0 : mTextures[PartMaterial.Specular];
+            stress.AddPart(Block, mPrimitives.find(file.GetString(Meshes[Current.Mesh].Name))->second.Object, Program->second,
+                InstanceRelative[BlockIdx] * localMatrix(Current), PartMaterial.Color, Diffuse, Specular);
+        }
+    }
+    return true;
+}
+
+void
+SceneInstance::Destroy() {
+    for (unsigned Id : mTextures) {
+        GLState::DeleteTexture(Id);
+    }
+    for (std::map<std::string, Model*>::iterator It = mModels.begin(); It != mModels.end(); ++It) {
+        It->second->Unload();
+        delete It->second;
+    }
+    mModels.clear();
+    mTextures.clear();
+    mTextureIds.clear();
+    mNodes.clear();
+    mLights.clear();
+    mDraws.clear();
+    mAnimatedNodes.clear();
+}
+
+void
+SceneInstance::SetAnimationRates(const unsigned* visibleDraws, unsigned count, unsigned hiddenInterval) const {
+    if (!mAnimation) {
+        return;
+    }
+    for (SceneGraph::NodeId Node : mAnimatedNodes) {
+        mAnimation->SetNodeInterval(Node, hiddenInterval);
+    }
+    for (unsigned ListIdx = 0; ListIdx < count; ++ListIdx) {
+        for (SceneGraph::NodeId Node : mDraws[visibleDraws[ListIdx]].AnimatedNodes) {
+            mAnimation->SetNodeInterval(Node, 1);
+        }
+    }
+}
+
+void
+SceneInstance::Submit(RenderQueue::DrawList& list, const SceneGraph& graph, unsigned first, unsigned count) const {
+    for (unsigned DrawIdx = first; DrawIdx < first + count && DrawIdx < mDraws.size(); ++DrawIdx) {
+        submitDraw(list, graph, mDraws[DrawIdx]);
+    }
+}
+
+void
+SceneInstance::Submit(RenderQueue::DrawList& list, const SceneGraph& graph, const unsigned* draws, unsigned count) const {
+    for (unsigned ListIdx = 0; ListIdx < count; ++ListIdx) {
+        submitDraw(list, graph, mDraws[draws[ListIdx]]);
+    }
+}
+
+void
+SceneInstance::submitDraw(RenderQueue::DrawList& list, const SceneGraph& graph, const Draw& draw) const {
+    const glm::mat4& World = graph.GetWorld(draw.Node);
+    if (draw.Primitive) {
+        draw.Primitive->Submit(list, *draw.Program, World, draw.Color, draw.DiffuseTexture, draw.SpecularTexture);
+    }
+    else {
+        draw.Object->Submit(list, *draw.Program, World, draw.Color);
+    }
+}
+
+unsigned
+SceneInstance::GetDrawCount() const {
+    return mDraws.size();
+}
+
+void
+SceneInstance::GetDrawBox(unsigned draw, const SceneGraph& graph, glm::vec3& min, glm::vec3& max) const {
+    mDraws[draw].LocalBounds.WorldBox(graph.GetWorld(mDraws[draw].Node), min, max);
+}
+
+const std::string&
+SceneInstance::GetDrawName(unsigned draw) const {
+    return mDraws[draw].Name;
+}
+
+SceneGraph::NodeId
+SceneInstance::FindNode(const std::string& name) const {
+    std::map<std::string, SceneGraph::NodeId>::const_iterator Found = mNodes.find(name);
+    return Found == mNodes.end() ? SceneGraph::INVALID_NODE : Found->second;
+}
+
+unsigned
+SceneInstance::FindLight(const std::string& name) const {
+    std::map<std::string, unsigned>::const_iterator Found = mLights.find(name);
+    return Found == mLights.end() ? SceneFile::NONE : Found->second;
+}
+
+unsigned
+SceneInstance::FindTexture(const std::string& name) const {
+    std::map<std::string, unsigned>::const_iterator Found = mTextureIds.find(name);
+    return Found == mTextureIds.end() ? 0 : Found->second;
+}
+
+const Model*
+SceneInstance::FindModel(const std::string& name) const {
+    std::map<std::string, Model*>::const_iterator Found = mModels.find(name);
+    return Found == mModels.end() ? 0 : Found->second;
+}
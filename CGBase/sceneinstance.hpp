@@ -0,0 +1,126 @@
+/**
+ * @file sceneinstance.hpp
+ * @brief Turns a SceneFile into live objects: loads its textures and models, creates its nodes
+ * in a SceneGraph, adds its lights to a LightBuffer and bakes its static draws. The file's
+ * animators become channels of an AnimationSystem, its prefabs and their instances go into a
+ * PrefabSet, and the draws of the moving nodes are submitted every frame.
+ *
+ * Shaders and primitive geometry are owned by the application and registered by the names
+ * the file uses before Create.
+ */
+
+#pragma once
+#include <string>
+#include <vector>
+#include <map>
+#include "scenefile.hpp"
+#include "scenegraph.hpp"
+#include "staticbatcher.hpp"
+#include "lightbuffer.hpp"
+#include "renderable.hpp"
+#include "occlusionculler.hpp"
+#include "stressscene.hpp"
+#include "animationsystem.hpp"
+#include "prefabset.hpp"
+
+class Model;
+
+class SceneInstance {
+public:
+    SceneInstance();
+    ~SceneInstance();
+
+    void SetShader(const std::string& name, Shader* shader);
+    void SetPrimitive(const std::string& name, const Renderable* renderable, const StaticBatcher::Geometry& geometry);
+    /**
+     * @brief Static primitive draws created afterwards also become occluders, relative to the root
+     */
+    void SetOcclusionCuller(OcclusionCuller* occlusion);
+    /**
+     * @brief Animators created afterwards are bound to animation, without one the scene stays still
+     */
+    void SetAnimation(AnimationSystem* animation);
+    /**
+     * @brief Prefabs created afterwards are added to prefabs, without one they are skipped. Part
+     * materials only give color and textures, prefabs are drawn with the set's instanced program.
+     */
+    void SetPrefabs(PrefabSet* prefabs);
+
+    /**
+     * @brief Creates everything file describes. Nodes without a parent go under root, draws of
+     * static nodes are added to staticScene relative to root. Fails on the first missing shader,
+     * primitive or model.
+     */
+    bool Create(const SceneFile& file, SceneGraph& graph, SceneGraph::NodeId root, StaticBatcher& staticScene, LightBuffer& lights);
+    /**
+     * @brief Adds a block to stress made of the draws of the named nodes and everything under them,
+     * static or not, and the parts of the named prefab instances. The first root's position becomes
+     * the block origin. Call after Create with the same file, fails on an unknown name.
+     */
+    bool AddStressBlock(const SceneFile& file, const std::vector<std::string>& roots, StressScene& stress) const;
+    /**
+     * @brief Frees the textures and models, the nodes and lights stay in their containers
+     */
+    void Destroy();
+
+    /**
+     * @brief Animated nodes with no listed draw under them are only moved every hiddenInterval frames
+     */
+    void SetAnimationRates(const unsigned* visibleDraws, unsigned count, unsigned hiddenInterval) const;
+    /**
+     * @brief Submits draws [first, first + count) of the moving nodes, safe to call from jobs for disjoint ranges
+     */
+    void Submit(RenderQueue::DrawList& list, const SceneGraph& graph, unsigned first, unsigned count) const;
+    /**
+     * @brief Submits the count draws whose indices are listed in draws, e.g. the ones a BVH query found visible
+     */
+    void Submit(RenderQueue::DrawList& list, const SceneGraph& graph, const unsigned* draws, unsigned count) const;
+    unsigned GetDrawCount() const;
+    /**
+     * @brief World-space axis-aligned box of a draw as its node is placed in graph
+     */
+    void GetDrawBox(unsigned draw, const SceneGraph& graph, glm::vec3& min, glm::vec3& max) const;
+    // Name of the node the draw belongs to
+    const std::string& GetDrawName(unsigned draw) const;
+
+    SceneGraph::NodeId FindNode(const std::string& name) const;
+    // Index in the LightBuffer, SceneFile::NONE if there is no such light
+    unsigned FindLight(const std::string& name) const;
+    unsigned FindTexture(const std::string& name) const;
+    const Model* FindModel(const std::string& name) const;
+
+private:
+    struct Primitive {
+        const Renderable* Object;
+        StaticBatcher::Geometry Geometry;
+    };
+
+    struct Draw {
+        SceneGraph::NodeId Node;
+        const Renderable* Primitive;
+        const Model* Object;
+        Shader* Program;
+        glm::vec3 Color;
+        unsigned DiffuseTexture;
+        unsigned SpecularTexture;
+        Bounds LocalBounds;
+        std::string Name;
+        // Animated nodes the draw moves with, its own or its ancestors
+        std::vector<SceneGraph::NodeId> AnimatedNodes;
+    };
+
+    OcclusionCuller* mOcclusion;
+    AnimationSystem* mAnimation;
+    PrefabSet* mPrefabs;
+    std::map<std::string, Shader*> mShaders;
+    std::map<std::string, Primitive> mPrimitives;
+    std::map<std::string, SceneGraph::NodeId> mNodes;
+    std::map<std::string, unsigned> mLights;
+    std::map<std::string, unsigned> mTextureIds;
+    std::map<std::string, Model*> mModels;
+    std::vector<unsigned> mTextures;
+    std::vector<Draw> mDraws;
+    std::vector<SceneGraph::NodeId> mAnimatedNodes;
+
+    void submitDraw(RenderQueue::DrawList& list, const SceneGraph& graph, const Draw& draw) const;
+};
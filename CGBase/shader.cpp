@@ -1,18 +1,46 @@
 #include "shader.hpp"
+#include <cstring>
+#include <chrono>
+#include <thread>
+#include <regex>
+#include <iterator>
 
+bool Shader::sParallelCompile = false;
+bool Shader::sSpirvSupported = false;
 
 Shader::Shader(const std::string& vShaderPath, const std::string& fShaderPath) {
-    unsigned vs = loadAndCompileShader(vShaderPath, GL_VERTEX_SHADER);
-    unsigned fs = loadAndCompileShader(fShaderPath, GL_FRAGMENT_SHADER);
-    mId = createBasicProgram(vs, fs);
+    mVertexPath = vShaderPath;
+    mFragmentPath = fShaderPath;
+    mPending = PendingProgram();
+    mSpirv = false;
+    mPreferGlsl = false;
+    compileSources();
+    linkProgram();
+    mId = finishProgram(mPending);
+    mSpirv = mPending.Spirv;
+    mPending = PendingProgram();
+}
+
+Shader::Shader(const std::string& vShaderPath, const std::string& fShaderPath, ShaderBatch& batch) {
+    mVertexPath = vShaderPath;
+    mFragmentPath = fShaderPath;
+    mPending = PendingProgram();
+    mSpirv = false;
+    mPreferGlsl = false;
+    mId = 0;
+    batch.Add(this);
 }
 void
 Shader::SetUniform4m(const std::string& uniform, const glm::mat4& m) const {
-    glUniformMatrix4fv(glGetUniformLocation(mId, uniform.c_str()), 1, GL_FALSE, &m[0][0]);
+    UniformState& State = this->uniform(uniform, GL_FLOAT_MAT4);
+    std::memcpy(State.Data, &m[0][0], 16 * sizeof(float));
+    glUniformMatrix4fv(State.Location, 1, GL_FALSE, &m[0][0]);
 }
 void
 Shader::SetUniform3v(const std::string& uniform, const glm::vec3& m) const {
-    glUniform3fv(glGetUniformLocation(mId, uniform.c_str()), 1, &m[0]);
+    UniformState& State = this->uniform(uniform, GL_FLOAT_VEC3);
+    std::memcpy(State.Data, &m[0], 3 * sizeof(float));
+    glUniform3fv(State.Location, 1, &m[0]);
 }
 void
 Shader::SetModel(const glm::mat4& m) const {
@@ -20,15 +48,19 @@ Shader::SetModel(const glm::mat4& m) const {
 }
 void
 Shader::SetUniform3f(const std::string& uniform, const glm::vec3& v) const {
-    glUniform3f(glGetUniformLocation(mId, uniform.c_str()), v.x, v.y, v.z);
+    SetUniform3v(uniform, v);
 }
 void
 Shader::SetUniform1i(const std::string& uniform, int v) const {
-    glUniform1i(glGetUniformLocation(mId, uniform.c_str()), v);
+    UniformState& State = this->uniform(uniform, GL_INT);
+    State.Int = v;
+    glUniform1i(State.Location, v);
 }
 void
 Shader::SetUniform1f(const std::string& uniform, float v) const {
-    glUniform1f(glGetUniformLocation(mId, uniform.c_str()), v);
+    UniformState& State = this->uniform(uniform, GL_FLOAT);
+    State.Data[0] = v;
+    glUniform1f(State.Location, v);
 }
 void
 Shader::SetView(const glm::mat4& m) const {
@@ -46,65 +78,352 @@ void Shader::SetViewport(const glm::mat4& m) const {
 }
 
 void Shader::SetColor(const float r, const float g, const float b) {
-    glUniform3f(glGetUniformLocation(mId, "uCol"), r,g,b);
+    SetUniform3v("uCol", glm::vec3(r, g, b));
+}
+GLint
+Shader::GetUniformLocation(const std::string& uniform) const {
+    return uniformLocation(uniform);
+}
+void
+Shader::SetUniformBlockBinding(const std::string& block, unsigned binding) const {
+    mBlockBindings[block] = binding;
+    unsigned BlockIndex = glGetUniformBlockIndex(mId, block.c_str());
+    if (BlockIndex != GL_INVALID_INDEX) {
+        glUniformBlockBinding(mId, BlockIndex, binding);
+    }
 }
 unsigned
 Shader::GetId() const {
     return mId;
 }
+const std::string&
+Shader::GetVertexPath() const {
+    return mVertexPath;
+}
+const std::string&
+Shader::GetFragmentPath() const {
+    return mFragmentPath;
+}
+
+void
+Shader::BeginReload() {
+    if (IsReloading()) {
+        // Sources changed again while compiling, the older attempt is stale
+        glDeleteShader(mPending.VertexShader);
+        glDeleteShader(mPending.FragmentShader);
+        glDeleteProgram(mPending.Program);
+    }
+    // The edited GLSL is newer than any precompiled SPIR-V
+    mPreferGlsl = true;
+    compileSources();
+    linkProgram();
+}
+
+bool
+Shader::PollReload() {
+    if (!IsReloading() || !isProgramComplete(mPending)) {
+        return false;
+    }
+
+    unsigned NewId = finishProgram(mPending);
+    bool NewSpirv = mPending.Spirv;
+    mPending = PendingProgram();
+    if (!NewId) {
+        std::cerr << "[Err] Reload of " << mVertexPath << " + " << mFragmentPath << " failed, keeping the old program" << std::endl;
+        return false;
+    }
+
+    unsigned PreviousProgram = GLState::GetProgram();
+    unsigned OldId = mId;
+    mId = NewId;
+    mSpirv = NewSpirv;
+
+    GLState::UseProgram(mId);
+    for (auto& Uniform : mUniforms) {
+        Uniform.second.Location = uniformLocation(Uniform.first);
+        applyUniform(Uniform.second);
+    }
+    for (const auto& Block : mBlockBindings) {
+        SetUniformBlockBinding(Block.first, Block.second);
+    }
+    GLState::UseProgram(PreviousProgram == OldId ? mId : PreviousProgram);
+    GLState::DeleteProgram(OldId);
+
+    std::cout << "Reloaded " << mVertexPath << " + " << mFragmentPath << std::endl;
+    return true;
+}
+
+bool
+Shader::IsReloading() const {
+    return mPending.Program != 0;
+}
+
+void
+Shader::EnableParallelCompile() {
+    sParallelCompile = GLEW_KHR_parallel_shader_compile;
+    if (sParallelCompile) {
+        // 0xFFFFFFFF lets the driver pick the thread count
+        glMaxShaderCompilerThreadsKHR(0xFFFFFFFF);
+    }
+}
+
+void
+Shader::EnableSpirv() {
+    sSpirvSupported = GLEW_VERSION_4_6 || GLEW_ARB_gl_spirv;
+}
+
+void
+Shader::SetSpecializationConstant(unsigned constantId, unsigned value) {
+    for (unsigned Idx = 0; Idx < mSpecializationIds.size(); ++Idx) {
+        if (mSpecializationIds[Idx] == constantId) {
+            mSpecializationValues[Idx] = value;
+            return;
+        }
+    }
+    mSpecializationIds.push_back(constantId);
+    mSpecializationValues.push_back(value);
+}
+
+Shader::UniformState&
+Shader::uniform(const std::string& name, GLenum type) const {
+    auto It = mUniforms.find(name);
+    if (It == mUniforms.end()) {
+        UniformState State = UniformState();
+        State.Location = uniformLocation(name);
+        It = mUniforms.insert(std::make_pair(name, State)).first;
+    }
+    It->second.Type = type;
+    return It->second;
+}
+
+GLint
+Shader::uniformLocation(const std::string& name) const {
+    if (!mSpirv) {
+        return glGetUniformLocation(mId, name.c_str());
+    }
+
+    auto It = mSpirvLocations.find(name);
+    return It != mSpirvLocations.end() ? It->second : -1;
+}
+
+void
+Shader::applyUniform(const UniformState& state) const {
+    switch (state.Type) {
+    case GL_INT: glUniform1i(state.Location, state.Int); break;
+    case GL_FLOAT: glUniform1f(state.Location, state.Data[0]); break;
+    case GL_FLOAT_VEC3: glUniform3fv(state.Location, 1, state.Data); break;
+    case GL_FLOAT_MAT4: glUniformMatrix4fv(state.Location, 1, GL_FALSE, state.Data); break;
+    }
+}
+
+void
+Shader::compileSources() {
+    if (sSpirvSupported && !mPreferGlsl) {
+        unsigned VertexShader = loadSpirvShader(mVertexPath, GL_VERTEX_SHADER);
+        unsigned FragmentShader = VertexShader ? loadSpirvShader(mFragmentPath, GL_FRAGMENT_SHADER) : 0;
+        if (VertexShader && FragmentShader) {
+            mSpirvLocations.clear();
+            parseExplicitLocations(mVertexPath);
+            parseExplicitLocations(mFragmentPath);
+            mPending.VertexShader = VertexShader;
+            mPending.FragmentShader = FragmentShader;
+            mPending.Spirv = true;
+            return;
+        }
+        glDeleteShader(VertexShader);
+    }
+
+    mPending.VertexShader = loadAndCompileShader(mVertexPath, GL_VERTEX_SHADER);
+    mPending.FragmentShader = loadAndCompileShader(mFragmentPath, GL_FRAGMENT_SHADER);
+    mPending.Spirv = false;
+}
+
+void
+Shader::linkProgram() {
+    mPending.Program = createBasicProgram(mPending.VertexShader, mPending.FragmentShader);
+}
+
+bool
+Shader::isProgramComplete(const PendingProgram& pending) {
+    if (!sParallelCompile) {
+        return true;
+    }
+
+    int Complete;
+    glGetProgramiv(pending.Program, GL_COMPLETION_STATUS_KHR, &Complete);
+    return Complete;
+}
+
 unsigned
-Shader::loadAndCompileShader(std::string filename, GLuint shaderType) {
-    unsigned ShaderID = 0;
-    std::ifstream In(filename);
-    std::string Str;
+Shader::finishProgram(const PendingProgram& pending) const {
+    const unsigned Shaders[] = { pending.VertexShader, pending.FragmentShader };
+    bool Compiled = true;
+    int Success = 0;
+    char InfoLog[512];
+    for (unsigned ShaderID : Shaders) {
+        glGetShaderiv(ShaderID, GL_COMPILE_STATUS, &Success);
+        if (!Success) {
+            glGetShaderInfoLog(ShaderID, 512, NULL, InfoLog);
+            std::string ShaderTypeName = ShaderID == pending.VertexShader ? "vertex" : "fragment";
+            std::cout << "Error while compiling shader [" << ShaderTypeName << "]:" << std::endl << InfoLog << std::endl;
+            Compiled = false;
+            continue;
+        }
+        const std::string& Path = ShaderID == pending.VertexShader ? mVertexPath : mFragmentPath;
+        std::cout << "Loaded " << Path << (pending.Spirv ? " SPIR-V" : "") << " shader" << std::endl;
+    }
 
-    In.seekg(0, std::ios::end);
-    Str.reserve(In.tellg());
-    In.seekg(0, std::ios::beg);
+    unsigned ProgramID = pending.Program;
+    if (Compiled) {
+        glGetProgramiv(ProgramID, GL_LINK_STATUS, &Success);
+        if (!Success) {
+            glGetProgramInfoLog(ProgramID, 512, NULL, InfoLog);
+            std::cerr << "[Err] Failed to link shader program:" << std::endl << InfoLog << std::endl;
+        }
+    }
 
-    Str.assign((std::istreambuf_iterator<char>(In)), std::istreambuf_iterator<char>());
+    glDetachShader(ProgramID, pending.VertexShader);
+    glDetachShader(ProgramID, pending.FragmentShader);
+    glDeleteShader(pending.VertexShader);
+    glDeleteShader(pending.FragmentShader);
+
+    if (!Compiled || !Success) {
+        glDeleteProgram(ProgramID);
+        return 0;
+    }
+    return ProgramID;
+}
+
+unsigned
+Shader::loadAndCompileShader(std::string filename, GLuint shaderType) const {
+    unsigned ShaderID = 0;
+    std::string Str = readFile(filename, false);
     const char* CharContent = Str.c_str();
 
+    // Status is only queried in finishProgram so the driver is not forced to finish early
     ShaderID = glCreateShader(shaderType);
     glShaderSource(ShaderID, 1, &CharContent, NULL);
     glCompileShader(ShaderID);
 
-    int Success;
-    char InfoLog[512];
-    glGetShaderiv(ShaderID, GL_COMPILE_STATUS, &Success);
-    if (!Success) {
-        glGetShaderInfoLog(ShaderID, 256, NULL, InfoLog);
-        std::string ShaderTypeName = shaderType == GL_VERTEX_SHADER ? "vertex" : "fragment";
-        std::cout << "Error while compiling shader [" << ShaderTypeName << "]:" << std::endl << InfoLog << std::endl;
+    return ShaderID;
+}
+
+unsigned
+Shader::loadSpirvShader(const std::string& filename, GLuint shaderType) const {
+    // shaders/phong.frag is precompiled to shaders/spirv/phong.frag.spv
+    size_t Separator = filename.find_last_of("/\\");
+    std::string Directory = Separator == std::string::npos ? "" : filename.substr(0, Separator + 1);
+    std::string SpirvPath = Directory + "spirv/" + filename.substr(Separator + 1) + ".spv";
+    std::string Binary = readFile(SpirvPath, true);
+    if (Binary.empty()) {
         return 0;
     }
 
-    std::cout << "Loaded " << filename << " shader" << std::endl;
+    unsigned ShaderID = glCreateShader(shaderType);
+    glShaderBinary(1, &ShaderID, GL_SHADER_BINARY_FORMAT_SPIR_V, Binary.data(), (GLsizei)Binary.size());
+    const unsigned* Ids = mSpecializationIds.empty() ? NULL : mSpecializationIds.data();
+    const unsigned* Values = mSpecializationValues.empty() ? NULL : mSpecializationValues.data();
+    if (GLEW_VERSION_4_6) {
+        glSpecializeShader(ShaderID, "main", (GLuint)mSpecializationIds.size(), Ids, Values);
+    }
+    else {
+        glSpecializeShaderARB(ShaderID, "main", (GLuint)mSpecializationIds.size(), Ids, Values);
+    }
 
     return ShaderID;
 }
 
+void
+Shader::parseExplicitLocations(const std::string& filename) {
+    std::string Source = readFile(filename, false);
+
+    // Member names of the structs in the source, uniforms of a struct type get one location per member
+    std::map<std::string, std::vector<std::string>> Structs;
+    const std::regex StructPattern("struct\\s+(\\w+)\\s*\\{([^}]*)\\}");
+    const std::regex MemberPattern("\\w+\\s+(\\w+)\\s*;");
+    for (std::sregex_iterator It(Source.begin(), Source.end(), StructPattern), End; It != End; ++It) {
+        std::vector<std::string>& Members = Structs[(*It)[1]];
+        std::string Body = (*It)[2];
+        for (std::sregex_iterator Member(Body.begin(), Body.end(), MemberPattern); Member != End; ++Member) {
+            Members.push_back((*Member)[1]);
+        }
+    }
+
+    const std::regex UniformPattern("LOCATION\\((\\d+)\\)\\s+uniform\\s+(\\w+)\\s+(\\w+)\\s*;");
+    for (std::sregex_iterator It(Source.begin(), Source.end(), UniformPattern), End; It != End; ++It) {
+        int Location = std::stoi((*It)[1]);
+        auto Struct = Structs.find((*It)[2]);
+        if (Struct == Structs.end()) {
+            mSpirvLocations[(*It)[3]] = Location;
+            continue;
+        }
+        for (const std::string& Member : Struct->second) {
+            mSpirvLocations[(*It)[3].str() + "." + Member] = Location++;
+        }
+    }
+}
+
+std::string
+Shader::readFile(const std::string& filename, bool binary) {
+    std::ifstream In(filename, binary ? std::ios::in | std::ios::binary : std::ios::in);
+    std::string Str;
+    if (!In) {
+        return Str;
+    }
+
+    In.seekg(0, std::ios::end);
+    Str.reserve(In.tellg());
+    In.seekg(0, std::ios::beg);
+
+    Str.assign((std::istreambuf_iterator<char>(In)), std::istreambuf_iterator<char>());
+    return Str;
+}
+
 unsigned
-Shader::createBasicProgram(unsigned vShader, unsigned fShader) {
+Shader::createBasicProgram(unsigned vShader, unsigned fShader) const {
     unsigned ProgramID = 0;
     ProgramID = glCreateProgram();
     glAttachShader(ProgramID, vShader);
     glAttachShader(ProgramID, fShader);
     glLinkProgram(ProgramID);
 
-    int Success;
-    char InfoLog[512];
-    glGetProgramiv(ProgramID, GL_LINK_STATUS, &Success);
-    if (!Success) {
-        glGetProgramInfoLog(ProgramID, 512, NULL, InfoLog);
-        std::cerr << "[Err] Failed to link shader program:" << std::endl << InfoLog << std::endl;
-        return 0;
+    return ProgramID;
+}
+
+void
+ShaderBatch::Add(Shader* shader) {
+    mShaders.push_back(shader);
+}
+
+bool
+ShaderBatch::Build() {
+    for (Shader* Program : mShaders) {
+        Program->compileSources();
+    }
+    for (Shader* Program : mShaders) {
+        Program->linkProgram();
     }
 
-    glDetachShader(ProgramID, vShader);
-    glDetachShader(ProgramID, fShader);
-    glDeleteShader(vShader);
-    glDeleteShader(fShader);
+    // With parallel compile the status queries below would block on the first unfinished
+    // program, poll instead so the driver threads keep working on all of them
+    bool AllComplete = false;
+    while (!AllComplete) {
+        AllComplete = true;
+        for (Shader* Program : mShaders) {
+            AllComplete = AllComplete && Shader::isProgramComplete(Program->mPending);
+        }
+        if (!AllComplete) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    }
 
-    return ProgramID;
-}
\ No newline at end of file
+    bool Success = true;
+    for (Shader* Program : mShaders) {
+        Program->mId = Program->finishProgram(Program->mPending);
+        Program->mSpirv = Program->mPending.Spirv;
+        Program->mPending = Shader::PendingProgram();
+        Success = Success && Program->mId != 0;
+    }
+    mShaders.clear();
+    return Success;
+}
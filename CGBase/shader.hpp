@@ -2,8 +2,13 @@
 #include <iostream>
 #include <vector>
 #include <fstream>
+#include <map>
+#include <unordered_map>
 #include <GL/glew.h>
 #include <glm/glm.hpp>
+#include "glstate.hpp"
+
+class ShaderBatch;
 
 class Shader {
 public:
@@ -11,7 +16,14 @@ public:
     static const unsigned COLOR_LOCATION = 1;
 
     Shader(const std::string& vShaderPath, const std::string& fShaderPath);
+    /**
+     * @brief Queues the program in a batch instead of building it right away.
+     * The shader is unusable until ShaderBatch::Build returns.
+     */
+    Shader(const std::string& vShaderPath, const std::string& fShaderPath, ShaderBatch& batch);
     unsigned GetId() const;
+    const std::string& GetVertexPath() const;
+    const std::string& GetFragmentPath() const;
     void SetUniform1i(const std::string& uniform, int v) const;
     void SetUniform1f(const std::string& uniform, float v) const;
     void SetUniform4m(const std::string& uniform, const glm::mat4& m) const;
@@ -23,8 +35,104 @@ public:
     void SetProjection(const glm::mat4& m) const;
     void SetViewport(const glm::mat4& m) const;
     void SetColor(const float, const float, const float);
+    void SetUniformBlockBinding(const std::string& block, unsigned binding) const;
+    // Location in the current program, -1 if the uniform is not active. Changes when the program is reloaded.
+    GLint GetUniformLocation(const std::string& uniform) const;
+
+    /**
+     * @brief Starts recompiling the program from its source files. The current program
+     * stays in use until PollReload reports that the new one linked successfully.
+     */
+    void BeginReload();
+    /**
+     * @brief Finishes a pending reload once the driver is done with it. On success the
+     * new program replaces the old one and every uniform set so far is applied to it.
+     *
+     * @returns True if a new program was swapped in
+     */
+    bool PollReload();
+    bool IsReloading() const;
+
+    /**
+     * @brief Lets the driver compile shaders on its own threads when
+     * GL_KHR_parallel_shader_compile is available. Call once after glewInit.
+     */
+    static void EnableParallelCompile();
+    /**
+     * @brief Makes shaders load precompiled SPIR-V from shaders/spirv when the context
+     * supports GL_ARB_gl_spirv. Sources without a .spv, and hot-reloads, use GLSL.
+     * Call once after glewInit.
+     */
+    static void EnableSpirv();
+    /**
+     * @brief Value for a SPIR-V specialization constant, used the next time the
+     * program is built from SPIR-V. Ignored by the GLSL path.
+     */
+    void SetSpecializationConstant(unsigned constantId, unsigned value);
+
 private:
+    friend class ShaderBatch;
+
+    // Last value set through a SetUniform* call, so it can be applied to a reloaded program
+    struct UniformState {
+        GLint Location;
+        GLenum Type;
+        int Int;
+        float Data[16];
+    };
+
+    struct PendingProgram {
+        unsigned Program;
+        unsigned VertexShader;
+        unsigned FragmentShader;
+        bool Spirv;
+    };
+
     unsigned mId;
-    unsigned loadAndCompileShader(std::string filename, GLuint shaderType);
-    unsigned createBasicProgram(unsigned vShader, unsigned fShader);
-};
\ No newline at end of file
+    std::string mVertexPath;
+    std::string mFragmentPath;
+    PendingProgram mPending;
+    mutable std::unordered_map<std::string, UniformState> mUniforms;
+    mutable std::map<std::string, unsigned> mBlockBindings;
+    // SPIR-V carries no uniform names, locations come from the LOCATION(n) declarations in the GLSL source
+    bool mSpirv;
+    bool mPreferGlsl;
+    std::map<std::string, int> mSpirvLocations;
+    std::vector<unsigned> mSpecializationIds;
+    std::vector<unsigned> mSpecializationValues;
+
+    static bool sParallelCompile;
+    static bool sSpirvSupported;
+
+    UniformState& uniform(const std::string& name, GLenum type) const;
+    GLint uniformLocation(const std::string& name) const;
+    void applyUniform(const UniformState& state) const;
+    void compileSources();
+    void linkProgram();
+    static bool isProgramComplete(const PendingProgram& pending);
+    unsigned finishProgram(const PendingProgram& pending) const;
+    unsigned loadAndCompileShader(std::string filename, GLuint shaderType) const;
+    unsigned loadSpirvShader(const std::string& filename, GLuint shaderType) const;
+    void parseExplicitLocations(const std::string& filename);
+    static std::string readFile(const std::string& filename, bool binary);
+    unsigned createBasicProgram(unsigned vShader, unsigned fShader) const;
+};
+
+/**
+ * @brief Builds several programs together. All sources are submitted first, then all
+ * programs are linked and only then is any status queried, so the driver is free to
+ * compile them in parallel instead of finishing each one before the next is submitted.
+ */
+class ShaderBatch {
+public:
+    void Add(Shader* shader);
+    /**
+     * @brief Compiles and links every queued program, blocking until all are done
+     *
+     * @returns True if every program linked successfully
+     */
+    bool Build();
+
+private:
+    std::vector<Shader*> mShaders;
+};
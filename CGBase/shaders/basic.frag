@@ -1,11 +1,21 @@
 #version 330 core
 
-out vec4 FragColor;
-in vec3 vCol;
-in vec2 TexCoord;
+#ifdef GL_SPIRV
+// Explicit locations and bindings for the precompiled SPIR-V path, see compile_spirv.bat
+#extension GL_ARB_explicit_uniform_location : require
+#extension GL_ARB_separate_shader_objects : require
+#extension GL_ARB_shading_language_420pack : require
+#define LOCATION(n) layout (location = n)
+#else
+#define LOCATION(n)
+#endif
 
-uniform vec3 uCol;
-uniform sampler2D ourTexture;
+LOCATION(0) out vec4 FragColor;
+LOCATION(1) in vec3 vCol;
+LOCATION(0) in vec2 TexCoord;
+
+LOCATION(4) uniform vec3 uCol;
+LOCATION(5) uniform sampler2D ourTexture;
 
 
 void main() {
@@ -1,15 +1,25 @@
 # version 330 core
 
+#ifdef GL_SPIRV
+// Explicit locations and bindings for the precompiled SPIR-V path, see compile_spirv.bat
+#extension GL_ARB_explicit_uniform_location : require
+#extension GL_ARB_separate_shader_objects : require
+#extension GL_ARB_shading_language_420pack : require
+#define LOCATION(n) layout (location = n)
+#else
+#define LOCATION(n)
+#endif
+
 layout (location = 0) in vec3 aPos;
 layout (location = 2) in vec2 aTexCoord;
 layout (location = 3) in vec3 aCol;
 
-uniform mat4 uProjection;
-uniform mat4 uView;
-uniform mat4 uModel;
-uniform mat4 uViewport;
-out vec2 TexCoord;
-out vec3 vCol;
+LOCATION(0) uniform mat4 uProjection;
+LOCATION(1) uniform mat4 uView;
+LOCATION(2) uniform mat4 uModel;
+LOCATION(3) uniform mat4 uViewport;
+LOCATION(0) out vec2 TexCoord;
+LOCATION(1) out vec3 vCol;
 
 void main() {
 	vCol = aCol;
@@ -0,0 +1,11 @@
+@echo off
+rem Precompiles every shader in this directory to SPIR-V for Shader's ARB_gl_spirv path.
+rem Output goes to spirv\<name>.spv, sources without a .spv keep using GLSL.
+rem Needs glslangValidator from the Vulkan SDK on the PATH.
+
+cd /d "%~dp0"
+if not exist spirv mkdir spirv
+
+for %%f in (*.vert *.frag) do (
+    glslangValidator -G -o spirv\%%f.spv %%f || exit /b 1
+)
@@ -0,0 +1,12 @@
+#!/bin/sh
+# Precompiles every shader in this directory to SPIR-V for Shader's ARB_gl_spirv path.
+# Output goes to spirv/<name>.spv, sources without a .spv keep using GLSL.
+# Needs glslangValidator on the PATH.
+
+set -e
+cd "$(dirname "$0")"
+mkdir -p spirv
+
+for f in *.vert *.frag; do
+    glslangValidator -G -o "spirv/$f.spv" "$f"
+done
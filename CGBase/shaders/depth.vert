@@ -0,0 +1,27 @@
+#version 330 core
+
+#ifdef GL_SPIRV
+// Explicit locations and bindings for the precompiled SPIR-V path, see compile_spirv.bat
+#extension GL_ARB_explicit_uniform_location : require
+#extension GL_ARB_separate_shader_objects : require
+#extension GL_ARB_shading_language_420pack : require
+#define LOCATION(n) layout (location = n)
+#else
+#define LOCATION(n)
+#endif
+
+// Depth pre-pass counterpart of phong.vert. The main pass tests GL_EQUAL against the depth
+// written here, so gl_Position is invariant and computed by the same expression in both.
+
+layout (location = 0) in vec3 aPos;
+
+LOCATION(0) uniform mat4 uProjection;
+LOCATION(1) uniform mat4 uView;
+LOCATION(2) uniform mat4 uViewport;
+LOCATION(3) uniform mat4 uModel;
+
+invariant gl_Position;
+
+void main() {
+	gl_Position = uViewport * uProjection * uView * uModel * vec4(aPos, 1.0f);
+}
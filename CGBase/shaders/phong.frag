@@ -1,26 +1,27 @@
 #version 330 core
 
-struct PositionalLight {
-	vec3 Position;
-	vec3 Ka;
-	vec3 Kd;
-	vec3 Ks;
-	float Kc;
-	float Kl;
-	float Kq;
-};
-
-struct DirectionalLight {
-	vec3 Position;
-	vec3 Direction;
-	vec3 Ka;
-	vec3 Kd;
-	vec3 Ks;
-	float InnerCutOff;
-	float OuterCutOff;
-	float Kc;
-	float Kl;
-	float Kq;
+#ifdef GL_SPIRV
+// Explicit locations and bindings for the precompiled SPIR-V path, see compile_spirv.bat
+#extension GL_ARB_explicit_uniform_location : require
+#extension GL_ARB_separate_shader_objects : require
+#extension GL_ARB_shading_language_420pack : require
+#define LOCATION(n) layout (location = n)
+#else
+#define LOCATION(n)
+#endif
+
+// Must match LightBuffer::MAX_LIGHTS
+#define MAX_LIGHTS 32
+
+// Directional, point and spot lights share one layout, see lightbuffer.hpp
+struct Light {
+	vec4 Position;
+	vec4 Direction;
+	vec4 Ka;
+	vec4 Kd;
+	vec4 Ks;
+	vec4 Attenuation;
+	vec4 Cone;
 };
 
 struct Material {
@@ -29,113 +30,57 @@ struct Material {
 	float Shininess;
 };
 
-out vec4 FragColor;
+LOCATION(0) out vec4 FragColor;
+
+LOCATION(0) in vec2 UV;
+LOCATION(1) in vec3 vWorldSpaceFragment;
+LOCATION(2) in vec3 vWorldSpaceNormal;
+LOCATION(3) in vec3 vCol;
+
+#ifdef GL_SPIRV
+// Binding must match LightBuffer::BINDING_POINT
+layout (std140, binding = 0) uniform Lights {
+#else
+layout (std140) uniform Lights {
+#endif
+	int uLightCount;
+	Light uLights[MAX_LIGHTS];
+};
+// Struct members take consecutive locations: Kd = 5, Ks = 6, Shininess = 7
+LOCATION(5) uniform Material uMaterial;
+LOCATION(8) uniform vec3 uViewPos;
 
-in vec2 UV;
-in vec3 vWorldSpaceFragment;
-in vec3 vWorldSpaceNormal;
 
-uniform vec3 uCol;
-uniform sampler2D ourTexture;
-uniform vec3 lightColor;
+void main() {
+	vec3 ViewDirection = normalize(uViewPos - vWorldSpaceFragment);
+	vec3 DiffuseSample = vec3(texture(uMaterial.Kd, UV));
+	vec3 SpecularSample = vec3(texture(uMaterial.Ks, UV));
 
-uniform PositionalLight uPointLight1;
-uniform PositionalLight uPointLight2;
-uniform PositionalLight uPointLight3;
-uniform PositionalLight uPointLight4;
-uniform DirectionalLight uSpotlight;
-uniform DirectionalLight uDirLight;
-uniform Material uMaterial;
-uniform vec3 uViewPos;
+	vec3 FinalColor = vec3(0.0f);
+	for (int i = 0; i < uLightCount; ++i) {
+		vec3 ToLight = uLights[i].Position.xyz - vWorldSpaceFragment;
+		// Directional lights (w = 0) only use their direction
+		vec3 LightVector = normalize(mix(uLights[i].Direction.xyz, ToLight, uLights[i].Position.w));
 
+		float Diffuse = max(dot(vWorldSpaceNormal, LightVector), 0.0f);
+		vec3 ReflectDirection = reflect(-LightVector, vWorldSpaceNormal);
+		float Specular = pow(max(dot(ViewDirection, ReflectDirection), 0.0f), uMaterial.Shininess);
 
-void main() {
-	vec3 ViewDirection = normalize(uViewPos - vWorldSpaceFragment);
-	vec3 DirLightVector = normalize(-uDirLight.Direction);
-	float DirDiffuse = max(dot(vWorldSpaceNormal, DirLightVector), 0.0f);
-	vec3 DirReflectDirection = reflect(-DirLightVector, vWorldSpaceNormal);
-	float DirSpecular = pow(max(dot(ViewDirection, DirReflectDirection), 0.0f), uMaterial.Shininess);
-
-	vec3 DirAmbientColor = uDirLight.Ka * vec3(texture(uMaterial.Kd, UV));
-	vec3 DirDiffuseColor = uDirLight.Kd * DirDiffuse * vec3(texture(uMaterial.Kd, UV));
-	vec3 DirSpecularColor = uDirLight.Ks * DirSpecular * vec3(texture(uMaterial.Ks, UV));
-	vec3 DirColor = DirAmbientColor + DirDiffuseColor + DirSpecularColor;
-
-	//point 1
-	vec3 PtLightVector = normalize(uPointLight1.Position - vWorldSpaceFragment);
-	float PtDiffuse = max(dot(vWorldSpaceNormal, PtLightVector), 0.0f);
-	vec3 PtReflectDirection = reflect(-PtLightVector, vWorldSpaceNormal);
-	float PtSpecular = pow(max(dot(ViewDirection, PtReflectDirection), 0.0f), uMaterial.Shininess);
-
-	vec3 PtAmbientColor = uPointLight1.Ka * vec3(texture(uMaterial.Kd, UV));
-	vec3 PtDiffuseColor = PtDiffuse * uPointLight1.Kd * vec3(texture(uMaterial.Kd, UV));
-	vec3 PtSpecularColor = PtSpecular * uPointLight1.Ks * vec3(texture(uMaterial.Ks, UV));
-
-	float PtLightDistance = pow(length(uPointLight1.Position - vWorldSpaceFragment)/10, 3);
-	float PtAttenuation = 1.0f / (uPointLight1.Kc + uPointLight1.Kl * PtLightDistance + uPointLight1.Kq * (PtLightDistance * PtLightDistance));
-	vec3 PtColor1 = PtAttenuation * (PtAmbientColor + PtDiffuseColor + PtSpecularColor);
-
-	//point 2
-	PtLightVector = normalize(uPointLight2.Position - vWorldSpaceFragment);
-	PtDiffuse = max(dot(vWorldSpaceNormal, PtLightVector), 0.0f);
-	PtReflectDirection = reflect(-PtLightVector, vWorldSpaceNormal);
-	PtSpecular = pow(max(dot(ViewDirection, PtReflectDirection), 0.0f), uMaterial.Shininess);
-
-	PtAmbientColor = uPointLight2.Ka * vec3(texture(uMaterial.Kd, UV));
-	PtDiffuseColor = PtDiffuse * uPointLight2.Kd * vec3(texture(uMaterial.Kd, UV));
-	PtSpecularColor = PtSpecular * uPointLight2.Ks * vec3(texture(uMaterial.Ks, UV));
-
-	PtLightDistance = pow(length(uPointLight2.Position - vWorldSpaceFragment)/10, 3);
-	PtAttenuation = 1.0f / (uPointLight2.Kc + uPointLight2.Kl * PtLightDistance + uPointLight2.Kq * (PtLightDistance * PtLightDistance));
-	vec3 PtColor2 = PtAttenuation * (PtAmbientColor + PtDiffuseColor + PtSpecularColor);
-
-	//point 3
-	PtLightVector = normalize(uPointLight3.Position - vWorldSpaceFragment);
-	PtDiffuse = max(dot(vWorldSpaceNormal, PtLightVector), 0.0f);
-	PtReflectDirection = reflect(-PtLightVector, vWorldSpaceNormal);
-	PtSpecular = pow(max(dot(ViewDirection, PtReflectDirection), 0.0f), uMaterial.Shininess);
-
-	PtAmbientColor = uPointLight3.Ka * vec3(texture(uMaterial.Kd, UV));
-	PtDiffuseColor = PtDiffuse * uPointLight3.Kd * vec3(texture(uMaterial.Kd, UV));
-	PtSpecularColor = PtSpecular * uPointLight3.Ks * vec3(texture(uMaterial.Ks, UV));
-
-	PtLightDistance = pow(length(uPointLight3.Position - vWorldSpaceFragment)/10, 3);
-	PtAttenuation = 1.0f / (uPointLight3.Kc + uPointLight3.Kl * PtLightDistance + uPointLight3.Kq * (PtLightDistance * PtLightDistance));
-	vec3 PtColor3 = PtAttenuation * (PtAmbientColor + PtDiffuseColor + PtSpecularColor);
-
-	//point 4
-	PtLightVector = normalize(uPointLight4.Position - vWorldSpaceFragment);
-	PtDiffuse = max(dot(vWorldSpaceNormal, PtLightVector), 0.0f);
-	PtReflectDirection = reflect(-PtLightVector, vWorldSpaceNormal);
-	PtSpecular = pow(max(dot(ViewDirection, PtReflectDirection), 0.0f), uMaterial.Shininess);
-
-	PtAmbientColor = uPointLight4.Ka * vec3(texture(uMaterial.Kd, UV));
-	PtDiffuseColor = PtDiffuse * uPointLight4.Kd * vec3(texture(uMaterial.Kd, UV));
-	PtSpecularColor = PtSpecular * uPointLight4.Ks * vec3(texture(uMaterial.Ks, UV));
-
-	PtLightDistance = pow(length(uPointLight4.Position - vWorldSpaceFragment)/10, 3);
-	PtAttenuation = 1.0f / (uPointLight4.Kc + uPointLight4.Kl * PtLightDistance + uPointLight4.Kq * (PtLightDistance * PtLightDistance));
-	vec3 PtColor4 = PtAttenuation * (PtAmbientColor + PtDiffuseColor + PtSpecularColor);
-
-	vec3 SpotlightVector = normalize(uSpotlight.Position - vWorldSpaceFragment);
-
-	float SpotDiffuse = max(dot(vWorldSpaceNormal, SpotlightVector), 0.0f);
-	vec3 SpotReflectDirection = reflect(-SpotlightVector, vWorldSpaceNormal);
-	float SpotSpecular = pow(max(dot(ViewDirection, SpotReflectDirection), 0.0f), uMaterial.Shininess);
-
-	vec3 SpotAmbientColor = uSpotlight.Ka * vec3(texture(uMaterial.Kd, UV));
-	vec3 SpotDiffuseColor = SpotDiffuse * uSpotlight.Kd * vec3(texture(uMaterial.Kd, UV));
-	vec3 SpotSpecularColor = SpotSpecular * uSpotlight.Ks * vec3(texture(uMaterial.Ks, UV));
-
-	float SpotlightDistance = length(uSpotlight.Position - vWorldSpaceFragment);
-	float SpotAttenuation = 1.0f / (uSpotlight.Kc + uSpotlight.Kl * SpotlightDistance + uSpotlight.Kq * (SpotlightDistance * SpotlightDistance));
-
-	float Theta = dot(SpotlightVector, normalize(-uSpotlight.Direction));
-	float Epsilon = uSpotlight.InnerCutOff - uSpotlight.OuterCutOff;
-	float SpotIntensity = clamp((Theta - uSpotlight.OuterCutOff) / Epsilon, 0.0f, 1.0f);
-	vec3 SpotColor = SpotIntensity * SpotAttenuation * (SpotAmbientColor + SpotDiffuseColor + SpotSpecularColor);
-
-	vec3 FinalColor = DirColor + PtColor1 + PtColor2 + PtColor3 + PtColor4 + SpotColor;
-
-	FragColor = vec4((FinalColor  * uCol), 1.0f);
-}
\ No newline at end of file
+		vec3 AmbientColor = uLights[i].Ka.rgb * DiffuseSample;
+		vec3 DiffuseColor = Diffuse * uLights[i].Kd.rgb * DiffuseSample;
+		vec3 SpecularColor = Specular * uLights[i].Ks.rgb * SpecularSample;
+
+		// Attenuation.w holds 1 / range, Cone.z selects the cubic falloff of the point lights
+		float LightDistance = length(ToLight) * uLights[i].Attenuation.w;
+		LightDistance = mix(LightDistance, LightDistance * LightDistance * LightDistance, uLights[i].Cone.z);
+		float Attenuation = 1.0f / (uLights[i].Attenuation.x + uLights[i].Attenuation.y * LightDistance + uLights[i].Attenuation.z * (LightDistance * LightDistance));
+
+		// Cone.y holds 1 / (InnerCutOff - OuterCutOff), lights without a cone always end up at 1
+		float Theta = dot(LightVector, uLights[i].Direction.xyz);
+		float Intensity = clamp((Theta - uLights[i].Cone.x) * uLights[i].Cone.y, 0.0f, 1.0f);
+
+		FinalColor += Intensity * Attenuation * (AmbientColor + DiffuseColor + SpecularColor);
+	}
+
+	FragColor = vec4((FinalColor  * vCol), 1.0f);
+}
@@ -1,23 +1,38 @@
 #version 330 core
 
+#ifdef GL_SPIRV
+// Explicit locations and bindings for the precompiled SPIR-V path, see compile_spirv.bat
+#extension GL_ARB_explicit_uniform_location : require
+#extension GL_ARB_separate_shader_objects : require
+#extension GL_ARB_shading_language_420pack : require
+#define LOCATION(n) layout (location = n)
+#else
+#define LOCATION(n)
+#endif
+
 layout (location = 0) in vec3 aPos;
 layout (location = 1) in vec3 aNormal;
 layout (location = 2) in vec2 aTexCoord;
 
-uniform mat4 uProjection;
-uniform mat4 uView;
-uniform mat4 uViewport;
-uniform mat4 uModel;
+LOCATION(0) uniform mat4 uProjection;
+LOCATION(1) uniform mat4 uView;
+LOCATION(2) uniform mat4 uViewport;
+LOCATION(3) uniform mat4 uModel;
+LOCATION(4) uniform vec3 uCol;
+
+LOCATION(0) out vec2 UV;
+LOCATION(1) out vec3 vWorldSpaceFragment;
+LOCATION(2) out vec3 vWorldSpaceNormal;
+LOCATION(3) out vec3 vCol;
 
-out vec2 TexCoord;
-out vec2 UV;
-out vec3 vWorldSpaceFragment;
-out vec3 vWorldSpaceNormal;
+// Depth pre-pass writes the same position, see depth.vert
+invariant gl_Position;
 
 void main() {
 	vWorldSpaceFragment = vec3(uModel * vec4(aPos, 1.0f));
 	vWorldSpaceNormal = normalize(mat3(transpose(inverse(uModel))) * aNormal);
 
+	vCol = uCol;
 	UV = aTexCoord;
 	gl_Position = uViewport * uProjection * uView * uModel * vec4(aPos, 1.0f);
 }
\ No newline at end of file
@@ -0,0 +1,36 @@
+#version 330 core
+
+#ifdef GL_SPIRV
+// Explicit locations and bindings for the precompiled SPIR-V path, see compile_spirv.bat
+#extension GL_ARB_explicit_uniform_location : require
+#extension GL_ARB_separate_shader_objects : require
+#extension GL_ARB_shading_language_420pack : require
+#define LOCATION(n) layout (location = n)
+#else
+#define LOCATION(n)
+#endif
+
+layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec3 aNormal;
+layout (location = 2) in vec2 aTexCoord;
+// Per instance, see Renderable::INSTANCE_MODEL_LOCATION and InstanceData
+layout (location = 4) in mat4 aInstanceModel;
+layout (location = 8) in vec4 aInstanceColor;
+
+LOCATION(0) uniform mat4 uProjection;
+LOCATION(1) uniform mat4 uView;
+LOCATION(2) uniform mat4 uViewport;
+
+LOCATION(0) out vec2 UV;
+LOCATION(1) out vec3 vWorldSpaceFragment;
+LOCATION(2) out vec3 vWorldSpaceNormal;
+LOCATION(3) out vec3 vCol;
+
+void main() {
+	vWorldSpaceFragment = vec3(aInstanceModel * vec4(aPos, 1.0f));
+	vWorldSpaceNormal = normalize(mat3(transpose(inverse(aInstanceModel))) * aNormal);
+
+	vCol = aInstanceColor.rgb;
+	UV = aTexCoord;
+	gl_Position = uViewport * uProjection * uView * aInstanceModel * vec4(aPos, 1.0f);
+}
\ No newline at end of file
@@ -0,0 +1,53 @@
+#version 330 core
+
+#ifdef GL_SPIRV
+// Explicit locations and bindings for the precompiled SPIR-V path, see compile_spirv.bat
+#extension GL_ARB_explicit_uniform_location : require
+#extension GL_ARB_separate_shader_objects : require
+#extension GL_ARB_shading_language_420pack : require
+#define LOCATION(n) layout (location = n)
+#define BINDING(n) layout (binding = n)
+#else
+#define LOCATION(n)
+#define BINDING(n)
+#endif
+
+// phong.vert for RenderQueue multi-draws: model and color come from a per-draw record
+// instead of uniforms, so many draws can go out in one call
+
+layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec3 aNormal;
+layout (location = 2) in vec2 aTexCoord;
+// Record index, see RenderQueue::DRAW_ID_LOCATION
+layout (location = 9) in uint aDrawId;
+
+LOCATION(0) uniform mat4 uProjection;
+LOCATION(1) uniform mat4 uView;
+LOCATION(2) uniform mat4 uViewport;
+// Model matrix columns then color, see RenderQueue::DRAW_DATA_UNIT
+BINDING(2) uniform samplerBuffer uDrawData;
+
+LOCATION(0) out vec2 UV;
+LOCATION(1) out vec3 vWorldSpaceFragment;
+LOCATION(2) out vec3 vWorldSpaceNormal;
+LOCATION(3) out vec3 vCol;
+
+// Depth pre-pass writes the same position, see depth.vert
+invariant gl_Position;
+
+const int DRAW_RECORD_TEXELS = 5;
+
+void main() {
+	int Record = int(aDrawId) * DRAW_RECORD_TEXELS;
+	mat4 Model = mat4(texelFetch(uDrawData, Record),
+	                  texelFetch(uDrawData, Record + 1),
+	                  texelFetch(uDrawData, Record + 2),
+	                  texelFetch(uDrawData, Record + 3));
+
+	vWorldSpaceFragment = vec3(Model * vec4(aPos, 1.0f));
+	vWorldSpaceNormal = normalize(mat3(transpose(inverse(Model))) * aNormal);
+
+	vCol = texelFetch(uDrawData, Record + 4).rgb;
+	UV = aTexCoord;
+	gl_Position = uViewport * uProjection * uView * Model * vec4(aPos, 1.0f);
+}
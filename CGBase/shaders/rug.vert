@@ -0,0 +1,95 @@
+#version 330 core
+
+#ifdef GL_SPIRV
+// Explicit locations and bindings for the precompiled SPIR-V path, see compile_spirv.bat
+#extension GL_ARB_explicit_uniform_location : require
+#extension GL_ARB_separate_shader_objects : require
+#extension GL_ARB_shading_language_420pack : require
+#define LOCATION(n) layout (location = n)
+#else
+#define LOCATION(n)
+#endif
+
+// Waving rug made of one cube per grid cell, drawn with one instance per cell.
+// The instance id picks the cell, every transform is computed here from the time.
+
+layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec3 aNormal;
+layout (location = 2) in vec2 aTexCoord;
+
+LOCATION(0) uniform mat4 uProjection;
+LOCATION(1) uniform mat4 uView;
+LOCATION(2) uniform mat4 uViewport;
+// Transform of the whole rug, applied after the wave
+LOCATION(3) uniform mat4 uModel;
+// 5 - 8 are taken by phong.frag
+LOCATION(9) uniform float uTime;
+// Corner of the rug, y is the resting height
+LOCATION(10) uniform vec3 uRugOffset;
+LOCATION(11) uniform int uGridRows;
+LOCATION(12) uniform float uCellSize;
+
+LOCATION(0) out vec2 UV;
+LOCATION(1) out vec3 vWorldSpaceFragment;
+LOCATION(2) out vec3 vWorldSpaceNormal;
+LOCATION(3) out vec3 vCol;
+
+// Cell size the wave and the pattern were designed for, a finer grid keeps the same look
+const float PATTERN_CELL = 0.02;
+
+mat4 rotateX(float angle) {
+	float c = cos(angle);
+	float s = sin(angle);
+	return mat4(1, 0, 0, 0,
+	            0, c, s, 0,
+	            0, -s, c, 0,
+	            0, 0, 0, 1);
+}
+
+mat4 rotateZ(float angle) {
+	float c = cos(angle);
+	float s = sin(angle);
+	return mat4(c, s, 0, 0,
+	            -s, c, 0, 0,
+	            0, 0, 1, 0,
+	            0, 0, 0, 1);
+}
+
+// Tilt of a cell towards its neighbour in the next row, the step between them is 1 / 120
+float tilt(float row, float phase, float wavelength) {
+	float y = (sin((row + 1 + phase) / wavelength) - sin((row + phase) / wavelength)) / 120;
+	return radians(asin(y / sqrt(y * y + 0.0001)) / 2 * 120);
+}
+
+vec3 patternColor(vec2 cell) {
+	bool Stripe = 5 <= cell.y && cell.y <= 45;
+	if (Stripe && 10 < cell.x && cell.x < 15)
+		return vec3(1, 0, 0);
+	if (Stripe && 5 < cell.x && cell.x < 20)
+		return vec3(1, 1, 0);
+	return vec3(0, 0, 0);
+}
+
+void main() {
+	vec2 Grid = vec2(gl_InstanceID / uGridRows, gl_InstanceID % uGridRows);
+	vec2 Cell = Grid * (uCellSize / PATTERN_CELL);
+	float Phase = uTime * 30;
+
+	float Height = uRugOffset.y + sin(uTime * 1.5) / 4 + sin((Cell.x + Phase) / 4) / 120 + sin((Cell.y + Phase) / 4) / 120;
+	vec3 Position = vec3(uRugOffset.x + Grid.x * uCellSize, Height, uRugOffset.z + Grid.y * uCellSize);
+	float Scale = 2.5 * uCellSize;
+
+	mat4 Model = uModel;
+	Model[3] = uModel * vec4(Position, 1.0f);
+	Model[0] *= Scale;
+	Model[1] *= 0.01;
+	Model[2] *= Scale;
+	Model = Model * rotateZ(tilt(Cell.y, Phase, 3)) * rotateX(-tilt(Cell.y, Phase, 4));
+
+	vWorldSpaceFragment = vec3(Model * vec4(aPos, 1.0f));
+	vWorldSpaceNormal = normalize(mat3(transpose(inverse(Model))) * aNormal);
+
+	vCol = patternColor(Cell);
+	UV = aTexCoord;
+	gl_Position = uViewport * uProjection * uView * Model * vec4(aPos, 1.0f);
+}
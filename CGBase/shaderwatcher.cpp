@@ -0,0 +1,113 @@
+#include "shaderwatcher.hpp"
+#include <sys/stat.h>
+#ifdef __linux__
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+// Without inotify the sources are polled, a couple of stat calls twice a second is plenty
+static const std::chrono::milliseconds PollInterval(500);
+
+ShaderWatcher::ShaderWatcher(const std::string& directory) {
+    mDirectory = directory;
+    mNotifyFd = -1;
+    mLastPoll = std::chrono::steady_clock::now();
+#ifdef __linux__
+    mNotifyFd = inotify_init1(IN_NONBLOCK);
+    if (mNotifyFd < 0 || inotify_add_watch(mNotifyFd, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO) < 0) {
+        std::cerr << "[Err] Failed to watch " << directory << ", falling back to polling" << std::endl;
+        if (mNotifyFd >= 0) {
+            close(mNotifyFd);
+        }
+        mNotifyFd = -1;
+    }
+#endif
+}
+
+ShaderWatcher::~ShaderWatcher() {
+#ifdef __linux__
+    if (mNotifyFd >= 0) {
+        close(mNotifyFd);
+    }
+#endif
+}
+
+void
+ShaderWatcher::Watch(Shader* shader) {
+    WatchedShader Watched;
+    Watched.Program = shader;
+    Watched.VertexTime = modificationTime(shader->GetVertexPath());
+    Watched.FragmentTime = modificationTime(shader->GetFragmentPath());
+    mShaders.push_back(Watched);
+}
+
+void
+ShaderWatcher::Update() {
+    std::vector<std::string> ChangedFiles;
+    collectChanges(ChangedFiles);
+
+    for (WatchedShader& Watched : mShaders) {
+        Shader* Program = Watched.Program;
+        for (const std::string& Changed : ChangedFiles) {
+            if (Changed == fileName(Program->GetVertexPath()) || Changed == fileName(Program->GetFragmentPath())) {
+                std::cout << "Shader source " << Changed << " changed, recompiling" << std::endl;
+                Program->BeginReload();
+                break;
+            }
+        }
+        Program->PollReload();
+    }
+}
+
+void
+ShaderWatcher::collectChanges(std::vector<std::string>& changedFiles) {
+#ifdef __linux__
+    if (mNotifyFd >= 0) {
+        alignas(struct inotify_event) char Buffer[4096];
+        ssize_t Length;
+        while ((Length = read(mNotifyFd, Buffer, sizeof(Buffer))) > 0) {
+            for (char* Ptr = Buffer; Ptr < Buffer + Length;) {
+                const struct inotify_event* Event = (const struct inotify_event*)Ptr;
+                if (Event->len) {
+                    changedFiles.push_back(Event->name);
+                }
+                Ptr += sizeof(struct inotify_event) + Event->len;
+            }
+        }
+        return;
+    }
+#endif
+
+    std::chrono::steady_clock::time_point Now = std::chrono::steady_clock::now();
+    if (Now - mLastPoll < PollInterval) {
+        return;
+    }
+    mLastPoll = Now;
+
+    for (WatchedShader& Watched : mShaders) {
+        std::time_t VertexTime = modificationTime(Watched.Program->GetVertexPath());
+        std::time_t FragmentTime = modificationTime(Watched.Program->GetFragmentPath());
+        if (VertexTime != Watched.VertexTime) {
+            changedFiles.push_back(fileName(Watched.Program->GetVertexPath()));
+        }
+        if (FragmentTime != Watched.FragmentTime) {
+            changedFiles.push_back(fileName(Watched.Program->GetFragmentPath()));
+        }
+        Watched.VertexTime = VertexTime;
+        Watched.FragmentTime = FragmentTime;
+    }
+}
+
+std::time_t
+ShaderWatcher::modificationTime(const std::string& path) {
+    struct stat Info;
+    if (stat(path.c_str(), &Info) != 0) {
+        return 0;
+    }
+    return Info.st_mtime;
+}
+
+std::string
+ShaderWatcher::fileName(const std::string& path) {
+    return path.substr(path.find_last_of("/\\") + 1);
+}
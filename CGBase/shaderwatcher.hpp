@@ -0,0 +1,40 @@
+/**
+ * @file shaderwatcher.hpp
+ * @brief Watches the shader directory and hot-reloads programs whose sources changed
+ *
+ */
+
+#pragma once
+#include <string>
+#include <vector>
+#include <ctime>
+#include <chrono>
+#include "shader.hpp"
+
+class ShaderWatcher {
+public:
+    ShaderWatcher(const std::string& directory);
+    ~ShaderWatcher();
+    void Watch(Shader* shader);
+    /**
+     * @brief Call once per frame. Starts reloads for changed sources and swaps in
+     * programs the driver has finished with. Never waits on the compiler.
+     */
+    void Update();
+
+private:
+    struct WatchedShader {
+        Shader* Program;
+        std::time_t VertexTime;
+        std::time_t FragmentTime;
+    };
+
+    std::string mDirectory;
+    std::vector<WatchedShader> mShaders;
+    int mNotifyFd;
+    std::chrono::steady_clock::time_point mLastPoll;
+
+    void collectChanges(std::vector<std::string>& changedFiles);
+    static std::time_t modificationTime(const std::string& path);
+    static std::string fileName(const std::string& path);
+};
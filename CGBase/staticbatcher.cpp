@@ -0,0 +1,106 @@
+#include "staticbatcher.hpp"
+
+StaticBatcher::StaticBatcher() {
+    mBuilt = false;
+}
+
+StaticBatcher::~StaticBatcher() {
+    if (!mBuilt) {
+        return;
+    }
+    for (unsigned BatchIdx = 0; BatchIdx < mBatches.size(); ++BatchIdx) {
+        GeometryArena::Free(mBatches[BatchIdx].Range);
+    }
+}
+
+void
+StaticBatcher::Add(const Geometry& geometry, const glm::mat4& model, const glm::vec3& color, unsigned diffuseTexture, unsigned specularTexture) {
+    if (mBuilt) {
+        std::cerr << "[Err] StaticBatcher::Add called after Build" << std::endl;
+        return;
+    }
+
+    Batch& Target = batch(color, diffuseTexture, specularTexture);
+    glm::mat3 NormalMatrix = glm::transpose(glm::inverse(glm::mat3(model)));
+    bool Mirrored = glm::determinant(glm::mat3(model)) < 0.0f;
+
+    unsigned BaseVertex = Target.Vertices.size() / VERTEX_FLOATS;
+    unsigned VertexCount = geometry.VerticesSize / (VERTEX_FLOATS * sizeof(float));
+    for (unsigned VertexIdx = 0; VertexIdx < VertexCount; ++VertexIdx) {
+        const float* Vertex = geometry.Vertices + VertexIdx * VERTEX_FLOATS;
+        glm::vec3 Position = glm::vec3(model * glm::vec4(Vertex[0], Vertex[1], Vertex[2], 1.0f));
+        glm::vec3 Normal = glm::normalize(NormalMatrix * glm::vec3(Vertex[3], Vertex[4], Vertex[5]));
+        float Baked[VERTEX_FLOATS] = { Position.x, Position.y, Position.z, Normal.x, Normal.y, Normal.z, Vertex[6], Vertex[7] };
+        Target.Vertices.insert(Target.Vertices.end(), Baked, Baked + VERTEX_FLOATS);
+    }
+
+    unsigned IndexCount = geometry.IndicesSize / sizeof(unsigned);
+    for (unsigned IndexIdx = 0; IndexIdx + 2 < IndexCount; IndexIdx += 3) {
+        const unsigned* Triangle = geometry.Indices + IndexIdx;
+        Target.Indices.push_back(BaseVertex + Triangle[0]);
+        Target.Indices.push_back(BaseVertex + Triangle[Mirrored ? 2 : 1]);
+        Target.Indices.push_back(BaseVertex + Triangle[Mirrored ? 1 : 2]);
+    }
+}
+
+void
+StaticBatcher::Build() {
+    if (mBuilt) {
+        return;
+    }
+
+    for (unsigned BatchIdx = 0; BatchIdx < mBatches.size(); ++BatchIdx) {
+        Batch& CurrBatch = mBatches[BatchIdx];
+        CurrBatch.LocalBounds = Bounds::FromVertices(CurrBatch.Vertices.data(), CurrBatch.Vertices.size() / VERTEX_FLOATS, VERTEX_FLOATS);
+        CurrBatch.Range = GeometryArena::Allocate(GeometryArena::FORMAT_POS_NORMAL_UV, CurrBatch.Vertices.data(), CurrBatch.Vertices.size() / VERTEX_FLOATS,
+            CurrBatch.Indices.data(), CurrBatch.Indices.size());
+
+        std::vector<float>().swap(CurrBatch.Vertices);
+        std::vector<unsigned>().swap(CurrBatch.Indices);
+    }
+    mBuilt = true;
+}
+
+void
+StaticBatcher::Submit(RenderQueue& queue, Shader& shader, const glm::mat4& root) const {
+    RenderQueue::DrawCall Draw = RenderQueue::DrawCall();
+    Draw.Pass = RenderQueue::PASS_OPAQUE;
+    Draw.Program = &shader;
+    Draw.Indexed = true;
+    Draw.Instances = 1;
+    Draw.Model = root;
+    for (unsigned BatchIdx = 0; BatchIdx < mBatches.size(); ++BatchIdx) {
+        const Batch& CurrBatch = mBatches[BatchIdx];
+        Draw.VAO = GeometryArena::GetVAO(CurrBatch.Range.Format);
+        Draw.Count = CurrBatch.Range.IndexCount;
+        Draw.FirstIndex = CurrBatch.Range.FirstIndex;
+        Draw.BaseVertex = CurrBatch.Range.BaseVertex;
+        Draw.DiffuseTexture = CurrBatch.DiffuseTexture;
+        Draw.SpecularTexture = CurrBatch.SpecularTexture;
+        Draw.Color = CurrBatch.Color;
+        Draw.Sphere = CurrBatch.LocalBounds.WorldSphere(root);
+        queue.Submit(Draw);
+    }
+}
+
+unsigned
+StaticBatcher::GetBatchCount() const {
+    return mBatches.size();
+}
+
+StaticBatcher::Batch&
+StaticBatcher::batch(const glm::vec3& color, unsigned diffuseTexture, unsigned specularTexture) {
+    for (unsigned BatchIdx = 0; BatchIdx < mBatches.size(); ++BatchIdx) {
+        Batch& CurrBatch = mBatches[BatchIdx];
+        if (CurrBatch.DiffuseTexture == diffuseTexture && CurrBatch.SpecularTexture == specularTexture && CurrBatch.Color == color) {
+            return CurrBatch;
+        }
+    }
+
+    Batch NewBatch = Batch();
+    NewBatch.DiffuseTexture = diffuseTexture;
+    NewBatch.SpecularTexture = specularTexture;
+    NewBatch.Color = color;
+    mBatches.push_back(NewBatch);
+    return mBatches.back();
+}
@@ -0,0 +1,64 @@
+/**
+ * @file staticbatcher.hpp
+ * @brief Bakes transformed copies of static geometry into one merged range of the geometry
+ * arena per material, so scenery that only ever moves as a whole draws with one call per material
+ *
+ */
+
+#pragma once
+#include <vector>
+#include <iostream>
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+#include "glstate.hpp"
+#include "renderqueue.hpp"
+#include "geometryarena.hpp"
+#include "bounds.hpp"
+
+class StaticBatcher {
+public:
+    // Source geometry as passed to Renderable, sizes in bytes, 8 floats per vertex
+    struct Geometry {
+        const float* Vertices;
+        unsigned VerticesSize;
+        const unsigned* Indices;
+        unsigned IndicesSize;
+    };
+
+    StaticBatcher();
+    ~StaticBatcher();
+
+    /**
+     * @brief Appends a copy of geometry transformed by model to the batch of its material.
+     * Mirroring transforms get their winding flipped, so every batch culls back faces.
+     */
+    void Add(const Geometry& geometry, const glm::mat4& model, const glm::vec3& color, unsigned diffuseTexture, unsigned specularTexture);
+    /**
+     * @brief Copies every batch into the geometry arena and frees the CPU copies. Nothing can be added afterwards.
+     */
+    void Build();
+    /**
+     * @brief Queues one draw per batch, all under the root transform
+     */
+    void Submit(RenderQueue& queue, Shader& shader, const glm::mat4& root) const;
+    unsigned GetBatchCount() const;
+
+private:
+    static const unsigned VERTEX_FLOATS = 8;
+
+    struct Batch {
+        unsigned DiffuseTexture;
+        unsigned SpecularTexture;
+        glm::vec3 Color;
+        std::vector<float> Vertices;
+        std::vector<unsigned> Indices;
+        GeometryArena::Range Range;
+        // Of the baked vertices, relative to the root
+        Bounds LocalBounds;
+    };
+
+    std::vector<Batch> mBatches;
+    bool mBuilt;
+
+    Batch& batch(const glm::vec3& color, unsigned diffuseTexture, unsigned specularTexture);
+};
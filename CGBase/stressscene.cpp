@@ -0,0 +1,277 @@
+#include "stressscene.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <random>
+#include "model.hpp"
+
+// Animated objects bob like the scene's stars: amplitude and radians per second
+static const float BOB_AMPLITUDE = 0.1f;
+static const float BOB_SPEED = 3.75f;
+// Candidates tried around an active sample before it is retired (Bridson)
+static const unsigned POISSON_ATTEMPTS = 30;
+
+StressScene::StressScene() {
+    mGenerateTime = 0.0;
+    mAnimateTime = 0.0;
+    mCullTime = 0.0;
+}
+
+StressScene::BlockId
+StressScene::AddBlock(const std::string& name) {
+    Block NewBlock;
+    NewBlock.Name = name;
+    NewBlock.CenterHeight = 0.0f;
+    NewBlock.Radius = 0.0f;
+    mBlocks.push_back(NewBlock);
+    return mBlocks.size() - 1;
+}
+
+void
+StressScene::AddPart(BlockId block, const Renderable* primitive, Shader* program, const glm::mat4& local, const glm::vec3& color, unsigned diffuseTexture, unsigned specularTexture) {
+    Part NewPart = { primitive, 0, program, local, color, diffuseTexture, specularTexture };
+    mBlocks[block].Parts.push_back(NewPart);
+    updateBounds(block);
+}
+
+void
+StressScene::AddPart(BlockId block, const Model* object, Shader* program, const glm::mat4& local, const glm::vec3& color) {
+    Part NewPart = { 0, object, program, local, color, 0, 0 };
+    mBlocks[block].Parts.push_back(NewPart);
+    updateBounds(block);
+}
+
+unsigned
+StressScene::GetBlockCount() const {
+    return mBlocks.size();
+}
+
+const std::string&
+StressScene::GetBlockName(BlockId block) const {
+    return mBlocks[block].Name;
+}
+
+void
+StressScene::Generate(const Settings& settings) {
+    std::chrono::high_resolution_clock::time_point Start = std::chrono::high_resolution_clock::now();
+    Clear();
+    if (mBlocks.empty() || !settings.Count) {
+        return;
+    }
+
+    if (settings.Layout == LAYOUT_POISSON) {
+        poissonLayout(settings.Count, settings.Spacing, settings.Seed);
+    }
+    else {
+        gridLayout(settings.Count, settings.Spacing);
+    }
+
+    unsigned Count = mPositions.size();
+    std::mt19937 Random(settings.Seed);
+    std::uniform_real_distribution<float> Unit(0.0f, 1.0f);
+    mYaw.resize(Count);
+    mScale.resize(Count);
+    mBobOffsets.resize(Count, 0.0f);
+    mBlockIds.resize(Count);
+    mSpheres.resize((Count + 3) / 4 * FrustumCuller::BLOCK_FLOATS, 0.0f);
+    mVisibleFlags.resize(Count);
+    mVisible.reserve(Count);
+    for (unsigned ObjectIdx = 0; ObjectIdx < Count; ++ObjectIdx) {
+        mBlockIds[ObjectIdx] = (unsigned char)(Random() % mBlocks.size());
+        mYaw[ObjectIdx] = Unit(Random) * 360.0f;
+        mScale[ObjectIdx] = 0.8f + 0.4f * Unit(Random);
+        if (Unit(Random) < settings.AnimatedFraction) {
+            mAnimated.push_back(ObjectIdx);
+            mPhases.push_back(mYaw[ObjectIdx]);
+            mSpinSpeeds.push_back(60.0f + 120.0f * Unit(Random));
+        }
+        setSphere(ObjectIdx);
+    }
+    std::chrono::duration<double> Elapsed = std::chrono::high_resolution_clock::now() - Start;
+    mGenerateTime = Elapsed.count();
+}
+
+void
+StressScene::Clear() {
+    mPositions.clear();
+    mYaw.clear();
+    mScale.clear();
+    mBobOffsets.clear();
+    mBlockIds.clear();
+    mAnimated.clear();
+    mPhases.clear();
+    mSpinSpeeds.clear();
+    mSpheres.clear();
+    mVisibleFlags.clear();
+    mVisible.clear();
+}
+
+void
+StressScene::Update(double time, const FrustumCuller& culler) {
+    std::chrono::high_resolution_clock::time_point Start = std::chrono::high_resolution_clock::now();
+    for (unsigned AnimatedIdx = 0; AnimatedIdx < mAnimated.size(); ++AnimatedIdx) {
+        unsigned Object = mAnimated[AnimatedIdx];
+        float Phase = mPhases[AnimatedIdx];
+        // Wrapped to one turn so the angle keeps its precision however long the field runs
+        mYaw[Object] = (float)std::fmod(Phase + mSpinSpeeds[AnimatedIdx] * time, 360.0);
+        mBobOffsets[Object] = BOB_AMPLITUDE * (float)std::sin(BOB_SPEED * time + glm::radians(Phase));
+        setSphere(Object);
+    }
+    std::chrono::high_resolution_clock::time_point Animated = std::chrono::high_resolution_clock::now();
+
+    mVisible.clear();
+    if (!mPositions.empty()) {
+        culler.Cull(&mSpheres[0], mPositions.size(), &mVisibleFlags[0]);
+        for (unsigned ObjectIdx = 0; ObjectIdx < mPositions.size(); ++ObjectIdx) {
+            if (mVisibleFlags[ObjectIdx]) {
+                mVisible.push_back(ObjectIdx);
+            }
+        }
+    }
+    std::chrono::high_resolution_clock::time_point Culled = std::chrono::high_resolution_clock::now();
+    mAnimateTime = std::chrono::duration<double>(Animated - Start).count();
+    mCullTime = std::chrono::duration<double>(Culled - Animated).count();
+}
+
+void
+StressScene::Submit(RenderQueue::DrawList& list, unsigned first, unsigned count) const {
+    const glm::vec3 YAxis(0.0f, 1.0f, 0.0f);
+    for (unsigned VisibleIdx = first; VisibleIdx < first + count && VisibleIdx < mVisible.size(); ++VisibleIdx) {
+        unsigned Object = mVisible[VisibleIdx];
+        glm::mat4 World = glm::translate(glm::mat4(1.0f), mPositions[Object] + YAxis * mBobOffsets[Object]);
+        World = glm::rotate(World, glm::radians(mYaw[Object]), YAxis);
+        World = glm::scale(World, glm::vec3(mScale[Object]));
+        for (const Part& Current : mBlocks[mBlockIds[Object]].Parts) {
+            if (Current.Primitive) {
+                Current.Primitive->Submit(list, *Current.Program, World * Current.Local, Current.Color, Current.DiffuseTexture, Current.SpecularTexture);
+            }
+            else {
+                Current.Object->Submit(list, *Current.Program, World * Current.Local, Current.Color);
+            }
+        }
+    }
+}
+
+unsigned
+StressScene::GetObjectCount() const {
+    return mPositions.size();
+}
+
+unsigned
+StressScene::GetVisibleCount() const {
+    return mVisible.size();
+}
+
+StressScene::Stats
+StressScene::GetStats() const {
+    Stats Result;
+    Result.Objects = mPositions.size();
+    Result.Animated = mAnimated.size();
+    Result.Visible = mVisible.size();
+    Result.GenerateTime = mGenerateTime;
+    Result.AnimateTime = mAnimateTime;
+    Result.CullTime = mCullTime;
+    return Result;
+}
+
+void
+StressScene::updateBounds(BlockId block) {
+    Block& Current = mBlocks[block];
+    glm::vec3 Min(0.0f);
+    glm::vec3 Max(0.0f);
+    for (unsigned PartIdx = 0; PartIdx < Current.Parts.size(); ++PartIdx) {
+        const Part& Piece = Current.Parts[PartIdx];
+        Bounds PieceBounds = Piece.Primitive ? Piece.Primitive->GetBounds() : Piece.Object->GetBounds();
+        glm::vec3 PieceMin;
+        glm::vec3 PieceMax;
+        PieceBounds.WorldBox(Piece.Local, PieceMin, PieceMax);
+        Min = PartIdx ? glm::min(Min, PieceMin) : PieceMin;
+        Max = PartIdx ? glm::max(Max, PieceMax) : PieceMax;
+    }
+
+    // Centered on the up axis, objects spin around it and the sphere has to hold for any yaw
+    Current.CenterHeight = (Min.y + Max.y) * 0.5f;
+    float Horizontal = std::max(std::max(glm::length(glm::vec2(Min.x, Min.z)), glm::length(glm::vec2(Min.x, Max.z))),
+        std::max(glm::length(glm::vec2(Max.x, Min.z)), glm::length(glm::vec2(Max.x, Max.z))));
+    float Vertical = (Max.y - Min.y) * 0.5f;
+    Current.Radius = std::sqrt(Horizontal * Horizontal + Vertical * Vertical);
+}
+
+void
+StressScene::gridLayout(unsigned count, float spacing) {
+    unsigned Side = (unsigned)std::ceil(std::sqrt((double)count));
+    float Offset = (Side - 1) * spacing * 0.5f;
+    mPositions.resize(count);
+    for (unsigned ObjectIdx = 0; ObjectIdx < count; ++ObjectIdx) {
+        mPositions[ObjectIdx] = glm::vec3(ObjectIdx % Side * spacing - Offset, 0.0f, ObjectIdx / Side * spacing - Offset);
+    }
+}
+
+void
+StressScene::poissonLayout(unsigned count, float spacing, unsigned seed) {
+    // Bridson's sampling fills about 0.65 samples per spacing squared, the square is sized to hold count of them
+    float Side = spacing * (float)std::sqrt(count / 0.6);
+    float CellSize = spacing / std::sqrt(2.0f);
+    int Cells = (int)std::ceil(Side / CellSize);
+    // At most one sample per cell, the cell size guarantees it
+    std::vector<unsigned> Grid((size_t)Cells * Cells, 0xFFFFFFFF);
+    std::vector<unsigned> Active;
+    std::mt19937 Random(seed);
+    std::uniform_real_distribution<float> Unit(0.0f, 1.0f);
+
+    mPositions.reserve(count);
+    mPositions.push_back(glm::vec3(Side * 0.5f, 0.0f, Side * 0.5f));
+    Grid[(size_t)(int)(Side * 0.5f / CellSize) * Cells + (int)(Side * 0.5f / CellSize)] = 0;
+    Active.push_back(0);
+    while (!Active.empty() && mPositions.size() < count) {
+        unsigned ActiveIdx = Random() % Active.size();
+        glm::vec3 Center = mPositions[Active[ActiveIdx]];
+        bool Placed = false;
+        for (unsigned Attempt = 0; Attempt < POISSON_ATTEMPTS && !Placed; ++Attempt) {
+            // Candidates in the annulus between one and two spacings around the active sample
+            float Angle = Unit(Random) * 6.2831853f;
+            float Distance = spacing * (1.0f + Unit(Random));
+            glm::vec3 Candidate = Center + glm::vec3(std::cos(Angle), 0.0f, std::sin(Angle)) * Distance;
+            if (Candidate.x < 0.0f || Candidate.z < 0.0f || Candidate.x >= Side || Candidate.z >= Side) {
+                continue;
+            }
+            int CellX = (int)(Candidate.x / CellSize);
+            int CellZ = (int)(Candidate.z / CellSize);
+            bool Free = true;
+            for (int Z = std::max(CellZ - 2, 0); Z <= std::min(CellZ + 2, Cells - 1) && Free; ++Z) {
+                for (int X = std::max(CellX - 2, 0); X <= std::min(CellX + 2, Cells - 1) && Free; ++X) {
+                    unsigned Neighbour = Grid[(size_t)Z * Cells + X];
+                    if (Neighbour != 0xFFFFFFFF) {
+                        glm::vec3 Offset = mPositions[Neighbour] - Candidate;
+                        Free = glm::dot(Offset, Offset) >= spacing * spacing;
+                    }
+                }
+            }
+            if (Free) {
+                Grid[(size_t)CellZ * Cells + CellX] = mPositions.size();
+                Active.push_back(mPositions.size());
+                mPositions.push_back(Candidate);
+                Placed = true;
+            }
+        }
+        if (!Placed) {
+            Active[ActiveIdx] = Active.back();
+            Active.pop_back();
+        }
+    }
+
+    glm::vec3 Center(Side * 0.5f, 0.0f, Side * 0.5f);
+    for (glm::vec3& Position : mPositions) {
+        Position -= Center;
+    }
+}
+
+void
+StressScene::setSphere(unsigned object) {
+    const Block& Current = mBlocks[mBlockIds[object]];
+    float* Sphere = &mSpheres[object / 4 * FrustumCuller::BLOCK_FLOATS + object % 4];
+    Sphere[0] = mPositions[object].x;
+    Sphere[4] = mPositions[object].y + mBobOffsets[object] + Current.CenterHeight * mScale[object];
+    Sphere[8] = mPositions[object].z;
+    Sphere[12] = Current.Radius * mScale[object];
+}
@@ -0,0 +1,120 @@
+/**
+ * @file stressscene.hpp
+ * @brief Procedural field of many copies of the scene's building blocks (tree, pyramid, star, ...)
+ * for measuring how the renderer scales with object count.
+ *
+ * Objects are kept as flat arrays rather than scene graph nodes, so a million of them fit in
+ * a few tens of megabytes. A block is a list of parts, each a primitive or a model with its own
+ * transform relative to the block. Every frame the animated fraction spins and bobs, all bounding
+ * spheres go through the FrustumCuller, and the visible objects are submitted from jobs.
+ */
+
+#pragma once
+#include <string>
+#include <vector>
+#include <glm/glm.hpp>
+#include "renderqueue.hpp"
+#include "renderable.hpp"
+#include "frustumculler.hpp"
+
+class Model;
+
+class StressScene {
+public:
+    typedef unsigned BlockId;
+
+    enum ELayout {
+        LAYOUT_GRID = 0,
+        // Poisson disk, no two objects closer than the spacing
+        LAYOUT_POISSON,
+    };
+
+    struct Settings {
+        unsigned Count;
+        ELayout Layout;
+        // Share of the objects that spin and bob, 0 to 1
+        float AnimatedFraction;
+        // Distance between neighbouring objects
+        float Spacing;
+        unsigned Seed;
+    };
+
+    struct Stats {
+        unsigned Objects;
+        unsigned Animated;
+        unsigned Visible;
+        double GenerateTime;
+        double AnimateTime;
+        double CullTime;
+    };
+
+    StressScene();
+
+    BlockId AddBlock(const std::string& name);
+    void AddPart(BlockId block, const Renderable* primitive, Shader* program, const glm::mat4& local, const glm::vec3& color, unsigned diffuseTexture, unsigned specularTexture);
+    void AddPart(BlockId block, const Model* object, Shader* program, const glm::mat4& local, const glm::vec3& color);
+    unsigned GetBlockCount() const;
+    const std::string& GetBlockName(BlockId block) const;
+
+    /**
+     * @brief Replaces the objects with settings.Count new ones centered on the origin, blocks
+     * picked at random. A Poisson layout stops early if the disk sampling runs out of room.
+     */
+    void Generate(const Settings& settings);
+    void Clear();
+
+    /**
+     * @brief Animates the moving objects to time seconds and collects the ones culler keeps
+     */
+    void Update(double time, const FrustumCuller& culler);
+    /**
+     * @brief Submits visible objects [first, first + count), safe to call from jobs for disjoint ranges
+     */
+    void Submit(RenderQueue::DrawList& list, unsigned first, unsigned count) const;
+    unsigned GetObjectCount() const;
+    unsigned GetVisibleCount() const;
+    Stats GetStats() const;
+
+private:
+    struct Part {
+        const Renderable* Primitive;
+        const Model* Object;
+        Shader* Program;
+        glm::mat4 Local;
+        glm::vec3 Color;
+        unsigned DiffuseTexture;
+        unsigned SpecularTexture;
+    };
+
+    struct Block {
+        std::string Name;
+        std::vector<Part> Parts;
+        // Height of the bounding sphere's center above the block origin and its radius, at scale 1
+        float CenterHeight;
+        float Radius;
+    };
+
+    std::vector<Block> mBlocks;
+    // Per object
+    std::vector<glm::vec3> mPositions;
+    std::vector<float> mYaw;
+    std::vector<float> mScale;
+    std::vector<float> mBobOffsets;
+    std::vector<unsigned char> mBlockIds;
+    // Per animated object: index, phase in degrees and spin speed in degrees per second
+    std::vector<unsigned> mAnimated;
+    std::vector<float> mPhases;
+    std::vector<float> mSpinSpeeds;
+    // Bounding spheres in FrustumCuller blocks
+    std::vector<float> mSpheres;
+    std::vector<unsigned char> mVisibleFlags;
+    std::vector<unsigned> mVisible;
+    double mGenerateTime;
+    double mAnimateTime;
+    double mCullTime;
+
+    void updateBounds(BlockId block);
+    void gridLayout(unsigned count, float spacing);
+    void poissonLayout(unsigned count, float spacing, unsigned seed);
+    void setSphere(unsigned object);
+};
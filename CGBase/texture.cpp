@@ -25,7 +25,7 @@ Texture::LoadImageToTexture(const std::string& filePath) {
 
     unsigned Texture;
     glGenTextures(1, &Texture);
-    glBindTexture(GL_TEXTURE_2D, Texture);
+    GLState::BindTexture(0, Texture);
     glTexImage2D(GL_TEXTURE_2D, 0, InternalFormat, TextureWidth, TextureHeight, 0, InternalFormat, GL_UNSIGNED_BYTE, ImageData);
     glGenerateMipmap(GL_TEXTURE_2D);
 
@@ -33,7 +33,7 @@ Texture::LoadImageToTexture(const std::string& filePath) {
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-    glBindTexture(GL_TEXTURE_2D, 0);
+    GLState::BindTexture(0, 0);
     stbi_image_free(ImageData);
     return Texture;
 }
\ No newline at end of file
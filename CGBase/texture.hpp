@@ -2,6 +2,7 @@
 #include <string>
 #include <GL/glew.h>
 #include <iostream>
+#include "glstate.hpp"
 
 static const std::string MISSING_TEXTURE_PATH = "res/missing_texture";
 
@@ -0,0 +1,272 @@
+#include "transformstore.hpp"
+#include <xmmintrin.h>
+#include <iostream>
+#include <algorithm>
+
+// Four consecutive components, zero padded past count
+static inline __m128
+load4(const std::vector<float>& values, unsigned first, unsigned count) {
+    if (count == 4) {
+        return _mm_loadu_ps(&values[first]);
+    }
+    float Lanes[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+    for (unsigned Lane = 0; Lane < count; ++Lane) {
+        Lanes[Lane] = values[first + Lane];
+    }
+    return _mm_loadu_ps(Lanes);
+}
+
+TransformStore::TransformStore() {
+    mSorted = true;
+}
+
+void
+TransformStore::Reserve(unsigned count) {
+    std::vector<float>* Components[] = { &mPositionX, &mPositionY, &mPositionZ, &mRotationX, &mRotationY, &mRotationZ, &mRotationW, &mScaleX, &mScaleY, &mScaleZ };
+    for (std::vector<float>* Component : Components) {
+        Component->reserve(count);
+    }
+    mParent.reserve(count);
+    mDepth.reserve(count);
+    mWorld.reserve(count);
+    mIndexOfHandle.reserve(count);
+    mHandleOfIndex.reserve(count);
+}
+
+void
+TransformStore::Clear() {
+    std::vector<float>* Components[] = { &mPositionX, &mPositionY, &mPositionZ, &mRotationX, &mRotationY, &mRotationZ, &mRotationW, &mScaleX, &mScaleY, &mScaleZ };
+    for (std::vector<float>* Component : Components) {
+        Component->clear();
+    }
+    mParent.clear();
+    mDepth.clear();
+    mWorld.clear();
+    mLevelStart.clear();
+    mIndexOfHandle.clear();
+    mHandleOfIndex.clear();
+    mSorted = true;
+}
+
+TransformStore::Handle
+TransformStore::Add(Handle parent, const glm::vec3& position, const glm::quat& rotation, const glm::vec3& scale) {
+    unsigned ParentIndex = INVALID_HANDLE;
+    if (parent != INVALID_HANDLE) {
+        if (parent >= mIndexOfHandle.size()) {
+            std::cerr << "[Err] Transform parent " << parent << " does not exist" << std::endl;
+        }
+        else {
+            ParentIndex = mIndexOfHandle[parent];
+        }
+    }
+
+    unsigned Depth = ParentIndex != INVALID_HANDLE ? mDepth[ParentIndex] + 1 : 0;
+    if (!mDepth.empty() && Depth < mDepth.back()) {
+        mSorted = false;
+    }
+
+    mPositionX.push_back(position.x);
+    mPositionY.push_back(position.y);
+    mPositionZ.push_back(position.z);
+    mRotationX.push_back(rotation.x);
+    mRotationY.push_back(rotation.y);
+    mRotationZ.push_back(rotation.z);
+    mRotationW.push_back(rotation.w);
+    mScaleX.push_back(scale.x);
+    mScaleY.push_back(scale.y);
+    mScaleZ.push_back(scale.z);
+    mParent.push_back(ParentIndex);
+    mDepth.push_back(Depth);
+    mWorld.push_back(glm::mat4(1.0f));
+
+    Handle NewHandle = mIndexOfHandle.size();
+    mIndexOfHandle.push_back(mHandleOfIndex.size());
+    mHandleOfIndex.push_back(NewHandle);
+    // Level boundaries are rebuilt on the next Update
+    mLevelStart.clear();
+    return NewHandle;
+}
+
+void
+TransformStore::SetPosition(Handle node, const glm::vec3& position) {
+    unsigned Index = mIndexOfHandle[node];
+    mPositionX[Index] = position.x;
+    mPositionY[Index] = position.y;
+    mPositionZ[Index] = position.z;
+}
+
+void
+TransformStore::SetRotation(Handle node, const glm::quat& rotation) {
+    unsigned Index = mIndexOfHandle[node];
+    mRotationX[Index] = rotation.x;
+    mRotationY[Index] = rotation.y;
+    mRotationZ[Index] = rotation.z;
+    mRotationW[Index] = rotation.w;
+}
+
+void
+TransformStore::SetScale(Handle node, const glm::vec3& scale) {
+    unsigned Index = mIndexOfHandle[node];
+    mScaleX[Index] = scale.x;
+    mScaleY[Index] = scale.y;
+    mScaleZ[Index] = scale.z;
+}
+
+const glm::mat4&
+TransformStore::GetWorld(Handle node) const {
+    return mWorld[mIndexOfHandle[node]];
+}
+
+void
+TransformStore::Update() {
+    if (!mSorted) {
+        sortByDepth();
+    }
+    if (mLevelStart.empty()) {
+        for (unsigned Index = 0; Index < mDepth.size(); ++Index) {
+            if (Index == 0 || mDepth[Index] != mDepth[Index - 1]) {
+                mLevelStart.push_back(Index);
+            }
+        }
+        mLevelStart.push_back(mDepth.size());
+    }
+
+    // Blocks never straddle two levels, the parents of a block are all final
+    for (unsigned Level = 0; Level + 1 < mLevelStart.size(); ++Level) {
+        unsigned End = mLevelStart[Level + 1];
+        for (unsigned First = mLevelStart[Level]; First < End; First += 4) {
+            updateBlock(First, std::min<unsigned>(4, End - First));
+        }
+    }
+}
+
+unsigned
+TransformStore::GetCount() const {
+    return mDepth.size();
+}
+
+unsigned
+TransformStore::GetLevelCount() const {
+    return mLevelStart.empty() ? 0 : mLevelStart.size() - 1;
+}
+
+void
+TransformStore::sortByDepth() {
+    // Counting sort, stable so siblings keep the order they were added in
+    unsigned LevelCount = 0;
+    for (unsigned Index = 0; Index < mDepth.size(); ++Index) {
+        LevelCount = std::max(LevelCount, mDepth[Index] + 1);
+    }
+    std::vector<unsigned> Offsets(LevelCount + 1, 0);
+    for (unsigned Index = 0; Index < mDepth.size(); ++Index) {
+        Offsets[mDepth[Index] + 1]++;
+    }
+    for (unsigned Level = 0; Level < LevelCount; ++Level) {
+        Offsets[Level + 1] += Offsets[Level];
+    }
+    std::vector<unsigned> NewIndex(mDepth.size());
+    for (unsigned Index = 0; Index < mDepth.size(); ++Index) {
+        NewIndex[Index] = Offsets[mDepth[Index]]++;
+    }
+
+    std::vector<float>* Components[] = { &mPositionX, &mPositionY, &mPositionZ, &mRotationX, &mRotationY, &mRotationZ, &mRotationW, &mScaleX, &mScaleY, &mScaleZ };
+    std::vector<float> Sorted(mDepth.size());
+    for (std::vector<float>* Component : Components) {
+        for (unsigned Index = 0; Index < mDepth.size(); ++Index) {
+            Sorted[NewIndex[Index]] = (*Component)[Index];
+        }
+        Component->swap(Sorted);
+    }
+
+    std::vector<unsigned> Parent(mDepth.size());
+    std::vector<unsigned> Depth(mDepth.size());
+    std::vector<glm::mat4> World(mDepth.size());
+    std::vector<Handle> HandleOfIndex(mDepth.size());
+    for (unsigned Index = 0; Index < mDepth.size(); ++Index) {
+        unsigned To = NewIndex[Index];
+        Parent[To] = mParent[Index] != INVALID_HANDLE ? NewIndex[mParent[Index]] : INVALID_HANDLE;
+        Depth[To] = mDepth[Index];
+        World[To] = mWorld[Index];
+        HandleOfIndex[To] = mHandleOfIndex[Index];
+        mIndexOfHandle[mHandleOfIndex[Index]] = To;
+    }
+    mParent.swap(Parent);
+    mDepth.swap(Depth);
+    mWorld.swap(World);
+    mHandleOfIndex.swap(HandleOfIndex);
+    mLevelStart.clear();
+    mSorted = true;
+}
+
+void
+TransformStore::updateBlock(unsigned first, unsigned count) {
+    const __m128 One = _mm_set1_ps(1.0f);
+    const __m128 Two = _mm_set1_ps(2.0f);
+
+    __m128 X = load4(mRotationX, first, count);
+    __m128 Y = load4(mRotationY, first, count);
+    __m128 Z = load4(mRotationZ, first, count);
+    __m128 W = load4(mRotationW, first, count);
+    __m128 XX = _mm_mul_ps(X, X);
+    __m128 YY = _mm_mul_ps(Y, Y);
+    __m128 ZZ = _mm_mul_ps(Z, Z);
+    __m128 XY = _mm_mul_ps(X, Y);
+    __m128 XZ = _mm_mul_ps(X, Z);
+    __m128 YZ = _mm_mul_ps(Y, Z);
+    __m128 WX = _mm_mul_ps(W, X);
+    __m128 WY = _mm_mul_ps(W, Y);
+    __m128 WZ = _mm_mul_ps(W, Z);
+
+    // Rotation columns times scale, same layout as glm::mat4_cast, one node per lane
+    __m128 ScaleX = load4(mScaleX, first, count);
+    __m128 ScaleY = load4(mScaleY, first, count);
+    __m128 ScaleZ = load4(mScaleZ, first, count);
+    __m128 Columns[4][4];
+    Columns[0][0] = _mm_mul_ps(_mm_sub_ps(One, _mm_mul_ps(Two, _mm_add_ps(YY, ZZ))), ScaleX);
+    Columns[0][1] = _mm_mul_ps(_mm_mul_ps(Two, _mm_add_ps(XY, WZ)), ScaleX);
+    Columns[0][2] = _mm_mul_ps(_mm_mul_ps(Two, _mm_sub_ps(XZ, WY)), ScaleX);
+    Columns[0][3] = _mm_setzero_ps();
+    Columns[1][0] = _mm_mul_ps(_mm_mul_ps(Two, _mm_sub_ps(XY, WZ)), ScaleY);
+    Columns[1][1] = _mm_mul_ps(_mm_sub_ps(One, _mm_mul_ps(Two, _mm_add_ps(XX, ZZ))), ScaleY);
+    Columns[1][2] = _mm_mul_ps(_mm_mul_ps(Two, _mm_add_ps(YZ, WX)), ScaleY);
+    Columns[1][3] = _mm_setzero_ps();
+    Columns[2][0] = _mm_mul_ps(_mm_mul_ps(Two, _mm_add_ps(XZ, WY)), ScaleZ);
+    Columns[2][1] = _mm_mul_ps(_mm_mul_ps(Two, _mm_sub_ps(YZ, WX)), ScaleZ);
+    Columns[2][2] = _mm_mul_ps(_mm_sub_ps(One, _mm_mul_ps(Two, _mm_add_ps(XX, YY))), ScaleZ);
+    Columns[2][3] = _mm_setzero_ps();
+    Columns[3][0] = load4(mPositionX, first, count);
+    Columns[3][1] = load4(mPositionY, first, count);
+    Columns[3][2] = load4(mPositionZ, first, count);
+    Columns[3][3] = One;
+
+    // After the transpose Columns[c][n] is column c of node n
+    for (unsigned Column = 0; Column < 4; ++Column) {
+        _MM_TRANSPOSE4_PS(Columns[Column][0], Columns[Column][1], Columns[Column][2], Columns[Column][3]);
+    }
+
+    for (unsigned Lane = 0; Lane < count; ++Lane) {
+        unsigned Index = first + Lane;
+        float* World = &mWorld[Index][0][0];
+        if (mParent[Index] == INVALID_HANDLE) {
+            for (unsigned Column = 0; Column < 4; ++Column) {
+                _mm_storeu_ps(World + 4 * Column, Columns[Column][Lane]);
+            }
+            continue;
+        }
+
+        // World = ParentWorld * Local, one column at a time
+        const float* Parent = &mWorld[mParent[Index]][0][0];
+        __m128 Parent0 = _mm_loadu_ps(Parent);
+        __m128 Parent1 = _mm_loadu_ps(Parent + 4);
+        __m128 Parent2 = _mm_loadu_ps(Parent + 8);
+        __m128 Parent3 = _mm_loadu_ps(Parent + 12);
+        for (unsigned Column = 0; Column < 4; ++Column) {
+            __m128 Local = Columns[Column][Lane];
+            __m128 Result = _mm_mul_ps(Parent0, _mm_shuffle_ps(Local, Local, _MM_SHUFFLE(0, 0, 0, 0)));
+            Result = _mm_add_ps(Result, _mm_mul_ps(Parent1, _mm_shuffle_ps(Local, Local, _MM_SHUFFLE(1, 1, 1, 1))));
+            Result = _mm_add_ps(Result, _mm_mul_ps(Parent2, _mm_shuffle_ps(Local, Local, _MM_SHUFFLE(2, 2, 2, 2))));
+            Result = _mm_add_ps(Result, _mm_mul_ps(Parent3, _mm_shuffle_ps(Local, Local, _MM_SHUFFLE(3, 3, 3, 3))));
+            _mm_storeu_ps(World + 4 * Column, Result);
+        }
+    }
+}
@@ -0,0 +1,70 @@
+/**
+ * @file transformstore.hpp
+ * @brief Transforms of many nodes kept as separate arrays per component (structure of arrays)
+ * and ordered by depth in the hierarchy. Update builds local matrices four nodes at a time
+ * with SSE and multiplies them into their parents' world matrices level by level, so every
+ * parent is final before its children read it.
+ *
+ * Meant for scenes far bigger than SceneGraph handles comfortably; it recomputes every node
+ * on Update instead of tracking dirty ones.
+ */
+
+#pragma once
+#include <vector>
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+class TransformStore {
+public:
+    typedef unsigned Handle;
+    static const Handle INVALID_HANDLE = 0xFFFFFFFF;
+
+    TransformStore();
+
+    void Reserve(unsigned count);
+    void Clear();
+    /**
+     * @brief Adds a node under parent, INVALID_HANDLE for a root. Handles stay valid when
+     * Update reorders the arrays.
+     */
+    Handle Add(Handle parent, const glm::vec3& position, const glm::quat& rotation, const glm::vec3& scale);
+    void SetPosition(Handle node, const glm::vec3& position);
+    void SetRotation(Handle node, const glm::quat& rotation);
+    void SetScale(Handle node, const glm::vec3& scale);
+    /**
+     * @brief World matrix as of the last Update
+     */
+    const glm::mat4& GetWorld(Handle node) const;
+
+    /**
+     * @brief Sorts the nodes by depth if any were added out of order, then recomputes every world matrix
+     */
+    void Update();
+    unsigned GetCount() const;
+    unsigned GetLevelCount() const;
+
+private:
+    // Components in depth order, index i of every array is the same node
+    std::vector<float> mPositionX;
+    std::vector<float> mPositionY;
+    std::vector<float> mPositionZ;
+    std::vector<float> mRotationX;
+    std::vector<float> mRotationY;
+    std::vector<float> mRotationZ;
+    std::vector<float> mRotationW;
+    std::vector<float> mScaleX;
+    std::vector<float> mScaleY;
+    std::vector<float> mScaleZ;
+    // Index of the parent in the same order, INVALID_HANDLE for roots
+    std::vector<unsigned> mParent;
+    std::vector<unsigned> mDepth;
+    std::vector<glm::mat4> mWorld;
+    // First index of every depth level, plus one past the last node
+    std::vector<unsigned> mLevelStart;
+    std::vector<unsigned> mIndexOfHandle;
+    std::vector<Handle> mHandleOfIndex;
+    bool mSorted;
+
+    void sortByDepth();
+    void updateBlock(unsigned first, unsigned count);
+};